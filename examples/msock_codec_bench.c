@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MSOCK_IMPLEMENTATION
+#include "msock_codec.h"
+
+// Encodes and reads back a telemetry sample with the schema codec and, for comparison,
+// as the text line handlers used to snprintf/sscanf. Both go through real frames.
+//
+//     msock_codec_bench [iterations]
+
+#define TELEMETRY_FIELDS(X) \
+    X(u32, sensor_id)       \
+    X(varint, sequence)     \
+    X(svarint, delta)       \
+    X(f64, value)           \
+    X(bytes, unit)
+
+MSOCK_SCHEMA(telemetry, TELEMETRY_FIELDS)
+
+static volatile uint64_t sink;
+
+int main(int argc, char **argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 1000000;
+    if (iterations < 1) {
+        printf("usage: msock_codec_bench [iterations]\n");
+        return 1;
+    }
+
+    msock_init();
+
+    // Frames go through a reader like they would after a receive
+    msock_frame_reader reader;
+    msock_frame_reader_init(&reader);
+
+    telemetry sample = { .sensor_id = 4711, .sequence = 1, .delta = -3, .value = 21.375, .unit = msock_codec_cstr("celsius") };
+    size_t binary_bytes = 0;
+
+    uint64_t start = msock_time_ns();
+    for (int i = 0; i < iterations; i++) {
+        sample.sequence = (uint64_t)i;
+        sample.delta = (i & 1) ? -i : i;
+
+        msock_buffer *frame = telemetry_frame((uint32_t)i, 0, &sample);
+        if (!frame) return 1;
+        binary_bytes += frame->len;
+        msock_frame_reader_feed(&reader, frame->data, frame->len);
+        msock_buffer_release(frame);
+
+        msock_frame_header header;
+        const char *payload;
+        telemetry received;
+        if (msock_frame_reader_next(&reader, &header, &payload) != 1 || !telemetry_read(&received, payload, header.length)) {
+            printf("Bad frame at %d\n", i);
+            return 1;
+        }
+        sink += received.sequence + (uint64_t)received.delta + received.unit.len;
+    }
+    double binary_ns = (double)(msock_time_ns() - start) / iterations;
+
+    size_t text_bytes = 0;
+    start = msock_time_ns();
+    for (int i = 0; i < iterations; i++) {
+        char text[128];
+        int len = snprintf(text, sizeof(text), "%u %llu %lld %.17g %s", 4711u, (unsigned long long)i, (long long)((i & 1) ? -i : i), 21.375, "celsius");
+
+        msock_buffer *frame = msock_buffer_acquire(MSOCK_FRAME_HEADER_SIZE + (size_t)len);
+        if (!frame) return 1;
+        msock_frame_header header = { (uint32_t)len, (uint32_t)i, 0, 0 };
+        msock_frame_write_header(frame->data, &header);
+        memcpy(frame->data + MSOCK_FRAME_HEADER_SIZE, text, (size_t)len);
+        frame->len = MSOCK_FRAME_HEADER_SIZE + (size_t)len;
+        text_bytes += frame->len;
+        msock_frame_reader_feed(&reader, frame->data, frame->len);
+        msock_buffer_release(frame);
+
+        const char *payload;
+        if (msock_frame_reader_next(&reader, &header, &payload) != 1) return 1;
+
+        char line[128];
+        memcpy(line, payload, header.length);
+        line[header.length] = '\0';
+
+        unsigned sensor_id;
+        unsigned long long sequence;
+        long long delta;
+        double value;
+        char unit[32];
+        if (sscanf(line, "%u %llu %lld %lf %31s", &sensor_id, &sequence, &delta, &value, unit) != 5) {
+            printf("Bad line at %d\n", i);
+            return 1;
+        }
+        sink += sequence + (uint64_t)delta + strlen(unit);
+    }
+    double text_ns = (double)(msock_time_ns() - start) / iterations;
+
+    printf("%d messages\n", iterations);
+    printf("  schema codec: %6.1f ns/msg, %5.1f bytes/frame\n", binary_ns, (double)binary_bytes / iterations);
+    printf("  text format:  %6.1f ns/msg, %5.1f bytes/frame\n", text_ns, (double)text_bytes / iterations);
+
+    msock_frame_reader_free(&reader);
+    msock_deinit();
+
+    return 0;
+}
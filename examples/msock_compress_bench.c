@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MSOCK_IMPLEMENTATION
+#include "msock.h"
+
+// Compresses a stream of generated chat and telemetry messages one by one, like
+// msock_client_send_frame_compressed does, and decompresses them on a second stream.
+// Reports the ratio and how fast both sides are next to a plain memcpy.
+//
+//     msock_compress_bench [messages]
+
+#define BENCH_CORPUS_SIZE (32 * 1024 * 1024)
+
+typedef struct {
+    char *data;
+    size_t *lengths;
+    int count;
+    size_t total;
+} corpus;
+
+static const char *users[] = { "alice", "bob", "carol", "dave", "erin", "frank" };
+static const char *phrases[] = { "sounds good", "on my way", "did the deploy go out?", "lunch at noon", "see the dashboard", "ack" };
+static const char *sensors[] = { "kitchen", "garage", "attic", "basement" };
+
+static void generate(corpus *c, int count, bool chat) {
+    c->data = (char*)malloc(BENCH_CORPUS_SIZE);
+    c->lengths = (size_t*)malloc((size_t)count * sizeof(size_t));
+    c->count = 0;
+    c->total = 0;
+    if (!c->data || !c->lengths) return;
+
+    srand(42);
+    for (int i = 0; i < count && c->total + 512 < BENCH_CORPUS_SIZE; i++) {
+        char *out = c->data + c->total;
+        int len;
+        if (chat) {
+            len = snprintf(out, 512, "{\"type\":\"message\",\"room\":\"general\",\"user\":\"%s\",\"seq\":%d,\"text\":\"%s\"}", users[rand() % 6], i,
+                           phrases[rand() % 6]);
+        } else {
+            len = snprintf(out, 512, "sensor=%s temperature=%d.%d humidity=%d battery=%d ts=%d", sensors[rand() % 4], 18 + rand() % 6, rand() % 10,
+                           40 + rand() % 20, 90 + rand() % 10, 1700000000 + i);
+        }
+        c->lengths[c->count++] = (size_t)len;
+        c->total += (size_t)len;
+    }
+}
+
+static void run(const char *name, corpus *c) {
+    msock_compress_stream tx, rx;
+    if (!msock_compress_stream_init(&tx, true) || !msock_compress_stream_init(&rx, false)) return;
+
+    char *compressed = (char*)malloc(c->total + (size_t)c->count * 32);
+    size_t *compressed_lengths = (size_t*)malloc((size_t)c->count * sizeof(size_t));
+    char *copy = (char*)malloc(c->total);
+    if (!compressed || !compressed_lengths || !copy) return;
+
+    uint64_t start = msock_time_ns();
+    size_t offset = 0, out = 0;
+    for (int i = 0; i < c->count; i++) {
+        compressed_lengths[i] = msock_compress(&tx, c->data + offset, c->lengths[i], compressed + out);
+        offset += c->lengths[i];
+        out += compressed_lengths[i];
+    }
+    double compress_s = (double)(msock_time_ns() - start) / 1e9;
+
+    start = msock_time_ns();
+    size_t in = 0;
+    offset = 0;
+    for (int i = 0; i < c->count; i++) {
+        const char *message = msock_decompress(&rx, compressed + in, compressed_lengths[i], c->lengths[i]);
+        if (!message || memcmp(message, c->data + offset, c->lengths[i]) != 0) {
+            printf("Round trip failed at message %d\n", i);
+            return;
+        }
+        in += compressed_lengths[i];
+        offset += c->lengths[i];
+    }
+    double decompress_s = (double)(msock_time_ns() - start) / 1e9;
+
+    start = msock_time_ns();
+    offset = 0;
+    for (int i = 0; i < c->count; i++) {
+        memcpy(copy + offset, c->data + offset, c->lengths[i]);
+        offset += c->lengths[i];
+    }
+    double copy_s = (double)(msock_time_ns() - start) / 1e9;
+
+    double mb = (double)c->total / (1024.0 * 1024.0);
+    printf("%s: %d messages, %.1f bytes avg\n", name, c->count, (double)c->total / c->count);
+    printf("  ratio      %.3f (%.1f bytes avg on the wire)\n", (double)out / (double)c->total, (double)out / c->count);
+    printf("  compress   %7.0f MB/s  %6.0f ns/msg\n", mb / compress_s, compress_s * 1e9 / c->count);
+    printf("  decompress %7.0f MB/s  %6.0f ns/msg (includes verify)\n", mb / decompress_s, decompress_s * 1e9 / c->count);
+    printf("  memcpy     %7.0f MB/s\n", mb / copy_s);
+
+    free(compressed);
+    free(compressed_lengths);
+    free(copy);
+    msock_compress_stream_free(&tx);
+    msock_compress_stream_free(&rx);
+}
+
+int main(int argc, char **argv) {
+    int messages = argc > 1 ? atoi(argv[1]) : 200000;
+    if (messages < 1) {
+        printf("usage: msock_compress_bench [messages]\n");
+        return 1;
+    }
+
+    msock_init();
+
+    corpus chat, telemetry;
+    generate(&chat, messages, true);
+    generate(&telemetry, messages, false);
+    if (chat.count == 0 || telemetry.count == 0) return 1;
+
+    run("chat", &chat);
+    run("telemetry", &telemetry);
+
+    free(chat.data);
+    free(chat.lengths);
+    free(telemetry.data);
+    free(telemetry.lengths);
+
+    msock_deinit();
+
+    return 0;
+}
@@ -15,8 +15,16 @@ int main(void) {
 
     msock_client client;
     msock_client_create(&client);
+
+    msock_socket_options options = { .tcp_nodelay = true, .tcp_quickack = true };
+    msock_client_set_options(&client, &options);
+
     msock_client_connect(&client, "127.0.0.1", "420");
 
+    // Keeps reconnecting with backoff if the server goes away
+    msock_reconnect_config reconnect = { .max_buffered_bytes = 64 * 1024 };
+    msock_client_enable_reconnect(&client, "127.0.0.1", "420", &reconnect);
+
     char receive_buffer[1024];
     msock_message receive_msg = {
         .size = 1024,
@@ -24,12 +32,16 @@ int main(void) {
     };
 
     msock_message msg = {.buffer = "Echo!", .len = 5};
-    while(msock_client_is_connected(&client)) {
+    for(;;) {
+        if(!msock_client_service_reconnect(&client)) {
+            Sleep(10);
+            continue;
+        }
 
-        if(!msock_client_send(&client, &msg)) break;
+        if(!msock_client_send(&client, &msg)) continue;
         printf("Send: %s\n", msg.buffer);
 
-        if(!msock_client_receive(&client, &receive_msg)) break;
+        if(msock_client_receive(&client, &receive_msg) <= 0) continue;
         printf("Received: %s\n", receive_buffer);
         
         Sleep(1000);
@@ -4,13 +4,13 @@
 #include "msock.h"
 
 bool handle_connect(msock_client *client) {
-    printf("Client connected with IP: %s\n", client->ip_addr);
+    printf("Client connected with IP: %s\n", msock_client_get_ip(client));
     
     return true;
 }
 
 bool handle_disconnect(msock_client *client) {
-    printf("Client disconnected with IP: %s\n", client->ip_addr);
+    printf("Client disconnected with IP: %s\n", msock_client_get_ip(client));
     
     return true;
 }
@@ -40,6 +40,11 @@ int main(void) {
 
     msock_server server;
     msock_server_create(&server);
+
+    // Request/response traffic, don't let Nagle and delayed ACKs stall the echo
+    msock_socket_options options = { .tcp_nodelay = true, .tcp_quickack = true };
+    msock_server_set_options(&server, &options);
+
     if (!msock_server_listen(&server, "127.0.0.1", "420")) {
         printf("Failed to bind port 420\n");
         return 1;
@@ -0,0 +1,193 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MSOCK_IMPLEMENTATION
+#include "msock.h"
+
+// wrk-style load generator: keeps `depth` pipelined keep-alive requests in flight on
+// every connection for a fixed time, then reports throughput and latency percentiles.
+//
+//     msock_http_bench [port] [connections] [seconds] [depth] [path]
+
+#define BENCH_MAX_CONNECTIONS 256
+#define BENCH_MAX_DEPTH 64
+#define BENCH_MAX_SAMPLES (4 * 1024 * 1024)
+#define BENCH_BUFFER_SIZE (64 * 1024)
+
+typedef struct {
+    msock_client client;
+    char buffer[BENCH_BUFFER_SIZE + 1];
+    size_t len;
+    uint64_t sent_at[BENCH_MAX_DEPTH]; // Ring of send times, responses come back in order
+    int head;
+    int in_flight;
+} bench_conn;
+
+typedef struct {
+    msock_message request;
+    bool done;
+    uint64_t responses;
+    uint64_t errors;
+    uint64_t bytes;
+    uint64_t* samples;
+    size_t sample_count;
+} bench_state;
+
+static bench_state state;
+
+static bool send_requests(bench_conn *conn, int count) {
+    for (int i = 0; i < count; i++) {
+        conn->sent_at[(conn->head + conn->in_flight) % BENCH_MAX_DEPTH] = msock_time_ns();
+        conn->in_flight++;
+        if (!msock_client_send(&conn->client, &state.request)) return false;
+    }
+    return true;
+}
+
+// Returns the length of the first complete response in the buffer, 0 if incomplete
+static size_t response_length(const char *data, size_t len) {
+    const char *end = NULL;
+    for (size_t i = 3; i < len; i++) {
+        if (data[i] == '\n' && data[i - 1] == '\r' && data[i - 2] == '\n' && data[i - 3] == '\r') {
+            end = data + i + 1;
+            break;
+        }
+    }
+    if (!end) return 0;
+
+    size_t body = 0;
+    const char *header = strstr(data, "Content-Length:");
+    if (header && header < end) body = (size_t)strtoul(header + 15, NULL, 10);
+
+    size_t total = (size_t)(end - data) + body;
+    return total <= len ? total : 0;
+}
+
+static bool on_readable(msock_loop *loop, msock_client *client, void *ctx) {
+    (void) loop;
+    bench_conn *conn = (bench_conn*)ctx;
+
+    msock_message msg = { .buffer = conn->buffer + conn->len, .size = BENCH_BUFFER_SIZE - conn->len + 1 };
+    ssize_t received = msock_client_receive(client, &msg);
+    if (received < 0 || !msock_client_is_connected(client)) {
+        state.errors++;
+        return false;
+    }
+    conn->len += (size_t)received;
+    state.bytes += (uint64_t)received;
+
+    size_t consumed = 0;
+    int completed = 0;
+    for (;;) {
+        size_t length = response_length(conn->buffer + consumed, conn->len - consumed);
+        if (length == 0) break;
+
+        if (strncmp(conn->buffer + consumed, "HTTP/1.1 200", 12) != 0) state.errors++;
+
+        uint64_t latency = msock_time_ns() - conn->sent_at[conn->head];
+        conn->head = (conn->head + 1) % BENCH_MAX_DEPTH;
+        conn->in_flight--;
+        if (state.sample_count < BENCH_MAX_SAMPLES) state.samples[state.sample_count++] = latency;
+
+        state.responses++;
+        consumed += length;
+        completed++;
+    }
+
+    memmove(conn->buffer, conn->buffer + consumed, conn->len - consumed);
+    conn->len -= consumed;
+    conn->buffer[conn->len] = '\0';
+
+    if (state.done) return true;
+    return send_requests(conn, completed);
+}
+
+static bool on_deadline(msock_loop *loop, void *userdata) {
+    (void) loop;
+    (void) userdata;
+    state.done = true;
+    return false;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile_us(double p) {
+    if (state.sample_count == 0) return 0.0;
+    size_t index = (size_t)(p * (double)(state.sample_count - 1));
+    return (double)state.samples[index] / 1000.0;
+}
+
+int main(int argc, char **argv) {
+    const char *port = argc > 1 ? argv[1] : "8080";
+    int connections = argc > 2 ? atoi(argv[2]) : 32;
+    int seconds = argc > 3 ? atoi(argv[3]) : 5;
+    int depth = argc > 4 ? atoi(argv[4]) : 1;
+    const char *path = argc > 5 ? argv[5] : "/";
+
+    if (connections < 1 || connections > BENCH_MAX_CONNECTIONS || depth < 1 || depth > BENCH_MAX_DEPTH || seconds < 1) {
+        printf("usage: msock_http_bench [port] [connections 1-%d] [seconds] [depth 1-%d] [path]\n", BENCH_MAX_CONNECTIONS, BENCH_MAX_DEPTH);
+        return 1;
+    }
+
+    msock_init();
+
+    char request[512];
+    int request_len = snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: 127.0.0.1:%s\r\n\r\n", path, port);
+    state.request.buffer = request;
+    state.request.len = (size_t)request_len;
+    state.samples = (uint64_t*)malloc(BENCH_MAX_SAMPLES * sizeof(uint64_t));
+
+    msock_loop loop;
+    if (!state.samples || !msock_loop_create(&loop)) return 1;
+
+    bench_conn *conns = (bench_conn*)calloc((size_t)connections, sizeof(bench_conn));
+    if (!conns) return 1;
+
+    msock_socket_options options = { .tcp_nodelay = true };
+    for (int i = 0; i < connections; i++) {
+        bench_conn *conn = &conns[i];
+        msock_client_create(&conn->client);
+        msock_client_set_options(&conn->client, &options);
+
+        if (!msock_client_connect(&conn->client, "127.0.0.1", port)) {
+            printf("Connection %d failed\n", i);
+            return 1;
+        }
+        msock_set_nonblocking(conn->client.native_socket);
+
+        msock_loop_handler handler = { .on_readable = on_readable, .ctx = conn };
+        msock_loop_add_client(&loop, &conn->client, &handler);
+    }
+
+    printf("Running %ds against 127.0.0.1:%s%s, %d connections, pipeline depth %d\n", seconds, port, path, connections, depth);
+
+    uint64_t start = msock_time_ns();
+    msock_loop_add_timer(&loop, (uint32_t)seconds * 1000, 0, on_deadline, NULL);
+    for (int i = 0; i < connections; i++) send_requests(&conns[i], depth);
+
+    while (!state.done) {
+        if (!msock_loop_run(&loop)) break;
+    }
+    double elapsed = (double)(msock_time_ns() - start) / 1e9;
+
+    qsort(state.samples, state.sample_count, sizeof(uint64_t), compare_u64);
+
+    printf("  %llu responses in %.2fs, %llu errors\n", (unsigned long long)state.responses, elapsed, (unsigned long long)state.errors);
+    printf("  Requests/sec: %.0f\n", (double)state.responses / elapsed);
+    printf("  Transfer/sec: %.2f MB\n", (double)state.bytes / elapsed / (1024.0 * 1024.0));
+    printf("  Latency p50 %.1fus  p90 %.1fus  p99 %.1fus  max %.1fus\n", percentile_us(0.50), percentile_us(0.90), percentile_us(0.99), percentile_us(1.0));
+
+    for (int i = 0; i < connections; i++) msock_client_close(&conns[i].client);
+    msock_loop_close(&loop);
+    free(conns);
+    free(state.samples);
+
+    msock_deinit();
+
+    return 0;
+}
@@ -0,0 +1,57 @@
+#include <stdio.h>
+
+#define MSOCK_IMPLEMENTATION
+#define MSOCK_HTTP_IMPLEMENTATION
+#include "msock_http.h"
+
+// Benchmark target: GET / answers a fixed body, POST /echo returns the request body.
+// Drive it with msock_http_bench or any wrk-style load generator.
+
+void handle_request(msock_http_conn *conn, const msock_http_request *request, void *userdata) {
+    (void) userdata;
+
+    if (msock_http_str_equals(request->target, "/") && msock_http_str_equals(request->method, "GET")) {
+        msock_http_respond(conn, 200, "text/plain", "Hello, World!", 13);
+        return;
+    }
+
+    if (msock_http_str_equals(request->target, "/echo") && msock_http_str_equals(request->method, "POST")) {
+        msock_http_respond(conn, 200, "application/octet-stream", request->body, request->body_len);
+        return;
+    }
+
+    msock_http_respond(conn, 404, "text/plain", "Not Found", 9);
+}
+
+int main(int argc, char **argv) {
+    const char *port = argc > 1 ? argv[1] : "8080";
+
+    msock_init();
+
+    msock_server server;
+    msock_server_create(&server);
+
+    msock_socket_options options = { .tcp_nodelay = true };
+    msock_server_set_options(&server, &options);
+
+    if (!msock_server_listen(&server, "127.0.0.1", port)) {
+        printf("Failed to bind port %s\n", port);
+        return 1;
+    }
+
+    msock_http_server http;
+    if (!msock_http_attach(&http, &server, handle_request, NULL)) return 1;
+
+    printf("msock http server listening on 127.0.0.1:%s\n", port);
+
+    while(msock_server_is_listening(&server)) {
+        msock_server_run(&server);
+    }
+
+    msock_http_detach(&http);
+    msock_server_close(&server);
+
+    msock_deinit();
+
+    return 0;
+}
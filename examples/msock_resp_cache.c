@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MSOCK_IMPLEMENTATION
+#define MSOCK_RESP_IMPLEMENTATION
+#include "msock_resp.h"
+
+// In-memory cache speaking RESP2, so redis-cli and redis-benchmark can talk to it:
+//
+//     msock_resp_cache [port]
+//     redis-benchmark -p 6380 -t ping,set,get -P 16
+
+#define CACHE_BUCKETS (1 << 16)
+
+typedef struct cache_entry {
+    struct cache_entry *next;
+    uint32_t hash;
+    size_t key_len;
+    size_t value_len;
+    char data[]; // Key followed by value
+} cache_entry;
+
+typedef struct {
+    cache_entry *buckets[CACHE_BUCKETS];
+    int64_t count;
+} cache;
+
+static uint32_t cache_hash(msock_resp_str key) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < key.len; i++) {
+        hash ^= (uint8_t)key.data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static cache_entry **cache_find(cache *c, msock_resp_str key, uint32_t hash) {
+    cache_entry **link = &c->buckets[hash & (CACHE_BUCKETS - 1)];
+    while (*link) {
+        cache_entry *entry = *link;
+        if (entry->hash == hash && entry->key_len == key.len && memcmp(entry->data, key.data, key.len) == 0) break;
+        link = &entry->next;
+    }
+    return link;
+}
+
+static bool cache_set(cache *c, msock_resp_str key, const char *value, size_t value_len) {
+    uint32_t hash = cache_hash(key);
+    cache_entry **link = cache_find(c, key, hash);
+
+    cache_entry *entry = (cache_entry*)malloc(sizeof(cache_entry) + key.len + value_len);
+    if (!entry) return false;
+    entry->hash = hash;
+    entry->key_len = key.len;
+    entry->value_len = value_len;
+    memcpy(entry->data, key.data, key.len);
+    memcpy(entry->data + key.len, value, value_len);
+
+    if (*link) {
+        entry->next = (*link)->next;
+        free(*link);
+    } else {
+        entry->next = NULL;
+        c->count++;
+    }
+    *link = entry;
+    return true;
+}
+
+static bool cache_delete(cache *c, msock_resp_str key) {
+    cache_entry **link = cache_find(c, key, cache_hash(key));
+    if (!*link) return false;
+
+    cache_entry *entry = *link;
+    *link = entry->next;
+    free(entry);
+    c->count--;
+    return true;
+}
+
+static void cache_reply_value(msock_resp_conn *conn, cache *c, msock_resp_str key) {
+    cache_entry *entry = *cache_find(c, key, cache_hash(key));
+    if (entry) msock_resp_reply_bulk(conn, entry->data + entry->key_len, entry->value_len);
+    else msock_resp_reply_null(conn);
+}
+
+void cmd_ping(msock_resp_conn *conn, const msock_resp_command *command, void *userdata) {
+    (void) userdata;
+    if (command->argc > 1) msock_resp_reply_bulk(conn, command->argv[1].data, command->argv[1].len);
+    else msock_resp_reply_status(conn, "PONG");
+}
+
+void cmd_echo(msock_resp_conn *conn, const msock_resp_command *command, void *userdata) {
+    (void) userdata;
+    msock_resp_reply_bulk(conn, command->argv[1].data, command->argv[1].len);
+}
+
+void cmd_get(msock_resp_conn *conn, const msock_resp_command *command, void *userdata) {
+    cache_reply_value(conn, (cache*)userdata, command->argv[1]);
+}
+
+void cmd_set(msock_resp_conn *conn, const msock_resp_command *command, void *userdata) {
+    if (command->argc != 3) {
+        msock_resp_reply_error(conn, "ERR options aren't supported");
+        return;
+    }
+    if (!cache_set((cache*)userdata, command->argv[1], command->argv[2].data, command->argv[2].len)) msock_resp_reply_error(conn, "OOM out of memory");
+    else msock_resp_reply_status(conn, "OK");
+}
+
+void cmd_mget(msock_resp_conn *conn, const msock_resp_command *command, void *userdata) {
+    msock_resp_reply_array(conn, command->argc - 1);
+    for (int i = 1; i < command->argc; i++) cache_reply_value(conn, (cache*)userdata, command->argv[i]);
+}
+
+void cmd_mset(msock_resp_conn *conn, const msock_resp_command *command, void *userdata) {
+    if (command->argc % 2 == 0) {
+        msock_resp_reply_error(conn, "ERR wrong number of arguments for 'mset' command");
+        return;
+    }
+    for (int i = 1; i < command->argc; i += 2) {
+        if (!cache_set((cache*)userdata, command->argv[i], command->argv[i + 1].data, command->argv[i + 1].len)) {
+            msock_resp_reply_error(conn, "OOM out of memory");
+            return;
+        }
+    }
+    msock_resp_reply_status(conn, "OK");
+}
+
+void cmd_del(msock_resp_conn *conn, const msock_resp_command *command, void *userdata) {
+    int64_t deleted = 0;
+    for (int i = 1; i < command->argc; i++) deleted += cache_delete((cache*)userdata, command->argv[i]);
+    msock_resp_reply_integer(conn, deleted);
+}
+
+void cmd_exists(msock_resp_conn *conn, const msock_resp_command *command, void *userdata) {
+    cache *c = (cache*)userdata;
+    int64_t found = 0;
+    for (int i = 1; i < command->argc; i++) found += *cache_find(c, command->argv[i], cache_hash(command->argv[i])) != NULL;
+    msock_resp_reply_integer(conn, found);
+}
+
+void cmd_incr(msock_resp_conn *conn, const msock_resp_command *command, void *userdata) {
+    cache *c = (cache*)userdata;
+    cache_entry *entry = *cache_find(c, command->argv[1], cache_hash(command->argv[1]));
+
+    int64_t value = 0;
+    if (entry) {
+        msock_resp_str current = { entry->data + entry->key_len, entry->value_len };
+        if (!msock_resp_str_to_int(current, &value) || value == INT64_MAX) {
+            msock_resp_reply_error(conn, "ERR value is not an integer or out of range");
+            return;
+        }
+    }
+    value++;
+
+    char text[24];
+    int len = snprintf(text, sizeof(text), "%lld", (long long)value);
+    if (!cache_set(c, command->argv[1], text, (size_t)len)) msock_resp_reply_error(conn, "OOM out of memory");
+    else msock_resp_reply_integer(conn, value);
+}
+
+void cmd_dbsize(msock_resp_conn *conn, const msock_resp_command *command, void *userdata) {
+    (void) command;
+    msock_resp_reply_integer(conn, ((cache*)userdata)->count);
+}
+
+// redis-benchmark asks for a few settings on startup, nothing to report here
+void cmd_empty(msock_resp_conn *conn, const msock_resp_command *command, void *userdata) {
+    (void) command;
+    (void) userdata;
+    msock_resp_reply_array(conn, 0);
+}
+
+int main(int argc, char **argv) {
+    const char *port = argc > 1 ? argv[1] : "6380";
+
+    msock_init();
+
+    cache *store = (cache*)calloc(1, sizeof(cache));
+    if (!store) return 1;
+
+    msock_server server;
+    msock_server_create(&server);
+
+    msock_socket_options options = { .tcp_nodelay = true };
+    msock_server_set_options(&server, &options);
+
+    if (!msock_server_listen(&server, "127.0.0.1", port)) {
+        printf("Failed to bind port %s\n", port);
+        return 1;
+    }
+
+    msock_resp_server resp;
+    if (!msock_resp_attach(&resp, &server, store)) return 1;
+
+    msock_resp_register(&resp, "PING", -1, cmd_ping);
+    msock_resp_register(&resp, "ECHO", 2, cmd_echo);
+    msock_resp_register(&resp, "GET", 2, cmd_get);
+    msock_resp_register(&resp, "SET", -3, cmd_set);
+    msock_resp_register(&resp, "MGET", -2, cmd_mget);
+    msock_resp_register(&resp, "MSET", -3, cmd_mset);
+    msock_resp_register(&resp, "DEL", -2, cmd_del);
+    msock_resp_register(&resp, "EXISTS", -2, cmd_exists);
+    msock_resp_register(&resp, "INCR", 2, cmd_incr);
+    msock_resp_register(&resp, "DBSIZE", 1, cmd_dbsize);
+    msock_resp_register(&resp, "CONFIG", -2, cmd_empty);
+    msock_resp_register(&resp, "COMMAND", -1, cmd_empty);
+
+    printf("msock resp cache listening on 127.0.0.1:%s\n", port);
+
+    while(msock_server_is_listening(&server)) {
+        msock_server_run(&server);
+    }
+
+    msock_resp_detach(&resp);
+    msock_server_close(&server);
+    free(store);
+
+    msock_deinit();
+
+    return 0;
+}
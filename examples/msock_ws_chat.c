@@ -0,0 +1,79 @@
+#include <stdio.h>
+
+#define MSOCK_IMPLEMENTATION
+#define MSOCK_HTTP_IMPLEMENTATION
+#define MSOCK_WS_IMPLEMENTATION
+#include "msock_ws.h"
+
+// WebSocket chat: every text message is framed once and queued on all other members.
+// Connect with any WebSocket client to ws://127.0.0.1:8081/chat
+
+static msock_ws_server ws;
+
+void handle_open(msock_ws_conn *conn, void *userdata) {
+    (void) userdata;
+    printf("Member joined: %s\n", msock_client_get_ip(conn->http->io.client));
+}
+
+void handle_message(msock_ws_conn *conn, int opcode, const char *data, size_t len, void *userdata) {
+    (void) userdata;
+    if (opcode != MSOCK_WS_OP_TEXT) return;
+
+    msock_buffer *frame = msock_ws_frame(MSOCK_WS_OP_TEXT, data, len);
+    if (!frame) return;
+
+    msock_ws_broadcast(&ws, frame, conn);
+    msock_buffer_release(frame);
+}
+
+void handle_close(msock_ws_conn *conn, int code, void *userdata) {
+    (void) userdata;
+    printf("Member left: %s (%d)\n", msock_client_get_ip(conn->http->io.client), code);
+}
+
+void handle_request(msock_http_conn *conn, const msock_http_request *request, void *userdata) {
+    (void) userdata;
+
+    if (msock_http_str_equals(request->target, "/chat") && msock_ws_is_upgrade(request)) {
+        msock_ws_upgrade(&ws, conn, request);
+        return;
+    }
+
+    msock_http_respond(conn, 404, "text/plain", "Not Found", 9);
+}
+
+int main(void) {
+
+    msock_init();
+
+    msock_server server;
+    msock_server_create(&server);
+
+    msock_socket_options options = { .tcp_nodelay = true };
+    msock_server_set_options(&server, &options);
+
+    if (!msock_server_listen(&server, "127.0.0.1", "8081")) {
+        printf("Failed to bind port 8081\n");
+        return 1;
+    }
+
+    msock_http_server http;
+    msock_http_attach(&http, &server, handle_request, NULL);
+
+    msock_ws_config config = { .on_open = handle_open, .on_message = handle_message, .on_close = handle_close, .ping_interval_ms = 15000 };
+    msock_ws_init(&ws, &http, &config);
+
+    printf("msock websocket chat on ws://127.0.0.1:8081/chat\n");
+
+    while(msock_server_is_listening(&server)) {
+        msock_server_run(&server);
+    }
+
+    msock_ws_free(&ws);
+    msock_http_detach(&http);
+    msock_server_close(&server);
+
+    msock_deinit();
+
+    return 0;
+}
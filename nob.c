@@ -58,9 +58,21 @@ int main(int argc, char** argv)
     #ifdef _WIN32
     if(compile_socket_program_windows(INPUT_FOLDER"msock_echo_client.c", OUTPUT_FOLDER"msock_echo_client.exe", debug) != 0) printf("Failed building echo client\n");
     if(compile_socket_program_windows(INPUT_FOLDER"msock_echo_server.c", OUTPUT_FOLDER"msock_echo_server.exe", debug) != 0) printf("Failed building echo server\n");
+    if(compile_socket_program_windows(INPUT_FOLDER"msock_http_server.c", OUTPUT_FOLDER"msock_http_server.exe", debug) != 0) printf("Failed building http server\n");
+    if(compile_socket_program_windows(INPUT_FOLDER"msock_http_bench.c", OUTPUT_FOLDER"msock_http_bench.exe", debug) != 0) printf("Failed building http bench\n");
+    if(compile_socket_program_windows(INPUT_FOLDER"msock_ws_chat.c", OUTPUT_FOLDER"msock_ws_chat.exe", debug) != 0) printf("Failed building websocket chat\n");
+    if(compile_socket_program_windows(INPUT_FOLDER"msock_resp_cache.c", OUTPUT_FOLDER"msock_resp_cache.exe", debug) != 0) printf("Failed building resp cache\n");
+    if(compile_socket_program_windows(INPUT_FOLDER"msock_codec_bench.c", OUTPUT_FOLDER"msock_codec_bench.exe", debug) != 0) printf("Failed building codec bench\n");
+    if(compile_socket_program_windows(INPUT_FOLDER"msock_compress_bench.c", OUTPUT_FOLDER"msock_compress_bench.exe", debug) != 0) printf("Failed building compress bench\n");
     #else
     if(compile_socket_program_linux(INPUT_FOLDER"msock_echo_client.c", OUTPUT_FOLDER"msock_echo_client", debug) != 0) printf("Failed building echo client\n");
     if(compile_socket_program_linux(INPUT_FOLDER"msock_echo_server.c", OUTPUT_FOLDER"msock_echo_server", debug) != 0) printf("Failed building echo server\n");
+    if(compile_socket_program_linux(INPUT_FOLDER"msock_http_server.c", OUTPUT_FOLDER"msock_http_server", debug) != 0) printf("Failed building http server\n");
+    if(compile_socket_program_linux(INPUT_FOLDER"msock_http_bench.c", OUTPUT_FOLDER"msock_http_bench", debug) != 0) printf("Failed building http bench\n");
+    if(compile_socket_program_linux(INPUT_FOLDER"msock_ws_chat.c", OUTPUT_FOLDER"msock_ws_chat", debug) != 0) printf("Failed building websocket chat\n");
+    if(compile_socket_program_linux(INPUT_FOLDER"msock_resp_cache.c", OUTPUT_FOLDER"msock_resp_cache", debug) != 0) printf("Failed building resp cache\n");
+    if(compile_socket_program_linux(INPUT_FOLDER"msock_codec_bench.c", OUTPUT_FOLDER"msock_codec_bench", debug) != 0) printf("Failed building codec bench\n");
+    if(compile_socket_program_linux(INPUT_FOLDER"msock_compress_bench.c", OUTPUT_FOLDER"msock_compress_bench", debug) != 0) printf("Failed building compress bench\n");
     #endif
 
     return 0;
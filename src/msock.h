@@ -6,12 +6,21 @@
 #include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
 
 #ifdef _WIN32
 #include <ws2tcpip.h>
 #include <winsock2.h>
+#include <windows.h>
+#include <io.h>
 #pragma comment(lib, "ws2_32.lib")
 
+typedef HANDLE msock_thread;
+typedef SRWLOCK msock_mutex;
+#define MSOCK_MUTEX_INIT SRWLOCK_INIT
+#define msock_mutex_lock AcquireSRWLockExclusive
+#define msock_mutex_unlock ReleaseSRWLockExclusive
+
 #ifdef _MSC_VER
 #include <basetsd.h>
 typedef SSIZE_T ssize_t;
@@ -20,15 +29,39 @@ typedef int socklen_t;
 
 #define MSOCK_LAST_ERROR WSAGetLastError()
 #define MSOCK_IS_WOULDBLOCK(err) ((err) == WSAEWOULDBLOCK)
+#define MSOCK_IS_INPROGRESS(err) ((err) == WSAEWOULDBLOCK || (err) == WSAEINPROGRESS)
+#define MSOCK_ETIMEDOUT WSAETIMEDOUT
+#define MSOCK_ECONNRESET WSAECONNRESET
+#define MSOCK_ECANCELED WSAECANCELLED
+#define MSOCK_SEND_FLAGS 0
+#define msock_poll WSAPoll
 #else
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
 #include <netdb.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <sys/select.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <poll.h>
+#include <pthread.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
+#include <linux/errqueue.h>
+#endif
+
+typedef pthread_t msock_thread;
+typedef pthread_mutex_t msock_mutex;
+#define MSOCK_MUTEX_INIT PTHREAD_MUTEX_INITIALIZER
+#define msock_mutex_lock pthread_mutex_lock
+#define msock_mutex_unlock pthread_mutex_unlock
 
 #define SOCKET int
 #define INVALID_SOCKET -1
@@ -37,6 +70,17 @@ typedef int socklen_t;
 #define closesocket close
 #define MSOCK_LAST_ERROR errno
 #define MSOCK_IS_WOULDBLOCK(err) ((err) == EWOULDBLOCK || (err) == EAGAIN)
+#define MSOCK_IS_INPROGRESS(err) ((err) == EINPROGRESS)
+#define MSOCK_ETIMEDOUT ETIMEDOUT
+#define MSOCK_ECONNRESET ECONNRESET
+#define MSOCK_ECANCELED ECANCELED
+#define msock_poll poll
+
+#ifdef MSG_NOSIGNAL
+#define MSOCK_SEND_FLAGS MSG_NOSIGNAL // Writing to a dead peer must not raise SIGPIPE
+#else
+#define MSOCK_SEND_FLAGS 0
+#endif
 
 #define SD_SEND SHUT_WR 
 #define SD_BOTH SHUT_RDWR
@@ -44,13 +88,84 @@ typedef int socklen_t;
 
 #define MAXHOSTNAMELEN 256
 #define MSOCK_MAX_CLIENTS 64
+#define MSOCK_CLIENT_SLOT_WORDS ((MSOCK_MAX_CLIENTS + 63) / 64) // uint64_t words in a bitset over client slots
+#define MSOCK_GROUP_STOP_POLL_MS 100
+#define MSOCK_READ_BUFFER_SIZE (16 * 1024)
+#define MSOCK_DEFAULT_DRAIN_BYTE_BUDGET (64 * 1024)
+#define MSOCK_DEFAULT_DRAIN_READ_BUDGET 16
+#define MSOCK_CACHE_LINE 64
+#define MSOCK_LOOP_MAX_EVENTS 256
+#define MSOCK_BUFFER_POOL_MAX_FREE 256 // Per size class and thread
+#define MSOCK_WRITE_NODE_POOL_MAX_FREE 1024
+#define MSOCK_MAX_IOVEC 64 // Pieces handed to one vectored send, the rest is queued
+#define MSOCK_ZEROCOPY_CLOSE_WAIT_MS 100 // Close waits up to this long for zerocopy completions
+#define MSOCK_RESOLVER_CACHE_SIZE 64
+#define MSOCK_RESOLVER_DEFAULT_TTL_MS 30000
+#define MSOCK_RESOLVER_DEFAULT_NEGATIVE_TTL_MS 5000
+#define MSOCK_RESOLVER_DEFAULT_REFRESH_MS 1000
+#define MSOCK_BALANCER_MAX_UPSTREAMS 32
+#define MSOCK_BALANCER_VNODES 64 // Consistent hash ring points per upstream
+#define MSOCK_BALANCER_DEFAULT_HEALTH_TIMEOUT_MS 1000
+#define MSOCK_BALANCER_DEFAULT_RETRY_MS 5000
+#define MSOCK_RATE_LIMIT_DEFAULT_REFILL_MS 10
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define MSOCK_STATIC_ASSERT(cond, msg) static_assert(cond, msg)
+#define MSOCK_THREAD_LOCAL __declspec(thread)
+#else
+#define MSOCK_STATIC_ASSERT(cond, msg) _Static_assert(cond, msg)
+#define MSOCK_THREAD_LOCAL _Thread_local
+#endif
 
 typedef struct msock_client msock_client;
 typedef struct msock_server msock_server;
+typedef struct msock_loop msock_loop;
+typedef struct msock_reconnect msock_reconnect;
+
+// Reference counted byte buffer, recycled through per-thread pools. One buffer can sit
+// in several write queues at once, each queue holds its own reference.
+typedef struct msock_buffer {
+    struct msock_buffer* next_free;
+    char* data;
+    size_t len;
+    size_t capacity;
+    uint32_t refcount;
+} msock_buffer;
+
+// One queued write: a buffer, or with buffer NULL a file range from msock_client_sendfile
+typedef struct msock_write_node {
+    struct msock_write_node* next;
+    msock_buffer* buffer;
+    size_t offset; // Bytes of buffer or file range already handed to the kernel
+
+    int file_fd;
+    int64_t file_offset;
+    size_t file_len;
+
+    uint32_t zerocopy_id; // Send counter value while parked on the zerocopy completion list
+} msock_write_node;
+
+typedef struct {
+    char* buffer;
+    size_t size;
+    size_t len;
+} msock_message;
+
+// One piece of a vectored send
+typedef struct {
+    const void* data;
+    size_t len;
+} msock_iovec;
 
 typedef bool (*msock_on_connect_cb)(msock_client* client);
 typedef bool (*msock_on_disconnect_cb)(msock_client* client);
 typedef bool (*msock_on_client_cb)(msock_server* server, msock_client* client);
+typedef bool (*msock_on_data_cb)(msock_server* server, msock_client* client, msock_message* msg);
+typedef void (*msock_on_connect_result_cb)(msock_client* client, int error); // error is the SO_ERROR value, 0 = connected
+
+typedef bool (*msock_on_readable_cb)(msock_loop* loop, msock_client* client, void* ctx);
+typedef void (*msock_on_close_cb)(msock_loop* loop, msock_client* client, void* ctx);
+typedef bool (*msock_on_timer_cb)(msock_loop* loop, void* userdata); // Return false to stop a repeating timer
 
 typedef enum {
     MSOCK_TCP,
@@ -60,18 +175,352 @@ typedef enum {
 typedef enum {
     MSOCK_STATE_DISCONNECTED,
     MSOCK_STATE_CONNECTED,
+    MSOCK_STATE_CONNECTING,
 
     MSOCK_STATE_UNBOUND,
     MSOCK_STATE_BOUND,
-    MSOCK_STATE_LISTENING
+    MSOCK_STATE_LISTENING,
+
+    MSOCK_STATE_RECONNECTING, // Waiting for the next reconnect attempt
+    MSOCK_STATE_CIRCUIT_OPEN  // Too many failed attempts, sends fail fast until the cooldown ends
 } msock_state;
 
+// Socket tuning, applied at listen/accept/connect time. A zero field means
+// "leave the system default".
+typedef struct {
+    bool tcp_nodelay;         // Disable Nagle
+    bool tcp_quickack;        // Re-armed after every receive, Linux only
+    int send_buffer_size;     // SO_SNDBUF in bytes
+    int receive_buffer_size;  // SO_RCVBUF in bytes
+
+    bool keepalive;
+    int keepalive_idle_s;     // Idle time before the first probe
+    int keepalive_interval_s; // Time between probes
+    int keepalive_count;      // Probes before the connection is dropped
+
+    int user_timeout_ms;      // TCP_USER_TIMEOUT, Linux only
+    int busy_poll_us;         // SO_BUSY_POLL, Linux only
+
+    int defer_accept_s;       // TCP_DEFER_ACCEPT, listener only
+    int fastopen_queue_len;   // TCP_FASTOPEN on a listener, TCP_FASTOPEN_CONNECT on a client
+
+    size_t zerocopy_threshold; // Queued buffers at least this big go out with MSG_ZEROCOPY, 0 = off. Linux only
+} msock_socket_options;
+
+typedef struct {
+    uint64_t bytes_sent;
+    uint64_t bytes_received;
+    uint64_t messages_sent;
+    uint64_t messages_received;
+    uint64_t zerocopy_sends;  // send() calls made with MSG_ZEROCOPY
+    uint64_t zerocopy_copied; // Of those, the ones the kernel ended up copying anyway
+} msock_client_stats;
+
+// getaddrinfo does not report record TTLs, so cached answers live for a fixed time.
+// A zero field means the default.
+typedef struct {
+    uint32_t ttl_ms;              // How long a successful lookup is reused
+    uint32_t negative_ttl_ms;     // How long a failed lookup is remembered
+    uint32_t refresh_interval_ms; // How often the background thread looks for entries to refresh
+} msock_resolver_config;
+
+typedef struct {
+    uint64_t hits;
+    uint64_t negative_hits; // Served a cached failure without asking the resolver
+    uint64_t misses;
+    uint64_t refreshes;     // Lookups done by the background thread
+    uint64_t failures;
+} msock_resolver_stats;
+
+// Cold per-connection data: only touched on connect, on request from the app
+// or when updating stats, so it is kept out of the hot msock_client array.
+typedef struct {
+    struct sockaddr_in peer_addr;
+    char ip_addr[INET_ADDRSTRLEN]; // Formatted lazily by msock_client_get_ip
+    bool ip_formatted;
+
+    void* userdata;
+    msock_client_stats stats;
+
+    msock_socket_options options; // Only used for standalone clients, applied on connect
+    bool has_options;
+
+    // In-flight msock_client_connect_async
+    uint64_t connect_deadline_ns; // 0 = no timeout
+    msock_on_connect_result_cb connect_result_cb;
+    uint64_t connect_timer_id;    // Timeout timer when the connect runs on a msock_loop
+
+    msock_reconnect* reconnect;   // NULL unless msock_client_enable_reconnect was called
+
+    // Buffers sent with MSG_ZEROCOPY, held until the kernel reports it is done with them
+    size_t zerocopy_threshold;
+    uint32_t zerocopy_next_id;    // Mirrors the kernel's per-socket zerocopy send counter
+    struct msock_write_node* zerocopy_head;
+    struct msock_write_node* zerocopy_tail;
+
+    // Server rate limit buckets in thousandths of a token, refilled lazily on the server's rate clock
+    int64_t rate_bytes;
+    int64_t rate_messages;
+    uint64_t rate_refilled_ms;
+} msock_client_cold;
+
+#define MSOCK_CLIENT_FLAG_OWNS_COLD (1u << 0)
+#define MSOCK_CLIENT_FLAG_QUICKACK  (1u << 1)
+#define MSOCK_CLIENT_FLAG_REQUEUED  (1u << 2) // Hit its drain budget, still has data pending
+#define MSOCK_CLIENT_FLAG_ZEROCOPY  (1u << 3)
+#define MSOCK_CLIENT_FLAG_READ_PAUSED (1u << 4) // Loop stops asking for read readiness
+#define MSOCK_CLIENT_FLAG_WANT_WRITE  (1u << 5) // Loop asks for write readiness even with an empty queue
+#define MSOCK_CLIENT_FLAG_CORKED      (1u << 6) // Sends only queue up until the loop flushes at the end of the iteration
+#define MSOCK_CLIENT_FLAG_THROTTLED   (1u << 7) // Out of rate limit tokens, not read until the refill timer resumes it
+
+// Hot per-connection data: everything the loop scans each iteration.
+// Must stay within one cache line.
 struct msock_client {
     SOCKET native_socket;
-    msock_protocol socket_protocol;
-    msock_state socket_state;
+    uint8_t socket_state;    // msock_state
+    uint8_t socket_protocol; // msock_protocol
+    uint16_t flags;
+    int32_t loop_slot;       // Entry in loop, -1 when not owned by a loop
+
+    msock_client_cold* cold;
+    msock_loop* loop;
+
+    // Outbound bytes the kernel didn't take yet, flushed when the socket turns writable
+    msock_write_node* write_head;
+    msock_write_node* write_tail;
+};
+
+MSOCK_STATIC_ASSERT(sizeof(msock_client) <= MSOCK_CACHE_LINE, "msock_client hot data must fit in one cache line");
+
+// Forwards everything read from one client to another. On Linux the bytes move
+// socket -> pipe -> socket inside the kernel and never reach user memory.
+typedef struct {
+    msock_client* from;
+    msock_client* to;
+    int pipe_fds[2];     // Linux only, -1 elsewhere
+    size_t pipe_pending; // Read from `from`, not yet written to `to`
+    bool eof;            // `from` closed its side
+    uint64_t bytes_forwarded;
+} msock_splice;
+
+// Picks the upstream for a freshly accepted client. Return false to reject it.
+typedef bool (*msock_on_relay_upstream_cb)(msock_server* server, msock_client* client, struct sockaddr_in* upstream);
+
+typedef struct {
+    uint64_t relayed;             // Accepted clients handed to an upstream
+    uint64_t upstream_failures;   // Upstream connect failed or was rejected by the callback
+    uint64_t bytes_to_upstream;
+    uint64_t bytes_to_client;
+} msock_relay_stats;
+
+// One relayed connection: the accepted client and its upstream
+typedef struct {
+    msock_server* server;
+    msock_client* client;
+    msock_client upstream;
+    msock_splice to_upstream;
+    msock_splice to_client;
+    bool active;
+    bool upstream_connected;
+    int upstream_index; // Balancer upstream, -1 when picked by the relay callback
+} msock_relay;
+
+typedef enum {
+    MSOCK_BALANCE_ROUND_ROBIN,
+    MSOCK_BALANCE_LEAST_CONNECTIONS,
+    MSOCK_BALANCE_POWER_OF_TWO,      // Two random upstreams, the one with fewer connections wins
+    MSOCK_BALANCE_CONSISTENT_HASH,   // On the peer address, sticky across reconnects
+} msock_balance_policy;
+
+typedef struct {
+    msock_balance_policy policy;
+    uint32_t health_interval_ms;  // Active connect probes, 0 = only failed relay connects count
+    uint32_t health_timeout_ms;   // 0 = MSOCK_BALANCER_DEFAULT_HEALTH_TIMEOUT_MS
+    uint32_t retry_interval_ms;   // Without probes, an unhealthy upstream gets one trial relay this often, 0 = MSOCK_BALANCER_DEFAULT_RETRY_MS
+    uint32_t unhealthy_threshold; // Consecutive failures before an upstream is skipped, 0 = 1
+    uint32_t healthy_threshold;   // Consecutive successes before it is used again, 0 = 1
+} msock_balancer_config;
+
+typedef struct msock_balancer msock_balancer;
+
+typedef struct {
+    struct sockaddr_in addr;
+    bool healthy;
+    uint32_t active_connections;
+    uint64_t total_connections;
+    uint64_t failures;
+    uint32_t consecutive_failures;
+    uint32_t consecutive_successes;
+    uint64_t retry_at_ns; // Without probes: when an unhealthy upstream gets its next trial relay
+
+    msock_balancer* balancer;
+    msock_client probe; // Health check connection
+    bool probing;
+} msock_upstream;
+
+typedef struct {
+    uint32_t hash;
+    uint32_t upstream;
+} msock_balancer_ring_node;
+
+struct msock_balancer {
+    msock_server* server;
+    msock_balancer_config config;
+    msock_upstream upstreams[MSOCK_BALANCER_MAX_UPSTREAMS];
+    int upstream_count;
+    uint32_t next_upstream; // Round-robin cursor
+    uint64_t rng;
+    msock_balancer_ring_node ring[MSOCK_BALANCER_MAX_UPSTREAMS * MSOCK_BALANCER_VNODES]; // Sorted on hash
+    int ring_size;
+    uint64_t health_timer_id;
+};
+
+// Subscribers of one pub/sub topic as a bitset over the server's client slots
+typedef struct {
+    uint32_t id;
+    bool used;
+    uint32_t subscriber_count;
+    uint64_t members[MSOCK_CLIENT_SLOT_WORDS];
+} msock_topic;
+
+// Token bucket limits for a server. Buckets refill from a loop timer, reads and accepts
+// only subtract, so the data path never reads the clock. A zero rate means unlimited,
+// a zero burst allows one second worth of tokens.
+typedef struct {
+    uint64_t bytes_per_sec;      // Per connection
+    uint64_t bytes_burst;
+    uint32_t messages_per_sec;   // Per connection, one message is one receive handed to the app
+    uint32_t messages_burst;
+    uint32_t accepts_per_sec;    // Whole server
+    uint32_t accepts_burst;
+    uint32_t refill_interval_ms; // How often throttled clients are looked at, default MSOCK_RATE_LIMIT_DEFAULT_REFILL_MS
+} msock_rate_limit_config;
+
+typedef struct {
+    uint64_t throttled;         // Times a client ran out of tokens and stopped being read
+    uint64_t accept_pauses;     // Times the listener ran out of tokens and stopped accepting
+    uint32_t throttled_clients; // Currently not read
+} msock_rate_limit_stats;
+
+// Where the run loop spends its time, used to tune the spin budget.
+typedef struct {
+    uint64_t iterations;
+    uint64_t spin_polls;     // Zero-timeout polls made while spinning
+    uint64_t spin_hits;      // Iterations where spinning found work before the budget ran out
+    uint64_t blocking_waits; // Iterations where the budget ran out and the loop blocked
+    uint64_t spin_ns;        // Time spent in zero-timeout polls
+    uint64_t blocked_ns;     // Time spent blocked in the kernel
+    uint64_t productive_ns;  // Time spent accepting and running callbacks
+    uint64_t corked_sends;   // Sends held back until the end of their iteration
+    uint64_t cork_flushes;   // End of iteration flushes, each one vectored send per client
+} msock_loop_stats;
+
+typedef struct {
+    msock_on_readable_cb on_readable; // Return false to close the connection
+    msock_on_close_cb on_close;       // Called after the loop dropped the connection, NULL = msock_client_close
+    void* ctx;
+    bool edge_triggered;              // on_readable must drain until EAGAIN or call msock_loop_requeue
+    msock_on_readable_cb on_writable; // Optional, called on write readiness after the write queue was flushed
+} msock_loop_handler;
+
+typedef void (*msock_on_state_change_cb)(msock_client* client, msock_state old_state, msock_state new_state);
+
+// A zero field means the default
+typedef struct {
+    uint32_t initial_delay_ms;    // Backoff ceiling of the first retry, default 100
+    uint32_t max_delay_ms;        // Backoff ceiling cap, default 30000
+    uint32_t failure_threshold;   // Consecutive failed attempts that open the circuit breaker, 0 = never
+    uint32_t breaker_cooldown_ms; // How long the breaker stays open before one trial attempt, default 30000
+    int connect_timeout_ms;       // Per attempt, default 5000
+    size_t max_buffered_bytes;    // Outbound bytes queued while reconnecting, 0 = sends fail instead
+    msock_on_state_change_cb state_cb;
+} msock_reconnect_config;
+
+struct msock_reconnect {
+    msock_reconnect_config config;
+    char host[MAXHOSTNAMELEN];
+    char port[16];
+
+    uint32_t attempt;              // Attempts since the last successful connect, drives the backoff
+    uint32_t consecutive_failures;
+    bool attempt_pending;          // Async connect started, result not reported yet
+    uint64_t next_attempt_ns;      // Standalone clients, see msock_client_service_reconnect
+    uint64_t timer_id;             // Clients on a msock_loop retry from a loop timer
+    msock_loop* loop;              // Loop the client is added back to once reconnected
+    msock_loop_handler handler;
+    size_t buffered_bytes;
+    uint64_t rng;
+};
+
+#define MSOCK_LOOP_READ  (1u << 0)
+#define MSOCK_LOOP_WRITE (1u << 1)
+#define MSOCK_LOOP_ERROR (1u << 2)
+
+typedef struct {
+    SOCKET sock;
+    msock_client* client; // NULL for raw sockets such as listeners
+    msock_loop_handler handler;
+    uint32_t generation;  // Bumped on removal so stale events are ignored
+    uint32_t interest;    // MSOCK_LOOP_READ/WRITE currently registered
+    uint64_t serviced_iteration;
+} msock_loop_entry;
+
+typedef struct {
+    uint32_t slot;
+    uint32_t generation;
+    uint32_t events;
+} msock_loop_event;
+
+typedef struct {
+    uint64_t deadline_ns;
+    uint64_t id;
+    uint32_t repeat_ms;
+    msock_on_timer_cb cb;
+    void* userdata;
+} msock_timer;
+
+// Readiness loop owning any mix of accepted and outbound connections, with timers and
+// write queues. epoll on Linux, poll/WSAPoll elsewhere.
+struct msock_loop {
+#ifdef __linux__
+    int epoll_fd;
+#else
+    struct pollfd* poll_fds;
+    uint32_t* poll_slots;
+#endif
+
+    msock_loop_entry* entries;
+    int entry_capacity;
+    int entry_count;
+    int* free_slots;
+    int free_count;
+
+    msock_loop_event events[MSOCK_LOOP_MAX_EVENTS];
+
+    int* requeued; // Slots serviced next iteration without waiting for readiness
+    int* requeued_swap;
+    int requeued_count;
+    uint64_t iteration;
+
+    int* corked; // Slots with sends held back during this iteration
+    int corked_count;
+    bool cork_enabled;
+    bool corking; // Set while callbacks of a corking loop run
+
+    msock_timer* timers; // Binary min-heap on deadline_ns
+    int timer_count;
+    int timer_capacity;
+    uint64_t next_timer_id;
+
+    uint64_t now_ns; // Cached once per wakeup, use msock_loop_now_ns instead of reading the clock
 
-    char ip_addr[INET_ADDRSTRLEN];
+    int wait_timeout_ms;     // -1 = block until there is activity or a timer is due
+    uint32_t spin_budget_us; // 0 = always block
+    int spin_cpu;            // -1 = don't pin the thread running the loop
+    bool spin_cpu_pinned;
+    msock_loop_stats stats;
+
+    char read_buffer[MSOCK_READ_BUFFER_SIZE]; // Scratch for readers that don't keep data around
 
     void* userdata;
 };
@@ -82,49 +531,399 @@ struct msock_server {
     msock_state socket_state;
 
     msock_client connected_clients[MSOCK_MAX_CLIENTS];
+    msock_client_cold connected_clients_cold[MSOCK_MAX_CLIENTS];
+    uint64_t active_slots[MSOCK_CLIENT_SLOT_WORDS]; // Bit i set = connected_clients[i] is in use
+
     msock_on_connect_cb connect_cb;
     msock_on_disconnect_cb disconnect_cb;
     msock_on_client_cb client_cb;
 
+    // Drain mode: set when data_cb is installed. The server reads each ready client
+    // until EAGAIN (edge-triggered on Linux) or until its per-iteration budget is spent.
+    msock_on_data_cb data_cb;
+    size_t drain_byte_budget;
+    uint32_t drain_read_budget;
+
+    msock_loop* loop;   // own_loop unless msock_server_set_loop shares another one
+    msock_loop own_loop;
+    int listener_slot;
+
+    msock_socket_options options; // Applied to the listener and inherited by accepted sockets
+    bool has_options;
+
+    // Relay mode, see msock_server_set_relay. relays is indexed like connected_clients.
+    msock_on_relay_upstream_cb relay_cb;
+    msock_relay* relays;
+    int relay_connect_timeout_ms;
+    msock_relay_stats relay_stats;
+    msock_balancer* balancer; // Load balancer mode, see msock_server_set_balancer
+
+    // Pub/sub, see msock_server_subscribe. Open addressing on the topic id.
+    msock_topic* topics;
+    uint32_t topic_capacity; // Power of two, 0 until the first subscribe
+    uint32_t topic_count;
+
+    // Rate limits, see msock_server_set_rate_limit
+    msock_rate_limit_config rate_limit;
+    bool rate_limited;
+    bool accept_paused;        // Listener left the loop until accept tokens refill
+    uint64_t rate_timer_id;
+    uint64_t rate_start_ns;
+    uint64_t rate_clock_ms;    // Advanced by the refill timer only
+    int64_t accept_tokens;     // Thousandths of a token
+    uint64_t accept_refilled_ms;
+    msock_rate_limit_stats rate_stats;
+
     void* userdata;
 };
 
+// Called on each loop thread after its server is created and before it listens,
+// to install callbacks, options and userdata.
+typedef bool (*msock_on_loop_setup_cb)(msock_server* server, int loop_index, void* userdata);
+
 typedef struct {
-    char* buffer;
-    size_t size;
-    size_t len;
-} msock_message;
+    int loop_count;
+    const int* cpus;         // Loop i is pinned to cpus[i], NULL = no pinning
+    bool numa_local;         // Allocate each loop's server on the NUMA node of its cpu
+    bool steer_incoming_cpu; // SO_INCOMING_CPU: prefer the loop on the cpu that handled the RX queue
+    msock_on_loop_setup_cb setup_cb;
+    void* userdata;
+} msock_server_group_config;
+
+typedef struct msock_server_group msock_server_group;
+
+typedef struct {
+    msock_server_group* group;
+    int index;
+    int cpu;
+    msock_server* server;
+    bool server_numa_local;
+    msock_thread thread;
+    volatile int status; // 0 = starting, 1 = listening, -1 = failed
+} msock_server_loop;
+
+// Several msock_server loops, one per thread, sharing a port through SO_REUSEPORT.
+struct msock_server_group {
+    msock_server_group_config config;
+    char ip[MAXHOSTNAMELEN];
+    char port[16];
+
+    msock_server_loop* loops;
+    volatile bool running;
+};
+
+// Frames: 12 byte little-endian header followed by the payload
+//   u32 length | u32 correlation_id | u16 flags | u16 transport
+#define MSOCK_FRAME_HEADER_SIZE 12
+#define MSOCK_FRAME_MAX_PAYLOAD (16u * 1024u * 1024u)
+
+// Transport bits belong to the library, flags are left to the application
+#define MSOCK_FRAME_TRANSPORT_COMPRESSED 0x0001 // Payload is u32 original length + msock_compress block
+#define MSOCK_FRAME_TRANSPORT_HELLO 0x0002      // Negotiation, payload is one byte of MSOCK_FRAME_FEATURE_* bits
+#define MSOCK_FRAME_TRANSPORT_STORED 0x0004     // Sent as is because it didn't shrink, but part of the compression history
+#define MSOCK_FRAME_TRANSPORT_CHECKSUM 0x0008   // Last 4 payload bytes are a CRC32C of the header and the payload before them
+
+#define MSOCK_FRAME_FEATURE_COMPRESSION 0x01
+
+typedef struct {
+    uint32_t length;         // Payload bytes after the header
+    uint32_t correlation_id; // Echoed back by the peer to match responses to requests
+    uint16_t flags;
+    uint16_t transport;      // MSOCK_FRAME_TRANSPORT_* bits
+} msock_frame_header;
+
+// Reassembles frames out of a byte stream
+typedef struct {
+    char* data;
+    size_t start; // First unconsumed byte
+    size_t len;   // End of buffered bytes
+    size_t capacity;
+    size_t pending_consume; // Size of the frame returned by the last msock_frame_reader_next
+    uint64_t checksum_failures; // Frames dropped because their CRC32C trailer didn't match
+} msock_frame_reader;
+
+// LZ4 style block compression against a sliding history of earlier messages, so small
+// repetitive messages compress against what the connection already carried
+#define MSOCK_COMPRESS_WINDOW (64 * 1024) // History size, also the largest message compressed
+#define MSOCK_COMPRESS_HASH_BITS 12
+#define MSOCK_COMPRESS_DEFAULT_THRESHOLD 64
+
+// One direction of a connection. Sender and receiver slide their windows identically.
+typedef struct {
+    char* window;   // 2 * MSOCK_COMPRESS_WINDOW of history and current message
+    size_t pos;     // Where the next message goes
+    int32_t* table; // Compressor only, window positions by hash of 4 bytes, -1 = empty
+} msock_compress_stream;
+
+typedef struct {
+    uint64_t frames_compressed;
+    uint64_t frames_uncompressed; // Too small, too large, or not negotiated
+    uint64_t frames_stored;       // Incompressible, sent as is but kept in the history
+    uint64_t bytes_before;        // Payload bytes of compressed frames
+    uint64_t bytes_after;         // What they went out as
+    uint64_t frames_decompressed;
+    uint64_t decompress_errors;
+} msock_frame_compression_stats;
+
+// Per connection compression state, enabled once both sides exchanged a HELLO
+typedef struct {
+    bool offered;
+    bool enabled;
+    bool checksum;    // Add CRC32C trailers to frames sent through this state
+    size_t threshold; // Payloads below this go out as they are
+    msock_compress_stream tx;
+    msock_compress_stream rx;
+    msock_frame_compression_stats stats;
+} msock_frame_compression;
+
+typedef struct msock_pipeline msock_pipeline;
+
+// error is 0 for a response, non-zero when the request failed (connection lost or pipeline closed)
+typedef void (*msock_on_response_cb)(msock_pipeline* pipeline, uint32_t correlation_id, const char* payload, size_t len, int error, void* userdata);
+
+typedef struct {
+    uint32_t correlation_id;
+    bool in_use;
+    msock_on_response_cb cb;
+    void* userdata;
+} msock_pipeline_request;
+
+typedef struct {
+    uint64_t requests_sent;
+    uint64_t responses_received;
+    uint64_t unmatched_responses; // Correlation id not in flight, dropped
+    uint32_t max_in_flight;
+} msock_pipeline_stats;
+
+// Pipelined request/response on one client: requests are written back to back and
+// responses are matched by correlation id, at most window of them in flight.
+struct msock_pipeline {
+    msock_client* client;
+    msock_pipeline_request* requests; // Indexed by correlation_id % window
+    uint32_t window;
+    uint32_t in_flight;
+    uint32_t next_id;
+
+    msock_frame_reader reader;
+    msock_pipeline_stats stats;
+    void* userdata;
+};
+
+typedef struct {
+    int max_idle_per_key;         // Idle connections kept per host:port
+    int max_active_per_key;       // Checked out at once per host:port, 0 = unlimited
+    int min_idle_per_key;         // Target for msock_pool_prewarm
+    uint32_t idle_timeout_ms;     // Idle connections older than this are closed, 0 = never
+    int connect_timeout_ms;       // For prewarm connects, 0 = no timeout
+    const msock_socket_options* options; // Applied to every new connection, may be NULL
+} msock_pool_config;
+
+typedef struct {
+    uint64_t checkouts;
+    uint64_t reused;        // Checkouts served from an idle connection
+    uint64_t connected;     // New connections made
+    uint64_t connect_failures;
+    uint64_t evicted_dead;  // Idle connections found closed or with stray data on checkout
+    uint64_t evicted_idle;  // Idle connections closed by idle_timeout_ms
+    uint64_t rejected;      // Checkouts refused by max_active_per_key
+} msock_pool_stats;
+
+typedef struct {
+    msock_client client; // Must stay first, checkin maps the client back to its entry
+    int key;
+    uint64_t idle_since_ns;
+} msock_pool_conn;
+
+typedef struct {
+    char host[MAXHOSTNAMELEN];
+    char port[16];
+    struct sockaddr_in addr; // Resolved once, new connections skip getaddrinfo
+    bool resolved;
+
+    msock_pool_conn** idle;  // Stack, most recently used on top so it's the warmest
+    int idle_count;
+    int active_count;
+} msock_pool_key;
+
+// Keyed pool of outbound connections (host:port -> idle msock_clients)
+typedef struct {
+    msock_pool_config config;
+    msock_socket_options options;
+    bool has_options;
+
+    msock_pool_key* keys;
+    int key_count;
+    int key_capacity;
+
+    msock_pool_stats stats;
+} msock_pool;
 
 bool msock_init();
 bool msock_deinit();
 bool msock_get_local_ip(char* buffer, size_t buffer_len);
 
 void msock_set_nonblocking(SOCKET sock);
+void msock_set_blocking(SOCKET sock);
+bool msock_apply_socket_options(SOCKET sock, const msock_socket_options* options, bool listener);
+bool msock_set_thread_affinity(int cpu);
+uint64_t msock_time_ns();
+
+int msock_resolve(const char* host, const char* port, struct sockaddr_in* addr);
+int msock_last_resolve_error();
+const char* msock_resolve_error_string(int error);
+void msock_resolver_configure(const msock_resolver_config* config);
+bool msock_resolver_start();
+void msock_resolver_stop();
+void msock_resolver_prefetch(const char* host, const char* port);
+void msock_resolver_invalidate(const char* host, const char* port);
+void msock_resolver_flush();
+msock_resolver_stats msock_resolver_get_stats();
 
 bool msock_client_create(msock_client* client_result);
 bool msock_client_connect(msock_client* client_socket, const char* ip, const char* port);
+bool msock_client_connect_addr(msock_client* client_socket, const struct sockaddr_in* addr);
+bool msock_client_connect_async(msock_client* client_socket, const char* ip, const char* port, int timeout_ms, msock_on_connect_result_cb cb);
+bool msock_client_connect_addr_async(msock_client* client_socket, const struct sockaddr_in* addr, int timeout_ms, msock_on_connect_result_cb cb);
+int msock_client_poll_connects(msock_client** clients, int count, int timeout_ms);
+bool msock_client_is_connecting(msock_client* client_socket);
 void msock_client_set_userdata(msock_client* client, void* userdata);
+void* msock_client_get_userdata(msock_client* client);
+const char* msock_client_get_ip(msock_client* client);
+const msock_client_stats* msock_client_get_stats(msock_client* client);
+void msock_client_set_options(msock_client* client, const msock_socket_options* options);
 bool msock_client_is_connected(msock_client* client_socket);
 bool msock_client_close(msock_client* client_socket);
+void msock_client_pause_reading(msock_client* client_socket, bool paused);
+void msock_client_want_writable(msock_client* client_socket, bool wanted);
+bool msock_client_enable_reconnect(msock_client* client_socket, const char* ip, const char* port, const msock_reconnect_config* config);
+void msock_client_disable_reconnect(msock_client* client_socket);
+bool msock_client_service_reconnect(msock_client* client_socket);
 
 bool msock_client_send(msock_client* client_socket, msock_message* msg);
+bool msock_client_send_buffer(msock_client* client_socket, msock_buffer* buffer);
+bool msock_client_sendv(msock_client* client_socket, const msock_iovec* iov, int count);
+bool msock_client_sendfile(msock_client* client_socket, int fd, int64_t offset, size_t len);
+int msock_client_reap_zerocopy(msock_client* client_socket);
+bool msock_client_flush(msock_client* client_socket);
+bool msock_client_has_pending_writes(msock_client* client_socket);
 ssize_t msock_client_receive(msock_client* client_socket, msock_message* result_msg);
 
+bool msock_splice_create(msock_splice* splice, msock_client* from, msock_client* to);
+void msock_splice_close(msock_splice* splice);
+ssize_t msock_splice_forward(msock_splice* splice, size_t max_bytes);
+
+msock_buffer* msock_buffer_acquire(size_t capacity);
+void msock_buffer_retain(msock_buffer* buffer);
+void msock_buffer_release(msock_buffer* buffer);
+
+bool msock_loop_create(msock_loop* loop_result);
+bool msock_loop_close(msock_loop* loop);
+bool msock_loop_run(msock_loop* loop);
+bool msock_loop_add_client(msock_loop* loop, msock_client* client, const msock_loop_handler* handler);
+void msock_loop_remove_client(msock_loop* loop, msock_client* client);
+int msock_loop_add_socket(msock_loop* loop, SOCKET sock, const msock_loop_handler* handler);
+void msock_loop_remove_socket(msock_loop* loop, int slot);
+void msock_loop_requeue(msock_loop* loop, msock_client* client);
+uint64_t msock_loop_add_timer(msock_loop* loop, uint32_t delay_ms, uint32_t repeat_ms, msock_on_timer_cb cb, void* userdata);
+bool msock_loop_cancel_timer(msock_loop* loop, uint64_t timer_id);
+uint64_t msock_loop_now_ns(msock_loop* loop);
+void msock_loop_set_spin(msock_loop* loop, uint32_t spin_budget_us, int cpu);
+void msock_loop_set_wait_timeout(msock_loop* loop, int timeout_ms);
+void msock_loop_set_cork(msock_loop* loop, bool enabled);
+const msock_loop_stats* msock_loop_get_stats(msock_loop* loop);
+void msock_loop_reset_stats(msock_loop* loop);
+
 bool msock_server_create(msock_server* server_result);
 void msock_server_set_userdata(msock_server* server, void* userdata);
+void msock_server_set_options(msock_server* server, const msock_socket_options* options);
 bool msock_server_listen(msock_server* server_socket, const char* ip, const char* port);
 bool msock_server_is_listening(msock_server* server_socket);
 bool msock_server_close(msock_server* server_socket);
 bool msock_server_run(msock_server* server);
+void msock_server_set_loop(msock_server* server, msock_loop* loop);
+void msock_server_set_spin(msock_server* server, uint32_t spin_budget_us, int cpu);
+void msock_server_set_wait_timeout(msock_server* server, int timeout_ms);
+void msock_server_set_cork(msock_server* server, bool enabled);
+const msock_loop_stats* msock_server_get_loop_stats(msock_server* server);
+void msock_server_reset_loop_stats(msock_server* server);
 
 bool msock_server_broadcast(msock_server* server_socket, msock_message* boardcast_msg, msock_client* sender_socket);
+int msock_server_get_client_count(msock_server* server_socket);
 
 void msock_server_set_connect_cb(msock_server* server_socket, msock_on_connect_cb cb);
 void msock_server_set_disconnect_cb(msock_server* server_socket, msock_on_disconnect_cb cb);
 void msock_server_set_client_cb(msock_server* server_socket, msock_on_client_cb cb);
+void msock_server_set_drain(msock_server* server_socket, msock_on_data_cb cb, size_t byte_budget, uint32_t read_budget);
+void msock_server_set_rate_limit(msock_server* server_socket, const msock_rate_limit_config* config);
+const msock_rate_limit_stats* msock_server_get_rate_limit_stats(msock_server* server_socket);
+bool msock_server_set_relay(msock_server* server_socket, msock_on_relay_upstream_cb cb, int connect_timeout_ms);
+const msock_relay_stats* msock_server_get_relay_stats(msock_server* server_socket);
+bool msock_server_set_balancer(msock_server* server_socket, const msock_balancer_config* config, int connect_timeout_ms);
+int msock_server_add_upstream(msock_server* server_socket, const char* ip, const char* port);
+int msock_server_get_upstream_count(msock_server* server_socket);
+const msock_upstream* msock_server_get_upstream(msock_server* server_socket, int index);
+
+bool msock_server_subscribe(msock_server* server_socket, msock_client* client, uint32_t topic);
+bool msock_server_unsubscribe(msock_server* server_socket, msock_client* client, uint32_t topic);
+bool msock_server_is_subscribed(msock_server* server_socket, msock_client* client, uint32_t topic);
+uint32_t msock_server_get_subscriber_count(msock_server* server_socket, uint32_t topic);
+int msock_server_publish(msock_server* server_socket, uint32_t topic, const void* data, size_t len, msock_client* exclude);
+int msock_server_publish_buffer(msock_server* server_socket, uint32_t topic, msock_buffer* buffer, msock_client* exclude);
+
+bool msock_server_group_start(msock_server_group* group, const msock_server_group_config* config, const char* ip, const char* port);
+void msock_server_group_stop(msock_server_group* group);
+
+void msock_frame_write_header(char* out, const msock_frame_header* header);
+void msock_frame_read_header(const char* in, msock_frame_header* header);
+bool msock_client_send_frame(msock_client* client_socket, uint32_t correlation_id, uint16_t flags, const char* payload, size_t len);
+bool msock_client_send_frame_checked(msock_client* client_socket, uint32_t correlation_id, uint16_t flags, const char* payload, size_t len);
+uint32_t msock_crc32c(uint32_t crc, const void* data, size_t len);
+bool msock_frame_append_checksum(msock_buffer* buffer);
+void msock_frame_reader_init(msock_frame_reader* reader);
+void msock_frame_reader_free(msock_frame_reader* reader);
+bool msock_frame_reader_feed(msock_frame_reader* reader, const char* data, size_t len);
+int msock_frame_reader_next(msock_frame_reader* reader, msock_frame_header* header, const char** payload);
+
+bool msock_compress_stream_init(msock_compress_stream* stream, bool compressor);
+void msock_compress_stream_free(msock_compress_stream* stream);
+size_t msock_compress_bound(size_t len);
+size_t msock_compress(msock_compress_stream* stream, const char* src, size_t len, char* dst);
+bool msock_compress_stream_append(msock_compress_stream* stream, const char* data, size_t len);
+const char* msock_decompress(msock_compress_stream* stream, const char* src, size_t len, size_t original_len);
+
+void msock_frame_compression_init(msock_frame_compression* compression, size_t threshold);
+void msock_frame_compression_free(msock_frame_compression* compression);
+bool msock_frame_compression_offer(msock_frame_compression* compression, msock_client* client_socket);
+bool msock_client_send_frame_compressed(msock_client* client_socket, msock_frame_compression* compression, uint32_t correlation_id, uint16_t flags, const char* payload, size_t len);
+int msock_frame_compression_receive(msock_frame_compression* compression, msock_client* client_socket, msock_frame_header* header, const char** payload);
+
+bool msock_pipeline_create(msock_pipeline* pipeline_result, msock_client* client, uint32_t window);
+void msock_pipeline_close(msock_pipeline* pipeline);
+bool msock_pipeline_can_send(msock_pipeline* pipeline);
+bool msock_pipeline_send(msock_pipeline* pipeline, const char* payload, size_t len, msock_on_response_cb cb, void* userdata);
+bool msock_pipeline_process(msock_pipeline* pipeline, const char* data, size_t len);
+bool msock_pipeline_on_readable(msock_loop* loop, msock_client* client, void* ctx);
+
+bool msock_pool_create(msock_pool* pool_result, const msock_pool_config* config);
+void msock_pool_close(msock_pool* pool);
+msock_client* msock_pool_checkout(msock_pool* pool, const char* host, const char* port);
+void msock_pool_checkin(msock_pool* pool, msock_client* client, bool reusable);
+int msock_pool_prewarm(msock_pool* pool, const char* host, const char* port);
+void msock_pool_expire_idle(msock_pool* pool);
+const msock_pool_stats* msock_pool_get_stats(msock_pool* pool);
 
 #ifdef MSOCK_IMPLEMENTATION
 
+#if defined(__x86_64__) || defined(_M_X64)
+#define MSOCK_CRC32C_SSE42
+#include <nmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
 //BASE UTIL
 
 bool msock_init() {
@@ -137,6 +936,7 @@ bool msock_init() {
         return false;
     }
 #endif
+    msock_crc32c(0, NULL, 0); // Picks the CRC32C implementation before any threads want it
     return true;
 }
 
@@ -195,321 +995,4806 @@ void msock_set_nonblocking(SOCKET sock) {
 #endif
 }
 
-//MSOCK_CLIENT Implementations
-
-bool msock_client_create(msock_client* client_result) {
-
-    SOCKET sock = INVALID_SOCKET;
-    sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-    if (sock == INVALID_SOCKET) {
-        printf("socket() failed: %d\n", WSAGetLastError());
+static bool msock_internal_setsockopt_int(SOCKET sock, int level, int name, int value, const char* name_str) {
+    if (setsockopt(sock, level, name, (const char*)&value, sizeof(value)) == SOCKET_ERROR) {
+        printf("setsockopt(%s) failed: %d\n", name_str, MSOCK_LAST_ERROR);
         return false;
     }
-
-    client_result->native_socket = sock;
-    client_result->socket_state = MSOCK_STATE_DISCONNECTED;
-
     return true;
 }
 
-void msock_client_set_userdata(msock_client* client, void* userdata) {
-    client->userdata = userdata;
-}
-
-bool msock_client_connect(msock_client* client_socket, const char* ip, const char* port) {
+#define MSOCK_INTERNAL_SETOPT(sock, level, name, value) msock_internal_setsockopt_int(sock, level, name, value, #name)
 
-    if (!client_socket || !ip || !port) return false;
+bool msock_apply_socket_options(SOCKET sock, const msock_socket_options* options, bool listener) {
+    if (!options) return true;
 
-    struct addrinfo hints = { 0 };
-    hints.ai_family = AF_INET;
-    hints.ai_socktype = SOCK_STREAM;
+    bool success = true;
 
-    struct addrinfo* info;
-    getaddrinfo(ip, port, &hints, &info);
+    if (options->tcp_nodelay) success &= MSOCK_INTERNAL_SETOPT(sock, IPPROTO_TCP, TCP_NODELAY, 1);
+#ifdef TCP_QUICKACK
+    if (options->tcp_quickack && !listener) success &= MSOCK_INTERNAL_SETOPT(sock, IPPROTO_TCP, TCP_QUICKACK, 1);
+#endif
+    if (options->send_buffer_size > 0) success &= MSOCK_INTERNAL_SETOPT(sock, SOL_SOCKET, SO_SNDBUF, options->send_buffer_size);
+    if (options->receive_buffer_size > 0) success &= MSOCK_INTERNAL_SETOPT(sock, SOL_SOCKET, SO_RCVBUF, options->receive_buffer_size);
 
-    bool success = connect(client_socket->native_socket, info->ai_addr, (int)info->ai_addrlen) == 0;
-    freeaddrinfo(info);
+    if (options->keepalive) {
+        success &= MSOCK_INTERNAL_SETOPT(sock, SOL_SOCKET, SO_KEEPALIVE, 1);
+#ifdef TCP_KEEPIDLE
+        if (options->keepalive_idle_s > 0) success &= MSOCK_INTERNAL_SETOPT(sock, IPPROTO_TCP, TCP_KEEPIDLE, options->keepalive_idle_s);
+#endif
+#ifdef TCP_KEEPINTVL
+        if (options->keepalive_interval_s > 0) success &= MSOCK_INTERNAL_SETOPT(sock, IPPROTO_TCP, TCP_KEEPINTVL, options->keepalive_interval_s);
+#endif
+#ifdef TCP_KEEPCNT
+        if (options->keepalive_count > 0) success &= MSOCK_INTERNAL_SETOPT(sock, IPPROTO_TCP, TCP_KEEPCNT, options->keepalive_count);
+#endif
+    }
 
-    if (!success) {
+#ifdef TCP_USER_TIMEOUT
+    if (options->user_timeout_ms > 0) success &= MSOCK_INTERNAL_SETOPT(sock, IPPROTO_TCP, TCP_USER_TIMEOUT, options->user_timeout_ms);
+#endif
+#ifdef SO_BUSY_POLL
+    if (options->busy_poll_us > 0) success &= MSOCK_INTERNAL_SETOPT(sock, SOL_SOCKET, SO_BUSY_POLL, options->busy_poll_us);
+#endif
 
+    if (listener) {
+#ifdef TCP_DEFER_ACCEPT
+        if (options->defer_accept_s > 0) success &= MSOCK_INTERNAL_SETOPT(sock, IPPROTO_TCP, TCP_DEFER_ACCEPT, options->defer_accept_s);
+#endif
+#ifdef TCP_FASTOPEN
+        if (options->fastopen_queue_len > 0) success &= MSOCK_INTERNAL_SETOPT(sock, IPPROTO_TCP, TCP_FASTOPEN, options->fastopen_queue_len);
+#endif
+    } else {
+#ifdef TCP_FASTOPEN_CONNECT
+        if (options->fastopen_queue_len > 0) success &= MSOCK_INTERNAL_SETOPT(sock, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, 1);
+#endif
     }
 
-    client_socket->socket_state = MSOCK_STATE_CONNECTED;
     return success;
 }
 
-bool msock_client_is_connected(msock_client* client_socket) {
-    return client_socket->socket_state == MSOCK_STATE_CONNECTED;
-}
-
-bool msock_client_close(msock_client* client_socket) {
-    bool success = true;
+bool msock_set_thread_affinity(int cpu) {
+    if (cpu < 0) return false;
 
-    if (client_socket->socket_state == MSOCK_STATE_DISCONNECTED) return success;
-    if (shutdown(client_socket->native_socket, SD_SEND) == SOCKET_ERROR) {
-        printf("shutdown() failed: %d\n", WSAGetLastError());
-        success = false;
+#ifdef _WIN32
+    if (cpu >= (int)(sizeof(DWORD_PTR) * 8)) return false;
+    if (SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu) == 0) {
+        printf("SetThreadAffinityMask() failed: %lu\n", GetLastError());
+        return false;
+    }
+    return true;
+#elif defined(__linux__)
+    // Raw syscall so the header doesn't depend on _GNU_SOURCE being defined before <sched.h>
+    unsigned long mask[1024 / (8 * sizeof(unsigned long))] = { 0 };
+    if (cpu >= 1024) return false;
+    mask[cpu / (8 * sizeof(unsigned long))] |= 1ul << (cpu % (8 * sizeof(unsigned long)));
+
+    if (syscall(SYS_sched_setaffinity, 0, sizeof(mask), mask) != 0) {
+        printf("sched_setaffinity() failed: %d\n", errno);
+        return false;
     }
+    return true;
+#else
+    return false;
+#endif
+}
 
-    closesocket(client_socket->native_socket);
+uint64_t msock_time_ns() {
+#ifdef _WIN32
+    static LARGE_INTEGER frequency = { 0 };
+    if (frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
 
-    client_socket->socket_state = MSOCK_STATE_DISCONNECTED;
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)((double)counter.QuadPart * 1e9 / (double)frequency.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
 
-    return success;
+static void msock_internal_sleep_ms(int ms) {
+#ifdef _WIN32
+    Sleep(ms);
+#else
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000l };
+    nanosleep(&ts, NULL);
+#endif
 }
 
-ssize_t msock_client_receive(msock_client* client_socket, msock_message* result_msg) {
-    if (client_socket->socket_state == MSOCK_STATE_DISCONNECTED) return -1;
+static int msock_internal_numa_node_of_cpu(int cpu) {
+#ifdef _WIN32
+    USHORT node = 0;
+    PROCESSOR_NUMBER processor = { 0 };
+    processor.Number = (BYTE)cpu;
+    if (!GetNumaProcessorNodeEx(&processor, &node)) return -1;
+    return (int)node;
+#elif defined(__linux__) && defined(SYS_getcpu)
+    // Caller is already pinned to cpu, so ask the kernel which node we run on
+    (void)cpu;
+    unsigned int cur_cpu = 0, node = 0;
+    if (syscall(SYS_getcpu, &cur_cpu, &node, NULL) != 0) return -1;
+    return (int)node;
+#else
+    (void)cpu;
+    return -1;
+#endif
+}
 
-    int bytes_received = recv(client_socket->native_socket, result_msg->buffer, result_msg->size - 1, 0); //NOTE: recv is a blocking function
+// Allocates zeroed memory on the NUMA node of cpu. On Linux the pages are bound
+// with mbind(MPOL_PREFERRED) before first touch, elsewhere falls back to first touch.
+static void* msock_internal_alloc_local(size_t size, int cpu) {
+    int node = cpu >= 0 ? msock_internal_numa_node_of_cpu(cpu) : -1;
+    (void)node; // Unused where there is no way to bind pages to a node
 
-    if (bytes_received == 0) {
-        printf("Connection closed!\n");
-        client_socket->socket_state = MSOCK_STATE_DISCONNECTED;
-        return 0;
+#ifdef _WIN32
+    if (node >= 0) {
+        return VirtualAllocExNuma(GetCurrentProcess(), NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, (DWORD)node);
     }
+    return VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+    void* ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) return NULL;
 
-    if (bytes_received < 0) {
-        if (MSOCK_IS_WOULDBLOCK(MSOCK_LAST_ERROR)) return 0;
-
-        client_socket->socket_state = MSOCK_STATE_DISCONNECTED;
-        return -1;
+#if defined(__linux__) && defined(SYS_mbind)
+    if (node >= 0 && node < 64) {
+        unsigned long nodemask = 1ul << node;
+        syscall(SYS_mbind, ptr, size, 1 /* MPOL_PREFERRED */, &nodemask, 64, 0); // Best effort, ENOSYS on non-NUMA kernels
     }
+#endif
+    memset(ptr, 0, size);
+    return ptr;
+#endif
+}
 
-    result_msg->buffer[bytes_received] = '\0';
-    result_msg->len = bytes_received;
+static void msock_internal_free_local(void* ptr, size_t size) {
+    if (!ptr) return;
+#ifdef _WIN32
+    (void)size;
+    VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+    munmap(ptr, size);
+#endif
+}
 
-    return bytes_received;
+void msock_set_blocking(SOCKET sock) {
+#ifdef _WIN32
+    u_long mode = 0;
+    ioctlsocket(sock, FIONBIO, &mode);
+#else
+    int flags = fcntl(sock, F_GETFL, 0);
+    fcntl(sock, F_SETFL, flags & ~O_NONBLOCK);
+#endif
 }
 
-bool msock_client_send(msock_client* client_socket, msock_message* msg) {
-    int success = send(client_socket->native_socket, msg->buffer, msg->len, 0);
-    if (success == SOCKET_ERROR) {
-        printf("send() failed: %d\n", WSAGetLastError());
-        return false;
-    }
+// Index of the lowest set bit, x must not be 0
+static int msock_internal_ctz64(uint64_t x) {
+#ifdef _WIN32
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return (int)index;
+#else
+    return __builtin_ctzll(x);
+#endif
+}
 
-    return true;
+static int msock_internal_popcount64(uint64_t x) {
+#ifdef _WIN32
+    return (int)__popcnt64(x);
+#else
+    return __builtin_popcountll(x);
+#endif
 }
 
-//MSOCK_SERVER Implementations
+//MSOCK_BUFFER Implementations
 
-bool msock_server_create(msock_server* server_result) {
-    SOCKET sock = INVALID_SOCKET;
-    sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-    if (sock == INVALID_SOCKET) {
-        printf("socket() failed: %d\n", WSAGetLastError());
-        return false;
-    }
+static const size_t msock_internal_buffer_classes[] = { 256, 4 * 1024, 16 * 1024 };
+#define MSOCK_BUFFER_CLASS_COUNT (sizeof(msock_internal_buffer_classes) / sizeof(msock_internal_buffer_classes[0]))
 
-    server_result->native_socket = sock;
-    server_result->socket_state = MSOCK_STATE_UNBOUND;
+// Per thread so loop threads never contend and recycled memory stays on their NUMA node
+static MSOCK_THREAD_LOCAL msock_buffer* msock_internal_buffer_pool[MSOCK_BUFFER_CLASS_COUNT];
+static MSOCK_THREAD_LOCAL int msock_internal_buffer_pool_count[MSOCK_BUFFER_CLASS_COUNT];
+static MSOCK_THREAD_LOCAL msock_write_node* msock_internal_node_pool;
+static MSOCK_THREAD_LOCAL int msock_internal_node_pool_count;
 
-    memset(server_result->connected_clients, 0, sizeof(server_result->connected_clients));
-    for (int i = 0; i < MSOCK_MAX_CLIENTS; i++) {
-        server_result->connected_clients[i].socket_state = MSOCK_STATE_DISCONNECTED;
+static int msock_internal_buffer_class(size_t capacity) {
+    for (int i = 0; i < (int)MSOCK_BUFFER_CLASS_COUNT; i++) {
+        if (capacity <= msock_internal_buffer_classes[i]) return i;
     }
-
-    return true;
+    return -1;
 }
 
-void msock_server_set_userdata(msock_server* server, void* userdata) {
-    server->userdata = userdata;
+msock_buffer* msock_buffer_acquire(size_t capacity) {
+    int size_class = msock_internal_buffer_class(capacity);
+    msock_buffer* buffer = NULL;
+
+    if (size_class >= 0) {
+        capacity = msock_internal_buffer_classes[size_class];
+        buffer = msock_internal_buffer_pool[size_class];
+        if (buffer) {
+            msock_internal_buffer_pool[size_class] = buffer->next_free;
+            msock_internal_buffer_pool_count[size_class]--;
+        }
+    }
+
+    if (!buffer) {
+        buffer = (msock_buffer*)malloc(sizeof(msock_buffer) + capacity);
+        if (!buffer) {
+            printf("malloc() failed for buffer of %zu bytes\n", capacity);
+            return NULL;
+        }
+        buffer->data = (char*)(buffer + 1);
+        buffer->capacity = capacity;
+    }
+
+    buffer->next_free = NULL;
+    buffer->len = 0;
+    buffer->refcount = 1;
+    return buffer;
 }
 
-bool msock_server_listen(msock_server* server_socket, const char* ip, const char* port) {
-    msock_set_nonblocking(server_socket->native_socket);
+void msock_buffer_retain(msock_buffer* buffer) {
+    buffer->refcount++;
+}
+
+void msock_buffer_release(msock_buffer* buffer) {
+    if (!buffer || --buffer->refcount > 0) return;
+
+    int size_class = msock_internal_buffer_class(buffer->capacity);
+    if (size_class >= 0 && msock_internal_buffer_classes[size_class] == buffer->capacity &&
+        msock_internal_buffer_pool_count[size_class] < MSOCK_BUFFER_POOL_MAX_FREE) {
+        buffer->next_free = msock_internal_buffer_pool[size_class];
+        msock_internal_buffer_pool[size_class] = buffer;
+        msock_internal_buffer_pool_count[size_class]++;
+        return;
+    }
+
+    free(buffer);
+}
+
+static msock_write_node* msock_internal_node_acquire() {
+    msock_write_node* node = msock_internal_node_pool;
+    if (node) {
+        msock_internal_node_pool = node->next;
+        msock_internal_node_pool_count--;
+    } else {
+        node = (msock_write_node*)malloc(sizeof(msock_write_node));
+        if (!node) return NULL;
+    }
+
+    memset(node, 0, sizeof(*node));
+    return node;
+}
+
+static void msock_internal_node_release(msock_write_node* node) {
+    msock_buffer_release(node->buffer);
+
+    if (msock_internal_node_pool_count >= MSOCK_WRITE_NODE_POOL_MAX_FREE) {
+        free(node);
+        return;
+    }
+    node->next = msock_internal_node_pool;
+    msock_internal_node_pool = node;
+    msock_internal_node_pool_count++;
+}
+
+//MSOCK_RESOLVER Implementations
+
+typedef struct {
+    char host[MAXHOSTNAMELEN];
+    char port[16];
+    uint32_t hash;
+    bool used;
+    bool pending;  // Queued by msock_resolver_prefetch, no answer yet
+    bool touched;  // Looked up since the background thread last refreshed it
+    int error;     // 0 or the getaddrinfo error
+    struct sockaddr_in addr;
+    uint64_t expires_ns;
+    uint64_t last_used_ns;
+} msock_resolver_entry;
+
+static struct {
+    msock_mutex lock;
+    msock_resolver_entry entries[MSOCK_RESOLVER_CACHE_SIZE];
+    msock_resolver_config config;
+    msock_resolver_stats stats;
+    msock_thread thread;
+    volatile bool running;
+} msock_internal_resolver = { .lock = MSOCK_MUTEX_INIT };
+
+static MSOCK_THREAD_LOCAL int msock_internal_last_resolve_error = 0;
+
+static uint32_t msock_internal_resolver_hash(const char* host, const char* port) {
+    // FNV-1a over "host:port"
+    uint32_t hash = 2166136261u;
+    for (const char* c = host; *c; c++) hash = (hash ^ (uint8_t)*c) * 16777619u;
+    hash = (hash ^ ':') * 16777619u;
+    for (const char* c = port; *c; c++) hash = (hash ^ (uint8_t)*c) * 16777619u;
+    return hash;
+}
+
+// Caller holds the lock
+static msock_resolver_entry* msock_internal_resolver_find(const char* host, const char* port, uint32_t hash) {
+    for (int i = 0; i < MSOCK_RESOLVER_CACHE_SIZE; i++) {
+        msock_resolver_entry* entry = &msock_internal_resolver.entries[i];
+        if (entry->used && entry->hash == hash && strcmp(entry->host, host) == 0 && strcmp(entry->port, port) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// Caller holds the lock. Reuses a free slot or evicts the least recently used entry.
+static msock_resolver_entry* msock_internal_resolver_slot(const char* host, const char* port, uint32_t hash) {
+    msock_resolver_entry* entry = msock_internal_resolver_find(host, port, hash);
+    if (entry) return entry;
+
+    entry = &msock_internal_resolver.entries[0];
+    for (int i = 0; i < MSOCK_RESOLVER_CACHE_SIZE; i++) {
+        msock_resolver_entry* candidate = &msock_internal_resolver.entries[i];
+        if (!candidate->used) {
+            entry = candidate;
+            break;
+        }
+        if (candidate->last_used_ns < entry->last_used_ns) entry = candidate;
+    }
+
+    memset(entry, 0, sizeof(*entry));
+    snprintf(entry->host, sizeof(entry->host), "%s", host);
+    snprintf(entry->port, sizeof(entry->port), "%s", port);
+    entry->hash = hash;
+    entry->used = true;
+    return entry;
+}
 
+static int msock_internal_getaddrinfo(const char* host, const char* port, struct sockaddr_in* addr) {
     struct addrinfo hints = { 0 };
     hints.ai_family = AF_INET;
     hints.ai_socktype = SOCK_STREAM;
 
-    struct addrinfo* info;
-    getaddrinfo(ip, port, &hints, &info);
+    struct addrinfo* info = NULL;
+    int error = getaddrinfo(host[0] ? host : NULL, port, &hints, &info);
+    if (error != 0) return error;
+    if (info == NULL) return EAI_NONAME;
 
-    int success = bind(server_socket->native_socket, info->ai_addr, (int)info->ai_addrlen);
-    if (success == SOCKET_ERROR) {
-        printf("bind() failed: %d\n", WSAGetLastError());
-        return false;
-    }
+    memcpy(addr, info->ai_addr, sizeof(struct sockaddr_in));
     freeaddrinfo(info);
 
-    success = listen(server_socket->native_socket, SOMAXCONN);
-    if (success == SOCKET_ERROR) {
-        printf("listen() failed: %d\n", WSAGetLastError());
-        return false;
-    }
+    return 0;
+}
 
-    server_socket->socket_state = MSOCK_STATE_LISTENING;
+static void msock_internal_resolver_store(const char* host, const char* port, uint32_t hash, int error, const struct sockaddr_in* addr, uint64_t now) {
+    msock_mutex_lock(&msock_internal_resolver.lock);
 
-    return true;
+    const msock_resolver_config* config = &msock_internal_resolver.config;
+    uint32_t ttl_ms = error == 0 ? config->ttl_ms : config->negative_ttl_ms;
+
+    msock_resolver_entry* entry = msock_internal_resolver_slot(host, port, hash);
+    entry->pending = false;
+    entry->error = error;
+    if (error == 0) entry->addr = *addr;
+    entry->expires_ns = now + (uint64_t)ttl_ms * 1000000ull;
+    if (entry->last_used_ns == 0) entry->last_used_ns = now;
+
+    if (error != 0) msock_internal_resolver.stats.failures++;
+
+    msock_mutex_unlock(&msock_internal_resolver.lock);
 }
 
-bool msock_server_is_listening(msock_server* server_socket) {
-    return server_socket->socket_state == MSOCK_STATE_LISTENING;
+static void msock_internal_resolver_defaults() {
+    msock_resolver_config* config = &msock_internal_resolver.config;
+    if (config->ttl_ms == 0) config->ttl_ms = MSOCK_RESOLVER_DEFAULT_TTL_MS;
+    if (config->negative_ttl_ms == 0) config->negative_ttl_ms = MSOCK_RESOLVER_DEFAULT_NEGATIVE_TTL_MS;
+    if (config->refresh_interval_ms == 0) config->refresh_interval_ms = MSOCK_RESOLVER_DEFAULT_REFRESH_MS;
 }
 
-bool msock_server_close(msock_server* server_socket) {
-    bool success = true;
+// Resolves host:port (IPv4) through the cache. Returns 0 on success or the getaddrinfo
+// error, which is also kept for msock_last_resolve_error. A NULL host means loopback.
+int msock_resolve(const char* host, const char* port, struct sockaddr_in* addr) {
+    if (!host) host = "";
+    if (!port) port = "";
 
-    for (int i = 0; i < MSOCK_MAX_CLIENTS; i++) {
-        msock_client* client = &server_socket->connected_clients[i];
+    uint32_t hash = msock_internal_resolver_hash(host, port);
+    uint64_t now = msock_time_ns();
 
-        if (client->socket_state == MSOCK_STATE_DISCONNECTED) continue;
+    msock_mutex_lock(&msock_internal_resolver.lock);
+    msock_internal_resolver_defaults();
 
-        if (shutdown(client->native_socket, SD_SEND) == SOCKET_ERROR) {
-            printf("shutdown() client %d failed: %d\n", i, WSAGetLastError());
-            success = false;
-        }
+    msock_resolver_entry* entry = msock_internal_resolver_find(host, port, hash);
+    if (entry && !entry->pending && now < entry->expires_ns) {
+        int error = entry->error;
+        if (error == 0) *addr = entry->addr;
 
-        if (server_socket->disconnect_cb) server_socket->disconnect_cb(client);
-        closesocket(client->native_socket);
+        entry->touched = true;
+        entry->last_used_ns = now;
+        if (error == 0) msock_internal_resolver.stats.hits++;
+        else msock_internal_resolver.stats.negative_hits++;
 
-        client->native_socket = INVALID_SOCKET;
-        client->socket_state = MSOCK_STATE_DISCONNECTED;
+        msock_mutex_unlock(&msock_internal_resolver.lock);
+        msock_internal_last_resolve_error = error;
+        return error;
     }
 
-    closesocket(server_socket->native_socket);
+    msock_internal_resolver.stats.misses++;
+    msock_mutex_unlock(&msock_internal_resolver.lock);
 
-    return success;
+    // Resolve without holding the lock, getaddrinfo can block for seconds
+    struct sockaddr_in resolved = { 0 };
+    int error = msock_internal_getaddrinfo(host, port, &resolved);
+    msock_internal_resolver_store(host, port, hash, error, &resolved, now);
+
+    if (error == 0) *addr = resolved;
+    msock_internal_last_resolve_error = error;
+    return error;
 }
 
-static void msock_internal_handle_accept(msock_server* server) {
-    struct sockaddr_in address;
-    socklen_t addrlen = sizeof(address);
+// Error of the last msock_resolve on this thread, including the ones made by
+// msock_client_connect and msock_server_listen
+int msock_last_resolve_error() {
+    return msock_internal_last_resolve_error;
+}
 
-    SOCKET new_socket = accept(server->native_socket, (struct sockaddr*)&address, &addrlen);
+const char* msock_resolve_error_string(int error) {
+    return gai_strerror(error);
+}
 
-    if (new_socket == INVALID_SOCKET) {
-        printf("accept() failed, INVALID_SOCKET. Error: %d\n", WSAGetLastError());
-        return;
+void msock_resolver_configure(const msock_resolver_config* config) {
+    msock_mutex_lock(&msock_internal_resolver.lock);
+    msock_internal_resolver.config = *config;
+    msock_internal_resolver_defaults();
+    msock_mutex_unlock(&msock_internal_resolver.lock);
+}
+
+static bool msock_internal_resolve(const char* ip, const char* port, struct sockaddr_in* addr) {
+    int error = msock_resolve(ip, port, addr);
+    if (error != 0) {
+        printf("resolve(%s:%s) failed: %s\n", ip ? ip : "", port ? port : "", msock_resolve_error_string(error));
+        return false;
     }
+    return true;
+}
 
-    int free_slot = -1;
-    for (int i = 0; i < MSOCK_MAX_CLIENTS; i++) {
-        if (server->connected_clients[i].socket_state == MSOCK_STATE_DISCONNECTED) {
-            free_slot = i;
-            break;
-        }
+// Re-resolves entries that are in use and about to expire, plus prefetched ones, so
+// lookups on the connect path keep hitting the cache.
+static void msock_internal_resolver_refresh() {
+    struct {
+        char host[MAXHOSTNAMELEN];
+        char port[16];
+        uint32_t hash;
+    } work[MSOCK_RESOLVER_CACHE_SIZE];
+    int work_count = 0;
+
+    uint64_t now = msock_time_ns();
+
+    msock_mutex_lock(&msock_internal_resolver.lock);
+    uint64_t horizon = now + 2ull * msock_internal_resolver.config.refresh_interval_ms * 1000000ull;
+
+    for (int i = 0; i < MSOCK_RESOLVER_CACHE_SIZE; i++) {
+        msock_resolver_entry* entry = &msock_internal_resolver.entries[i];
+        if (!entry->used) continue;
+        if (!entry->pending && !(entry->touched && entry->expires_ns <= horizon)) continue;
+
+        // Entries nobody asks for again are left to expire
+        entry->touched = false;
+        memcpy(work[work_count].host, entry->host, sizeof(entry->host));
+        memcpy(work[work_count].port, entry->port, sizeof(entry->port));
+        work[work_count].hash = entry->hash;
+        work_count++;
     }
 
-    if (free_slot == -1) {
-        printf("Server full, rejecting connection.\n");
-        closesocket(new_socket);
-        return;
+    msock_internal_resolver.stats.refreshes += (uint64_t)work_count;
+    msock_mutex_unlock(&msock_internal_resolver.lock);
+
+    for (int i = 0; i < work_count; i++) {
+        struct sockaddr_in resolved = { 0 };
+        int error = msock_internal_getaddrinfo(work[i].host, work[i].port, &resolved);
+        msock_internal_resolver_store(work[i].host, work[i].port, work[i].hash, error, &resolved, msock_time_ns());
     }
+}
 
-    msock_client* c = &server->connected_clients[free_slot];
-    c->native_socket = new_socket;
-    c->socket_state = MSOCK_STATE_CONNECTED;
+#ifdef _WIN32
+static DWORD WINAPI msock_internal_resolver_thread(LPVOID arg) {
+#else
+static void* msock_internal_resolver_thread(void* arg) {
+#endif
+    (void)arg;
+    uint32_t waited_ms = 0;
 
-    inet_ntop(AF_INET, &address.sin_addr, c->ip_addr, INET_ADDRSTRLEN);
+    while (msock_internal_resolver.running) {
+        // Short sleeps so msock_resolver_stop does not wait a full interval
+        msock_internal_sleep_ms(MSOCK_GROUP_STOP_POLL_MS);
+        waited_ms += MSOCK_GROUP_STOP_POLL_MS;
 
-    msock_set_nonblocking(new_socket);
+        if (waited_ms < msock_internal_resolver.config.refresh_interval_ms) continue;
+        waited_ms = 0;
 
-    bool allow = true;
-    if (server->connect_cb != NULL) {
-        allow = server->connect_cb(c);
+        msock_internal_resolver_refresh();
     }
 
-    if (!allow) {
-        closesocket(new_socket);
-        c->socket_state = MSOCK_STATE_DISCONNECTED;
+    return 0;
+}
+
+// Starts the background thread that keeps hot entries fresh and serves prefetches
+bool msock_resolver_start() {
+    if (msock_internal_resolver.running) return true;
+
+    msock_mutex_lock(&msock_internal_resolver.lock);
+    msock_internal_resolver_defaults();
+    msock_mutex_unlock(&msock_internal_resolver.lock);
+
+    msock_internal_resolver.running = true;
+
+#ifdef _WIN32
+    msock_internal_resolver.thread = CreateThread(NULL, 0, msock_internal_resolver_thread, NULL, 0, NULL);
+    bool created = msock_internal_resolver.thread != NULL;
+#else
+    bool created = pthread_create(&msock_internal_resolver.thread, NULL, msock_internal_resolver_thread, NULL) == 0;
+#endif
+
+    if (!created) {
+        printf("Failed to start resolver thread\n");
+        msock_internal_resolver.running = false;
     }
+    return created;
 }
 
-static void msock_internal_handle_clients(msock_server* server_socket, fd_set* readfds) {
-    for (int i = 0; i < MSOCK_MAX_CLIENTS; i++) {
-        msock_client* client = &server_socket->connected_clients[i];
+void msock_resolver_stop() {
+    if (!msock_internal_resolver.running) return;
+    msock_internal_resolver.running = false;
+
+#ifdef _WIN32
+    WaitForSingleObject(msock_internal_resolver.thread, INFINITE);
+    CloseHandle(msock_internal_resolver.thread);
+#else
+    pthread_join(msock_internal_resolver.thread, NULL);
+#endif
+}
 
-        if (client->socket_state == MSOCK_STATE_CONNECTED &&
-            FD_ISSET(client->native_socket, readfds)) {
+// Warms the cache for host:port. Resolved on the background thread when it runs,
+// right away otherwise.
+void msock_resolver_prefetch(const char* host, const char* port) {
+    if (!host) host = "";
+    if (!port) port = "";
 
-            bool keep_alive = true;
-            if (server_socket->client_cb != NULL) {
-                keep_alive = server_socket->client_cb(server_socket, client);
-            }
+    if (!msock_internal_resolver.running) {
+        struct sockaddr_in addr;
+        msock_resolve(host, port, &addr);
+        return;
+    }
 
-            if (!keep_alive) {
-                msock_client_close(client);
-                server_socket->disconnect_cb(client);
-                client->socket_state = MSOCK_STATE_DISCONNECTED;
-            }
-        }
+    uint32_t hash = msock_internal_resolver_hash(host, port);
+
+    msock_mutex_lock(&msock_internal_resolver.lock);
+    msock_resolver_entry* entry = msock_internal_resolver_slot(host, port, hash);
+    if (entry->expires_ns == 0) {
+        entry->pending = true;
+        entry->last_used_ns = msock_time_ns();
     }
+    msock_mutex_unlock(&msock_internal_resolver.lock);
 }
 
-bool msock_server_run(msock_server* server) {
-    fd_set readfds;
-    FD_ZERO(&readfds);
+// Drops a cached answer, e.g. after connecting to it failed
+void msock_resolver_invalidate(const char* host, const char* port) {
+    if (!host) host = "";
+    if (!port) port = "";
 
-    FD_SET(server->native_socket, &readfds);
+    uint32_t hash = msock_internal_resolver_hash(host, port);
 
-    int max_fd = 0;
+    msock_mutex_lock(&msock_internal_resolver.lock);
+    msock_resolver_entry* entry = msock_internal_resolver_find(host, port, hash);
+    if (entry) entry->used = false;
+    msock_mutex_unlock(&msock_internal_resolver.lock);
+}
 
-#ifndef _WIN32
-    // 2. Only calculate max_fd on Linux/Mac
-    max_fd = server->native_socket;
+void msock_resolver_flush() {
+    msock_mutex_lock(&msock_internal_resolver.lock);
+    memset(msock_internal_resolver.entries, 0, sizeof(msock_internal_resolver.entries));
+    msock_mutex_unlock(&msock_internal_resolver.lock);
+}
 
-    for (int i = 0; i < MSOCK_MAX_CLIENTS; i++) {
-        msock_client* client = &server->connected_clients[i];
-        if (client->socket_state == MSOCK_STATE_CONNECTED) {
-            FD_SET(client->native_socket, &readfds);
+msock_resolver_stats msock_resolver_get_stats() {
+    msock_mutex_lock(&msock_internal_resolver.lock);
+    msock_resolver_stats stats = msock_internal_resolver.stats;
+    msock_mutex_unlock(&msock_internal_resolver.lock);
+    return stats;
+}
 
-            if (client->native_socket > max_fd) {
-                max_fd = client->native_socket;
-            }
-        }
+//MSOCK_CLIENT Implementations
+
+static void msock_internal_reconnect_lost(msock_client* client_socket);
+static void msock_internal_zerocopy_enable(msock_client* client_socket, size_t threshold);
+static void msock_internal_zerocopy_drain(msock_client* client_socket);
+static bool msock_internal_reconnect_queue(msock_client* client_socket, const char* data, size_t len, msock_buffer* buffer);
+
+bool msock_client_create(msock_client* client_result) {
+
+    SOCKET sock = INVALID_SOCKET;
+    sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sock == INVALID_SOCKET) {
+        printf("socket() failed: %d\n", MSOCK_LAST_ERROR);
+        return false;
     }
-#else
-    for (int i = 0; i < MSOCK_MAX_CLIENTS; i++) {
-        msock_client* client = &server->connected_clients[i];
-        if (client->socket_state == MSOCK_STATE_CONNECTED) {
-            FD_SET(client->native_socket, &readfds);
+
+    msock_client_cold* cold = (msock_client_cold*)calloc(1, sizeof(msock_client_cold));
+    if (!cold) {
+        printf("calloc() failed for client\n");
+        closesocket(sock);
+        return false;
+    }
+
+    memset(client_result, 0, sizeof(*client_result));
+    client_result->loop_slot = -1;
+    client_result->native_socket = sock;
+    client_result->socket_protocol = MSOCK_TCP;
+    client_result->socket_state = MSOCK_STATE_DISCONNECTED;
+    client_result->flags = MSOCK_CLIENT_FLAG_OWNS_COLD;
+    client_result->cold = cold;
+
+    return true;
+}
+
+// The accessors below also work on a closed standalone client, which has no cold data left
+
+void msock_client_set_userdata(msock_client* client, void* userdata) {
+    if (client->cold) client->cold->userdata = userdata;
+}
+
+void* msock_client_get_userdata(msock_client* client) {
+    return client->cold ? client->cold->userdata : NULL;
+}
+
+const char* msock_client_get_ip(msock_client* client) {
+    msock_client_cold* cold = client->cold;
+    if (!cold) return "";
+
+    if (!cold->ip_formatted) {
+        if (inet_ntop(AF_INET, &cold->peer_addr.sin_addr, cold->ip_addr, INET_ADDRSTRLEN) == NULL) {
+            cold->ip_addr[0] = '\0';
         }
+        cold->ip_formatted = true;
     }
-#endif
 
-    int activity = select(max_fd + 1, &readfds, NULL, NULL, NULL);
-    if (activity == SOCKET_ERROR) {
-        printf("select() error: %d\n", WSAGetLastError());
+    return cold->ip_addr;
+}
+
+const msock_client_stats* msock_client_get_stats(msock_client* client) {
+    static const msock_client_stats closed_stats = { 0 };
+    return client->cold ? &client->cold->stats : &closed_stats;
+}
+
+void msock_client_set_options(msock_client* client, const msock_socket_options* options) {
+    if (!client->cold) return;
+
+    if (options) {
+        client->cold->options = *options;
+        client->cold->has_options = true;
+    } else {
+        client->cold->has_options = false;
+    }
+}
+
+// Standalone clients lose their socket when a connect fails, give them a fresh one
+static bool msock_internal_client_ensure_socket(msock_client* client_socket) {
+    if (client_socket->native_socket != INVALID_SOCKET) return true;
+
+    SOCKET sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sock == INVALID_SOCKET) {
+        printf("socket() failed: %d\n", MSOCK_LAST_ERROR);
         return false;
     }
 
-    if (FD_ISSET(server->native_socket, &readfds)) {
-        msock_internal_handle_accept(server);
+    client_socket->native_socket = sock;
+    return true;
+}
+
+static void msock_internal_client_discard_socket(msock_client* client_socket) {
+    if (client_socket->native_socket != INVALID_SOCKET) closesocket(client_socket->native_socket);
+    client_socket->native_socket = INVALID_SOCKET;
+    client_socket->socket_state = MSOCK_STATE_DISCONNECTED;
+}
+
+// Applies the client's options and records the peer address
+static bool msock_internal_client_prepare_connect(msock_client* client_socket, const struct sockaddr_in* addr) {
+    if (!msock_internal_client_ensure_socket(client_socket)) return false;
+
+    if (client_socket->cold->has_options) {
+        msock_apply_socket_options(client_socket->native_socket, &client_socket->cold->options, false);
+        if (client_socket->cold->options.tcp_quickack) client_socket->flags |= MSOCK_CLIENT_FLAG_QUICKACK;
+        msock_internal_zerocopy_enable(client_socket, client_socket->cold->options.zerocopy_threshold);
     }
 
-    msock_internal_handle_clients(server, &readfds);
+    client_socket->cold->peer_addr = *addr;
+    client_socket->cold->ip_formatted = false;
 
     return true;
 }
 
-bool msock_server_broadcast(msock_server* server_socket, msock_message* broadcast_msg, msock_client* sender_socket) {
+bool msock_client_connect(msock_client* client_socket, const char* ip, const char* port) {
 
-    for (int i = 0; i < MSOCK_MAX_CLIENTS; i++) {
-        msock_client* client = &server_socket->connected_clients[i];
+    if (!client_socket || !ip || !port) return false;
+
+    struct sockaddr_in addr;
+    if (!msock_internal_resolve(ip, port, &addr)) return false;
+
+    return msock_client_connect_addr(client_socket, &addr);
+}
+
+// Connects to an already resolved address, skipping name resolution
+bool msock_client_connect_addr(msock_client* client_socket, const struct sockaddr_in* addr) {
+    if (!msock_internal_client_prepare_connect(client_socket, addr)) return false;
 
-        if (client->socket_state == MSOCK_STATE_DISCONNECTED) continue;
-        if (sender_socket != NULL && client == sender_socket) continue;
+    if (connect(client_socket->native_socket, (const struct sockaddr*)addr, sizeof(*addr)) == SOCKET_ERROR) {
+        printf("connect() failed: %d\n", MSOCK_LAST_ERROR);
+        msock_internal_client_discard_socket(client_socket);
+        return false;
+    }
+
+    client_socket->socket_state = MSOCK_STATE_CONNECTED;
+    return true;
+}
 
-        msock_client_send(&server_socket->connected_clients[i], broadcast_msg);
+static void msock_internal_finish_connect(msock_client* client_socket, int error) {
+    msock_client_cold* cold = client_socket->cold;
+
+    if (error == 0) {
+        client_socket->socket_state = MSOCK_STATE_CONNECTED;
+    } else {
+        msock_internal_client_discard_socket(client_socket);
     }
 
+    msock_on_connect_result_cb cb = cold->connect_result_cb;
+    cold->connect_result_cb = NULL;
+    cold->connect_deadline_ns = 0;
+
+    if (cb) cb(client_socket, error);
+}
+
+// Starts a nonblocking connect and returns right away. The result is reported through
+// cb from msock_client_poll_connects (or the event loop owning the client).
+bool msock_client_connect_async(msock_client* client_socket, const char* ip, const char* port, int timeout_ms, msock_on_connect_result_cb cb) {
+
+    if (!client_socket || !ip || !port) return false;
+
+    struct sockaddr_in addr;
+    if (!msock_internal_resolve(ip, port, &addr)) return false;
+
+    return msock_client_connect_addr_async(client_socket, &addr, timeout_ms, cb);
+}
+
+bool msock_client_connect_addr_async(msock_client* client_socket, const struct sockaddr_in* addr, int timeout_ms, msock_on_connect_result_cb cb) {
+    if (!msock_internal_client_prepare_connect(client_socket, addr)) return false;
 
+    msock_set_nonblocking(client_socket->native_socket);
+
+    client_socket->cold->connect_result_cb = cb;
+    client_socket->cold->connect_deadline_ns = timeout_ms > 0 ? msock_time_ns() + (uint64_t)timeout_ms * 1000000ull : 0;
+    client_socket->socket_state = MSOCK_STATE_CONNECTING;
+
+    if (connect(client_socket->native_socket, (const struct sockaddr*)addr, sizeof(*addr)) == SOCKET_ERROR) {
+        int error = MSOCK_LAST_ERROR;
+        if (!MSOCK_IS_INPROGRESS(error)) {
+            msock_internal_finish_connect(client_socket, error);
+            return false;
+        }
+    }
+
+    // Even an immediate success is reported through the poll, so cb never runs inside this call
     return true;
 }
 
-void msock_server_set_connect_cb(msock_server* server_socket, msock_on_connect_cb cb) {
-    server_socket->connect_cb = cb;
+bool msock_client_is_connecting(msock_client* client_socket) {
+    return client_socket->socket_state == MSOCK_STATE_CONNECTING;
 }
 
-void msock_server_set_disconnect_cb(msock_server* server_socket, msock_on_disconnect_cb cb) {
-    server_socket->disconnect_cb = cb;
+// Completes in-flight async connects among clients once they turn writable or time out.
+// Waits at most timeout_ms (-1 = until the next completion). Returns how many are still in flight.
+int msock_client_poll_connects(msock_client** clients, int count, int timeout_ms) {
+    struct pollfd* fds = (struct pollfd*)calloc((size_t)(count > 0 ? count : 1), sizeof(struct pollfd));
+    int* index = (int*)calloc((size_t)(count > 0 ? count : 1), sizeof(int));
+    if (!fds || !index) {
+        free(fds);
+        free(index);
+        return -1;
+    }
+
+    uint64_t now = msock_time_ns();
+    uint64_t nearest_deadline = 0;
+    int pending = 0;
+
+    for (int i = 0; i < count; i++) {
+        msock_client* client = clients[i];
+        if (!client || client->socket_state != MSOCK_STATE_CONNECTING) continue;
+
+        uint64_t deadline = client->cold->connect_deadline_ns;
+        if (deadline != 0 && deadline <= now) {
+            msock_internal_finish_connect(client, MSOCK_ETIMEDOUT);
+            continue;
+        }
+        if (deadline != 0 && (nearest_deadline == 0 || deadline < nearest_deadline)) nearest_deadline = deadline;
+
+        fds[pending].fd = client->native_socket;
+        fds[pending].events = POLLOUT;
+        index[pending] = i;
+        pending++;
+    }
+
+    if (pending > 0) {
+        int wait_ms = timeout_ms;
+        if (nearest_deadline != 0) {
+            int until_deadline = (int)((nearest_deadline - now + 999999) / 1000000);
+            if (wait_ms < 0 || until_deadline < wait_ms) wait_ms = until_deadline;
+        }
+
+        int activity = msock_poll(fds, (unsigned long)pending, wait_ms);
+        if (activity == SOCKET_ERROR) {
+            printf("poll() error: %d\n", MSOCK_LAST_ERROR);
+        }
+
+        now = msock_time_ns();
+        for (int i = 0; i < pending; i++) {
+            msock_client* client = clients[index[i]];
+
+            if (activity > 0 && fds[i].revents != 0) {
+                int error = 0;
+                socklen_t len = sizeof(error);
+                if (getsockopt(client->native_socket, SOL_SOCKET, SO_ERROR, (char*)&error, &len) == SOCKET_ERROR) {
+                    error = MSOCK_LAST_ERROR;
+                }
+                msock_internal_finish_connect(client, error);
+            } else if (client->cold->connect_deadline_ns != 0 && client->cold->connect_deadline_ns <= now) {
+                msock_internal_finish_connect(client, MSOCK_ETIMEDOUT);
+            }
+        }
+    }
+
+    int still_connecting = 0;
+    for (int i = 0; i < count; i++) {
+        if (clients[i] && clients[i]->socket_state == MSOCK_STATE_CONNECTING) still_connecting++;
+    }
+
+    free(fds);
+    free(index);
+    return still_connecting;
 }
 
-void msock_server_set_client_cb(msock_server* server_socket, msock_on_client_cb cb) {
-    server_socket->client_cb = cb;
+bool msock_client_is_connected(msock_client* client_socket) {
+    return client_socket->socket_state == MSOCK_STATE_CONNECTED;
+}
+
+static void msock_internal_client_clear_queue(msock_client* client_socket) {
+    msock_write_node* node = client_socket->write_head;
+    while (node) {
+        msock_write_node* next = node->next;
+        msock_internal_node_release(node);
+        node = next;
+    }
+    client_socket->write_head = NULL;
+    client_socket->write_tail = NULL;
+}
+
+bool msock_client_close(msock_client* client_socket) {
+    bool success = true;
+
+    if (client_socket->cold) msock_client_disable_reconnect(client_socket);
+    if (client_socket->loop) msock_loop_remove_client(client_socket->loop, client_socket);
+    msock_internal_client_clear_queue(client_socket);
+    if (client_socket->cold) msock_internal_zerocopy_drain(client_socket);
+
+    if (client_socket->socket_state == MSOCK_STATE_CONNECTED &&
+        shutdown(client_socket->native_socket, SD_SEND) == SOCKET_ERROR) {
+        printf("shutdown() failed: %d\n", MSOCK_LAST_ERROR);
+        success = false;
+    }
+
+    // Also reached after the peer closed first, the socket still has to be released
+    if (client_socket->native_socket != INVALID_SOCKET) closesocket(client_socket->native_socket);
+
+    client_socket->native_socket = INVALID_SOCKET;
+    client_socket->socket_state = MSOCK_STATE_DISCONNECTED;
+
+    if (client_socket->flags & MSOCK_CLIENT_FLAG_OWNS_COLD) {
+        free(client_socket->cold);
+        client_socket->cold = NULL;
+        client_socket->flags &= ~MSOCK_CLIENT_FLAG_OWNS_COLD;
+    }
+
+    return success;
+}
+
+ssize_t msock_client_receive(msock_client* client_socket, msock_message* result_msg) {
+    if (client_socket->socket_state == MSOCK_STATE_DISCONNECTED ||
+        client_socket->socket_state == MSOCK_STATE_RECONNECTING ||
+        client_socket->socket_state == MSOCK_STATE_CIRCUIT_OPEN) return -1;
+
+    int bytes_received = recv(client_socket->native_socket, result_msg->buffer, result_msg->size - 1, 0); //NOTE: recv is a blocking function
+
+    if (bytes_received == 0) {
+        printf("Connection closed!\n");
+        if (client_socket->cold->reconnect) msock_internal_reconnect_lost(client_socket);
+        else client_socket->socket_state = MSOCK_STATE_DISCONNECTED;
+        return 0;
+    }
+
+    if (bytes_received < 0) {
+        if (MSOCK_IS_WOULDBLOCK(MSOCK_LAST_ERROR)) return 0;
+
+        if (client_socket->cold->reconnect) msock_internal_reconnect_lost(client_socket);
+        else client_socket->socket_state = MSOCK_STATE_DISCONNECTED;
+        return -1;
+    }
+
+    result_msg->buffer[bytes_received] = '\0';
+    result_msg->len = bytes_received;
+
+    client_socket->cold->stats.bytes_received += (uint64_t)bytes_received;
+    client_socket->cold->stats.messages_received++;
+
+#ifdef TCP_QUICKACK
+    // The kernel drops back to delayed ACKs on its own, so quickack has to be re-armed
+    if (client_socket->flags & MSOCK_CLIENT_FLAG_QUICKACK) {
+        int one = 1;
+        setsockopt(client_socket->native_socket, IPPROTO_TCP, TCP_QUICKACK, (const char*)&one, sizeof(one));
+    }
+#endif
+
+    return bytes_received;
+}
+
+static void msock_internal_loop_update(msock_loop* loop, int slot);
+
+// Takes over the caller's reference to buffer
+static void msock_internal_client_append(msock_client* client_socket, msock_write_node* node) {
+    bool was_empty = client_socket->write_head == NULL;
+    if (client_socket->write_tail) {
+        client_socket->write_tail->next = node;
+    } else {
+        client_socket->write_head = node;
+    }
+    client_socket->write_tail = node;
+
+    // Ask the owning loop for write readiness so the queue drains without the app. A corked
+    // queue is flushed at the end of the iteration first and only registers if data is left.
+    if (was_empty && client_socket->loop && !(client_socket->flags & MSOCK_CLIENT_FLAG_CORKED)) {
+        msock_internal_loop_update(client_socket->loop, client_socket->loop_slot);
+    }
+}
+
+static bool msock_internal_client_enqueue(msock_client* client_socket, msock_buffer* buffer, size_t offset) {
+    msock_write_node* node = msock_internal_node_acquire();
+    if (!node) {
+        msock_buffer_release(buffer);
+        return false;
+    }
+
+    node->buffer = buffer;
+    node->offset = offset;
+    msock_internal_client_append(client_socket, node);
+
+    return true;
+}
+
+// Inside the callbacks of a corking loop sends only queue up, the loop writes each
+// client's queue with one vectored send once the iteration is done
+static bool msock_internal_client_cork(msock_client* client_socket) {
+    msock_loop* loop = client_socket->loop;
+    if (!loop || !loop->corking || client_socket->socket_state != MSOCK_STATE_CONNECTED) return false;
+    if (client_socket->flags & MSOCK_CLIENT_FLAG_CORKED) return true;
+
+    // A slot reused within the iteration can show up twice, never outgrow the list
+    if (loop->corked_count >= loop->entry_capacity) return false;
+
+    client_socket->flags |= MSOCK_CLIENT_FLAG_CORKED;
+    loop->corked[loop->corked_count++] = client_socket->loop_slot;
+    return true;
+}
+
+// Copies data behind the queue, into the last buffer while it is ours alone and has room
+static bool msock_internal_client_coalesce(msock_client* client_socket, const char* data, size_t len) {
+    msock_write_node* tail = client_socket->write_tail;
+    msock_buffer* buffer = tail ? tail->buffer : NULL;
+
+    if (!buffer || buffer->refcount != 1 || buffer->capacity - buffer->len < len) {
+        buffer = msock_buffer_acquire(len < 4096 ? 4096 : len);
+        if (!buffer || !msock_internal_client_enqueue(client_socket, buffer, 0)) return false;
+    }
+
+    memcpy(buffer->data + buffer->len, data, len);
+    buffer->len += len;
+    return true;
+}
+
+bool msock_client_send(msock_client* client_socket, msock_message* msg) {
+    size_t sent = 0;
+
+    if (client_socket->socket_state != MSOCK_STATE_CONNECTED && client_socket->cold && client_socket->cold->reconnect) {
+        return msock_internal_reconnect_queue(client_socket, msg->buffer, msg->len, NULL);
+    }
+    if (!client_socket->cold) return false; // Closed standalone client
+
+    if (msock_internal_client_cork(client_socket)) {
+        if (!msock_internal_client_coalesce(client_socket, msg->buffer, msg->len)) return false;
+
+        client_socket->cold->stats.messages_sent++;
+        client_socket->loop->stats.corked_sends++;
+        return true;
+    }
+
+    // Anything already queued has to go out first, keep ordering
+    if (client_socket->write_head == NULL) {
+        ssize_t result = send(client_socket->native_socket, msg->buffer, (int)msg->len, MSOCK_SEND_FLAGS);
+        if (result == SOCKET_ERROR) {
+            int error = MSOCK_LAST_ERROR;
+            if (!MSOCK_IS_WOULDBLOCK(error)) {
+                printf("send() failed: %d\n", error);
+                if (!client_socket->cold->reconnect) return false;
+
+                msock_internal_reconnect_lost(client_socket);
+                return msock_internal_reconnect_queue(client_socket, msg->buffer, msg->len, NULL);
+            }
+        } else {
+            sent = (size_t)result;
+        }
+    }
+
+    if (sent < msg->len) {
+        msock_buffer* rest = msock_buffer_acquire(msg->len - sent);
+        if (!rest) return false;
+
+        memcpy(rest->data, msg->buffer + sent, msg->len - sent);
+        rest->len = msg->len - sent;
+        if (!msock_internal_client_enqueue(client_socket, rest, 0)) return false;
+    }
+
+    client_socket->cold->stats.bytes_sent += (uint64_t)sent;
+    client_socket->cold->stats.messages_sent++;
+
+    return true;
+}
+
+static ssize_t msock_internal_writev(SOCKET sock, const msock_iovec* iov, int count) {
+#ifdef _WIN32
+    WSABUF buffers[MSOCK_MAX_IOVEC];
+    for (int i = 0; i < count; i++) {
+        buffers[i].buf = (char*)iov[i].data;
+        buffers[i].len = (ULONG)iov[i].len;
+    }
+
+    DWORD sent = 0;
+    if (WSASend(sock, buffers, (DWORD)count, &sent, 0, NULL, NULL) == SOCKET_ERROR) return SOCKET_ERROR;
+    return (ssize_t)sent;
+#else
+    struct iovec vectors[MSOCK_MAX_IOVEC];
+    for (int i = 0; i < count; i++) {
+        vectors[i].iov_base = (void*)iov[i].data;
+        vectors[i].iov_len = iov[i].len;
+    }
+
+    // sendmsg instead of writev, only it takes MSOCK_SEND_FLAGS
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = vectors;
+    msg.msg_iovlen = (size_t)count;
+    return sendmsg(sock, &msg, MSOCK_SEND_FLAGS);
+#endif
+}
+
+// Copies everything in iov past the first skip bytes into one pooled buffer
+static msock_buffer* msock_internal_gather(const msock_iovec* iov, int count, size_t skip) {
+    size_t total = 0;
+    for (int i = 0; i < count; i++) total += iov[i].len;
+
+    msock_buffer* buffer = msock_buffer_acquire(total - skip);
+    if (!buffer) return NULL;
+
+    for (int i = 0; i < count; i++) {
+        if (skip >= iov[i].len) {
+            skip -= iov[i].len;
+            continue;
+        }
+        memcpy(buffer->data + buffer->len, (const char*)iov[i].data + skip, iov[i].len - skip);
+        buffer->len += iov[i].len - skip;
+        skip = 0;
+    }
+
+    return buffer;
+}
+
+// Sends all pieces with a single syscall where possible (sendmsg / WSASend). Whatever the
+// kernel doesn't take right away is copied into one buffer and queued, like msock_client_send.
+bool msock_client_sendv(msock_client* client_socket, const msock_iovec* iov, int count) {
+    size_t total = 0;
+    for (int i = 0; i < count; i++) total += iov[i].len;
+    if (total == 0) return true;
+
+    if (client_socket->socket_state != MSOCK_STATE_CONNECTED && client_socket->cold && client_socket->cold->reconnect) {
+        msock_buffer* buffer = msock_internal_gather(iov, count, 0);
+        if (!buffer) return false;
+
+        bool queued = msock_internal_reconnect_queue(client_socket, NULL, buffer->len, buffer);
+        msock_buffer_release(buffer);
+        return queued;
+    }
+    if (!client_socket->cold) return false; // Closed standalone client
+
+    if (msock_internal_client_cork(client_socket)) {
+        for (int i = 0; i < count; i++) {
+            if (!msock_internal_client_coalesce(client_socket, (const char*)iov[i].data, iov[i].len)) return false;
+        }
+
+        client_socket->cold->stats.messages_sent++;
+        client_socket->loop->stats.corked_sends++;
+        return true;
+    }
+
+    size_t sent = 0;
+    if (client_socket->write_head == NULL) {
+        ssize_t result = msock_internal_writev(client_socket->native_socket, iov, count < MSOCK_MAX_IOVEC ? count : MSOCK_MAX_IOVEC);
+        if (result == SOCKET_ERROR) {
+            int error = MSOCK_LAST_ERROR;
+            if (!MSOCK_IS_WOULDBLOCK(error)) {
+                printf("sendmsg() failed: %d\n", error);
+                if (!client_socket->cold->reconnect) return false;
+
+                msock_internal_reconnect_lost(client_socket);
+                return msock_client_sendv(client_socket, iov, count);
+            }
+        } else {
+            sent = (size_t)result;
+        }
+    }
+
+    if (sent < total) {
+        msock_buffer* rest = msock_internal_gather(iov, count, sent);
+        if (!rest || !msock_internal_client_enqueue(client_socket, rest, 0)) return false;
+    }
+
+    client_socket->cold->stats.bytes_sent += (uint64_t)sent;
+    client_socket->cold->stats.messages_sent++;
+
+    return true;
+}
+
+// Queues a reference to buffer without copying it, the caller keeps its own reference
+bool msock_client_send_buffer(msock_client* client_socket, msock_buffer* buffer) {
+    if (client_socket->socket_state != MSOCK_STATE_CONNECTED) {
+        // A closed standalone client has no cold data left
+        if (!client_socket->cold || !client_socket->cold->reconnect) return false;
+        return msock_internal_reconnect_queue(client_socket, NULL, buffer->len, buffer);
+    }
+
+    bool corked = msock_internal_client_cork(client_socket);
+
+    msock_buffer_retain(buffer);
+    if (!msock_internal_client_enqueue(client_socket, buffer, 0)) return false;
+
+    client_socket->cold->stats.messages_sent++;
+
+    if (corked) {
+        client_socket->loop->stats.corked_sends++;
+        return true;
+    }
+
+    if (msock_client_flush(client_socket)) return true;
+    if (!client_socket->cold->reconnect) return false;
+
+    // Stays queued and goes out on the new connection
+    msock_internal_reconnect_lost(client_socket);
+    return true;
+}
+
+// Queues len bytes of fd starting at offset behind whatever is already queued. On Linux
+// they go out with sendfile and are never copied through user memory. fd must stay open
+// until msock_client_has_pending_writes turns false.
+bool msock_client_sendfile(msock_client* client_socket, int fd, int64_t offset, size_t len) {
+    if (client_socket->socket_state != MSOCK_STATE_CONNECTED) return false;
+    if (len == 0) return true;
+
+    msock_write_node* node = msock_internal_node_acquire();
+    if (!node) return false;
+
+    node->file_fd = fd;
+    node->file_offset = offset;
+    node->file_len = len;
+    bool corked = msock_internal_client_cork(client_socket);
+    msock_internal_client_append(client_socket, node);
+
+    client_socket->cold->stats.messages_sent++;
+
+    if (corked) {
+        client_socket->loop->stats.corked_sends++;
+        return true;
+    }
+    return msock_client_flush(client_socket);
+}
+
+// Sends the next part of a file range, same return convention as send()
+static ssize_t msock_internal_send_file_range(msock_client* client_socket, msock_write_node* node) {
+    size_t remaining = node->file_len - node->offset;
+    int64_t position = node->file_offset + (int64_t)node->offset;
+
+#ifdef __linux__
+    off_t file_position = (off_t)position;
+    ssize_t result = sendfile(client_socket->native_socket, node->file_fd, &file_position, remaining);
+    if (result == 0) {
+        // The file is shorter than the queued range
+        errno = EIO;
+        return SOCKET_ERROR;
+    }
+    return result;
+#else
+    // No zero-copy path here, bounce through a stack buffer
+    char chunk[MSOCK_READ_BUFFER_SIZE];
+    size_t want = remaining < sizeof(chunk) ? remaining : sizeof(chunk);
+
+#ifdef _WIN32
+    int got = _lseeki64(node->file_fd, position, SEEK_SET) < 0 ? -1 : _read(node->file_fd, chunk, (unsigned int)want);
+    if (got <= 0) {
+        // The flush loop reads the socket error, a stale WSAEWOULDBLOCK would stall the queue
+        WSASetLastError(ERROR_READ_FAULT);
+        return SOCKET_ERROR;
+    }
+#else
+    ssize_t got = pread(node->file_fd, chunk, want, (off_t)position);
+    if (got <= 0) {
+        // Read error, or the file is shorter than the queued range
+        if (got == 0) errno = EIO;
+        return SOCKET_ERROR;
+    }
+#endif
+
+    // Whatever send does not take is read again next time
+    return send(client_socket->native_socket, chunk, (int)got, MSOCK_SEND_FLAGS);
+#endif
+}
+
+//Zerocopy
+
+#ifdef __linux__
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+#endif
+
+static void msock_internal_zerocopy_enable(msock_client* client_socket, size_t threshold) {
+    client_socket->cold->zerocopy_threshold = threshold;
+    if (threshold == 0) return;
+
+#ifdef __linux__
+    // Without SO_ZEROCOPY the kernel silently ignores MSG_ZEROCOPY and never sends completions
+    if (MSOCK_INTERNAL_SETOPT(client_socket->native_socket, SOL_SOCKET, SO_ZEROCOPY, 1)) {
+        client_socket->flags |= MSOCK_CLIENT_FLAG_ZEROCOPY;
+    }
+#endif
+}
+
+// Runs before the socket is closed. The kernel may still be sending from the pages of a
+// zerocopy buffer, so wait a bounded time for the completions. A buffer still outstanding
+// after that keeps its reference for good and never goes back to the pool.
+static void msock_internal_zerocopy_drain(msock_client* client_socket) {
+    msock_client_cold* cold = client_socket->cold;
+
+#ifdef __linux__
+    uint64_t deadline = msock_time_ns() + (uint64_t)MSOCK_ZEROCOPY_CLOSE_WAIT_MS * 1000000;
+    while (cold->zerocopy_head && client_socket->native_socket != INVALID_SOCKET) {
+        uint64_t now = msock_time_ns();
+        if (now >= deadline) break;
+
+        // Completions land on the error queue, which poll reports as POLLERR
+        struct pollfd pfd = { .fd = client_socket->native_socket, .events = 0 };
+        if (msock_poll(&pfd, 1, (int)((deadline - now) / 1000000) + 1) <= 0) break;
+        if (msock_client_reap_zerocopy(client_socket) == 0) break; // A socket error, not a completion
+    }
+#endif
+
+    while (cold->zerocopy_head) {
+        msock_write_node* node = cold->zerocopy_head;
+        cold->zerocopy_head = node->next;
+        node->buffer = NULL; // Leaked on purpose, the pages may still be pinned
+        msock_internal_node_release(node);
+    }
+    cold->zerocopy_tail = NULL;
+    client_socket->flags &= ~MSOCK_CLIENT_FLAG_ZEROCOPY;
+}
+
+// Sends the rest of buffer, with MSG_ZEROCOPY when it is big enough. A zerocopy send
+// keeps a reference to buffer until msock_client_reap_zerocopy sees its completion.
+static ssize_t msock_internal_send_buffer(msock_client* client_socket, msock_buffer* buffer, size_t offset) {
+    size_t remaining = buffer->len - offset;
+
+#ifdef __linux__
+    msock_client_cold* cold = client_socket->cold;
+    if ((client_socket->flags & MSOCK_CLIENT_FLAG_ZEROCOPY) && remaining >= cold->zerocopy_threshold) {
+        // Acquired up front: without a node to hold the buffer until its completion, the
+        // caller could recycle pages the kernel is still sending from, so copy instead
+        msock_write_node* pending = msock_internal_node_acquire();
+        if (pending) {
+            ssize_t result = send(client_socket->native_socket, buffer->data + offset, remaining, MSOCK_SEND_FLAGS | MSG_ZEROCOPY);
+            if (result >= 0) {
+                msock_buffer_retain(buffer);
+                pending->buffer = buffer;
+                pending->zerocopy_id = cold->zerocopy_next_id;
+                if (cold->zerocopy_tail) cold->zerocopy_tail->next = pending;
+                else cold->zerocopy_head = pending;
+                cold->zerocopy_tail = pending;
+                cold->zerocopy_next_id++;
+                cold->stats.zerocopy_sends++;
+                return result;
+            }
+
+            int error = errno;
+            msock_internal_node_release(pending);
+            errno = error;
+
+            // Out of optmem for pinned pages, a plain copy still works
+            if (error != ENOBUFS) return result;
+        }
+    }
+#endif
+
+    return send(client_socket->native_socket, buffer->data + offset, (int)remaining, MSOCK_SEND_FLAGS);
+}
+
+// Reads zerocopy completions from the socket error queue and releases the buffers the
+// kernel is done with. The loop does this on its own, standalone clients call it.
+// Returns how many buffers were released.
+int msock_client_reap_zerocopy(msock_client* client_socket) {
+    int released = 0;
+
+#ifdef __linux__
+    msock_client_cold* cold = client_socket->cold;
+    if (!cold || !cold->zerocopy_head) return 0;
+
+    for (;;) {
+        char control[128];
+        struct msghdr msg = { 0 };
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        if (recvmsg(client_socket->native_socket, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) break;
+
+        for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            struct sock_extended_err error;
+            memcpy(&error, CMSG_DATA(cmsg), sizeof(error));
+            if (error.ee_errno != 0 || error.ee_origin != SO_EE_ORIGIN_ZEROCOPY) continue;
+
+            // Completions cover the id range [ee_info, ee_data]
+            uint32_t last = error.ee_data;
+            if (error.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                // The kernel had to copy (loopback, no scatter-gather), pinning only adds cost
+                cold->stats.zerocopy_copied += (uint64_t)(last - error.ee_info) + 1;
+                client_socket->flags &= ~MSOCK_CLIENT_FLAG_ZEROCOPY;
+            }
+
+            while (cold->zerocopy_head && (int32_t)(cold->zerocopy_head->zerocopy_id - last) <= 0) {
+                msock_write_node* node = cold->zerocopy_head;
+                cold->zerocopy_head = node->next;
+                if (!cold->zerocopy_head) cold->zerocopy_tail = NULL;
+                msock_internal_node_release(node);
+                released++;
+            }
+        }
+    }
+#else
+    (void)client_socket;
+#endif
+
+    return released;
+}
+
+// Hands the queued buffers up to the next file range to one vectored send. A buffer big
+// enough for zerocopy goes out on its own through msock_internal_send_buffer.
+static ssize_t msock_internal_send_queued(msock_client* client_socket, size_t* offered) {
+    msock_iovec iov[MSOCK_MAX_IOVEC];
+    int count = 0;
+    size_t total = 0;
+
+    for (msock_write_node* node = client_socket->write_head; node && node->buffer && count < MSOCK_MAX_IOVEC; node = node->next) {
+        size_t remaining = node->buffer->len - node->offset;
+        bool zerocopy = (client_socket->flags & MSOCK_CLIENT_FLAG_ZEROCOPY) && remaining >= client_socket->cold->zerocopy_threshold;
+        if (zerocopy && count > 0) break;
+
+        iov[count].data = node->buffer->data + node->offset;
+        iov[count].len = remaining;
+        total += remaining;
+        count++;
+        if (zerocopy) break;
+    }
+
+    *offered = total;
+    if (count == 1) return msock_internal_send_buffer(client_socket, client_socket->write_head->buffer, client_socket->write_head->offset);
+    return msock_internal_writev(client_socket->native_socket, iov, count);
+}
+
+// Pops the nodes the kernel took in full and advances the one it took part of
+static void msock_internal_client_consume(msock_client* client_socket, size_t written) {
+    while (client_socket->write_head) {
+        msock_write_node* node = client_socket->write_head;
+        size_t remaining = (node->buffer ? node->buffer->len : node->file_len) - node->offset;
+        if (remaining > written) {
+            node->offset += written;
+            return;
+        }
+
+        written -= remaining;
+        client_socket->write_head = node->next;
+        if (!client_socket->write_head) client_socket->write_tail = NULL;
+        msock_internal_node_release(node);
+    }
+}
+
+// Writes queued data until the queue is empty or the kernel buffer is full, consecutive
+// buffers with one vectored send. Returns false on a socket error.
+bool msock_client_flush(msock_client* client_socket) {
+    if (!client_socket->cold) return false; // Closed standalone client
+
+    bool had_data = client_socket->write_head != NULL;
+
+    if (client_socket->cold->zerocopy_head) msock_client_reap_zerocopy(client_socket);
+
+    while (client_socket->write_head) {
+        msock_write_node* node = client_socket->write_head;
+
+        ssize_t result;
+        size_t offered;
+        if (node->buffer) {
+            result = msock_internal_send_queued(client_socket, &offered);
+        } else {
+            offered = node->file_len - node->offset;
+            result = msock_internal_send_file_range(client_socket, node);
+        }
+
+        if (result == SOCKET_ERROR) {
+            int error = MSOCK_LAST_ERROR;
+            if (MSOCK_IS_WOULDBLOCK(error)) break;
+
+            printf("send() failed: %d\n", error);
+            return false;
+        }
+
+        client_socket->cold->stats.bytes_sent += (uint64_t)result;
+        msock_internal_client_consume(client_socket, (size_t)result);
+        if ((size_t)result < offered) break; // Kernel buffer is full
+    }
+
+    if (had_data && !client_socket->write_head && client_socket->loop) {
+        msock_internal_loop_update(client_socket->loop, client_socket->loop_slot);
+    }
+
+    return true;
+}
+
+bool msock_client_has_pending_writes(msock_client* client_socket) {
+    return client_socket->write_head != NULL;
+}
+
+// Backpressure for clients on a msock_loop: a paused client is not read from, so the
+// kernel's receive window fills up and the peer slows down
+void msock_client_pause_reading(msock_client* client_socket, bool paused) {
+    if (paused) client_socket->flags |= MSOCK_CLIENT_FLAG_READ_PAUSED;
+    else client_socket->flags &= ~MSOCK_CLIENT_FLAG_READ_PAUSED;
+
+    if (client_socket->loop) msock_internal_loop_update(client_socket->loop, client_socket->loop_slot);
+}
+
+// Asks the loop for write readiness (handler on_writable) while nothing is queued, for
+// data held outside the write queue such as a msock_splice pipe
+void msock_client_want_writable(msock_client* client_socket, bool wanted) {
+    if (wanted) client_socket->flags |= MSOCK_CLIENT_FLAG_WANT_WRITE;
+    else client_socket->flags &= ~MSOCK_CLIENT_FLAG_WANT_WRITE;
+
+    if (client_socket->loop) msock_internal_loop_update(client_socket->loop, client_socket->loop_slot);
+}
+
+//MSOCK_SPLICE Implementations
+
+#ifdef __linux__
+// Raw syscall, the libc wrapper needs _GNU_SOURCE
+static ssize_t msock_internal_splice(int fd_in, int fd_out, size_t len) {
+    const unsigned int move = 1, nonblock = 2; // SPLICE_F_MOVE, SPLICE_F_NONBLOCK
+    return (ssize_t)syscall(SYS_splice, fd_in, NULL, fd_out, NULL, len, move | nonblock);
+}
+#endif
+
+bool msock_splice_create(msock_splice* splice, msock_client* from, msock_client* to) {
+    memset(splice, 0, sizeof(*splice));
+    splice->from = from;
+    splice->to = to;
+    splice->pipe_fds[0] = splice->pipe_fds[1] = -1;
+
+#ifdef __linux__
+    if (pipe(splice->pipe_fds) != 0) {
+        printf("pipe() failed: %d\n", errno);
+        return false;
+    }
+    fcntl(splice->pipe_fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(splice->pipe_fds[1], F_SETFL, O_NONBLOCK);
+#endif
+
+    return true;
+}
+
+// Bytes still in the pipe are lost, neither client is closed
+void msock_splice_close(msock_splice* splice) {
+#ifdef __linux__
+    if (splice->pipe_fds[0] >= 0) close(splice->pipe_fds[0]);
+    if (splice->pipe_fds[1] >= 0) close(splice->pipe_fds[1]);
+#endif
+    splice->pipe_fds[0] = splice->pipe_fds[1] = -1;
+    splice->pipe_pending = 0;
+}
+
+// Moves up to max_bytes (0 = no limit) from `from` to `to` without blocking. Stops early
+// while `to` can't take more, so call it again once `to` is writable. Returns the bytes
+// written to `to`, or -1 once `from` closed and everything was forwarded, or on an error.
+ssize_t msock_splice_forward(msock_splice* splice, size_t max_bytes) {
+    msock_client* from = splice->from;
+    msock_client* to = splice->to;
+    size_t moved = 0;
+
+    // Data queued on `to` by regular sends goes first
+    if (!msock_client_flush(to)) return -1;
+    if (msock_client_has_pending_writes(to)) return 0;
+
+#ifdef __linux__
+    for (;;) {
+        if (splice->pipe_pending > 0) {
+            ssize_t written = msock_internal_splice(splice->pipe_fds[0], to->native_socket, splice->pipe_pending);
+            if (written < 0) {
+                if (MSOCK_IS_WOULDBLOCK(errno)) break;
+                printf("splice() failed: %d\n", errno);
+                return -1;
+            }
+
+            splice->pipe_pending -= (size_t)written;
+            moved += (size_t)written;
+            to->cold->stats.bytes_sent += (uint64_t)written;
+            if (splice->pipe_pending > 0) break; // `to` is full
+        }
+
+        if (splice->eof || (max_bytes > 0 && moved >= max_bytes)) break;
+
+        ssize_t received = msock_internal_splice(from->native_socket, splice->pipe_fds[1], MSOCK_READ_BUFFER_SIZE * 4);
+        if (received == 0) {
+            splice->eof = true;
+            break;
+        }
+        if (received < 0) {
+            if (MSOCK_IS_WOULDBLOCK(errno)) break;
+            printf("splice() failed: %d\n", errno);
+            return -1;
+        }
+
+        splice->pipe_pending += (size_t)received;
+        from->cold->stats.bytes_received += (uint64_t)received;
+    }
+#else
+    // No splice, bounce through a stack buffer and let the write queue absorb the rest
+    char chunk[MSOCK_READ_BUFFER_SIZE];
+    msock_message msg = { .buffer = chunk, .size = sizeof(chunk), .len = 0 };
+
+    while (!splice->eof && (max_bytes == 0 || moved < max_bytes) && !msock_client_has_pending_writes(to)) {
+        int received = recv(from->native_socket, chunk, (int)sizeof(chunk), 0);
+        if (received == 0) {
+            splice->eof = true;
+            break;
+        }
+        if (received < 0) {
+            if (MSOCK_IS_WOULDBLOCK(MSOCK_LAST_ERROR)) break;
+            return -1;
+        }
+
+        from->cold->stats.bytes_received += (uint64_t)received;
+        msg.len = (size_t)received;
+        if (!msock_client_send(to, &msg)) return -1;
+        moved += (size_t)received;
+    }
+#endif
+
+    splice->bytes_forwarded += moved;
+
+    if (splice->eof && splice->pipe_pending == 0 && moved == 0 && !msock_client_has_pending_writes(to)) return -1;
+    return (ssize_t)moved;
+}
+
+//MSOCK_LOOP Implementations
+
+bool msock_loop_create(msock_loop* loop_result) {
+    memset(loop_result, 0, sizeof(*loop_result));
+    loop_result->wait_timeout_ms = -1;
+    loop_result->spin_cpu = -1;
+    loop_result->next_timer_id = 1;
+    loop_result->now_ns = msock_time_ns();
+
+#ifdef __linux__
+    loop_result->epoll_fd = epoll_create1(0);
+    if (loop_result->epoll_fd < 0) {
+        printf("epoll_create1() failed: %d\n", errno);
+        return false;
+    }
+#endif
+
+    return true;
+}
+
+bool msock_loop_close(msock_loop* loop) {
+    // Connections still owned by the loop are closed through their handlers
+    for (int slot = 0; slot < loop->entry_capacity; slot++) {
+        msock_loop_entry* entry = &loop->entries[slot];
+        if (entry->sock == INVALID_SOCKET || !entry->client) continue;
+
+        msock_client* client = entry->client;
+        msock_loop_handler handler = entry->handler;
+        msock_loop_remove_client(loop, client);
+
+        if (handler.on_close) handler.on_close(loop, client, handler.ctx);
+        else msock_client_close(client);
+    }
+
+#ifdef __linux__
+    if (loop->epoll_fd >= 0) close(loop->epoll_fd);
+    loop->epoll_fd = -1;
+#else
+    free(loop->poll_fds);
+    free(loop->poll_slots);
+    loop->poll_fds = NULL;
+    loop->poll_slots = NULL;
+#endif
+
+    free(loop->entries);
+    free(loop->free_slots);
+    free(loop->requeued);
+    free(loop->requeued_swap);
+    free(loop->corked);
+    free(loop->timers);
+
+    loop->entries = NULL;
+    loop->free_slots = NULL;
+    loop->requeued = NULL;
+    loop->requeued_swap = NULL;
+    loop->corked = NULL;
+    loop->timers = NULL;
+    loop->entry_capacity = loop->entry_count = loop->free_count = 0;
+    loop->requeued_count = loop->corked_count = loop->timer_count = loop->timer_capacity = 0;
+
+    return true;
+}
+
+static bool msock_internal_loop_grow(msock_loop* loop) {
+    int old_capacity = loop->entry_capacity;
+    int new_capacity = old_capacity ? old_capacity * 2 : 64;
+
+    msock_loop_entry* entries = (msock_loop_entry*)realloc(loop->entries, sizeof(msock_loop_entry) * (size_t)new_capacity);
+    if (!entries) return false;
+    loop->entries = entries;
+
+    int* free_slots = (int*)realloc(loop->free_slots, sizeof(int) * (size_t)new_capacity);
+    if (!free_slots) return false;
+    loop->free_slots = free_slots;
+
+    int* requeued = (int*)realloc(loop->requeued, sizeof(int) * (size_t)new_capacity);
+    if (!requeued) return false;
+    loop->requeued = requeued;
+
+    int* requeued_swap = (int*)realloc(loop->requeued_swap, sizeof(int) * (size_t)new_capacity);
+    if (!requeued_swap) return false;
+    loop->requeued_swap = requeued_swap;
+
+    int* corked = (int*)realloc(loop->corked, sizeof(int) * (size_t)new_capacity);
+    if (!corked) return false;
+    loop->corked = corked;
+
+#ifndef __linux__
+    struct pollfd* poll_fds = (struct pollfd*)realloc(loop->poll_fds, sizeof(struct pollfd) * (size_t)new_capacity);
+    if (!poll_fds) return false;
+    loop->poll_fds = poll_fds;
+
+    uint32_t* poll_slots = (uint32_t*)realloc(loop->poll_slots, sizeof(uint32_t) * (size_t)new_capacity);
+    if (!poll_slots) return false;
+    loop->poll_slots = poll_slots;
+#endif
+
+    // Push in reverse so low slots are handed out first
+    for (int slot = new_capacity - 1; slot >= old_capacity; slot--) {
+        memset(&loop->entries[slot], 0, sizeof(msock_loop_entry));
+        loop->entries[slot].sock = INVALID_SOCKET;
+        loop->free_slots[loop->free_count++] = slot;
+    }
+
+    loop->entry_capacity = new_capacity;
+    return true;
+}
+
+static uint32_t msock_internal_loop_wanted_interest(msock_loop_entry* entry) {
+    msock_client* client = entry->client;
+    if (!client) return MSOCK_LOOP_READ;
+    if (client->socket_state == MSOCK_STATE_CONNECTING) return MSOCK_LOOP_WRITE;
+
+    uint32_t interest = (client->flags & (MSOCK_CLIENT_FLAG_READ_PAUSED | MSOCK_CLIENT_FLAG_THROTTLED)) ? 0 : MSOCK_LOOP_READ;
+    if (client->write_head || (client->flags & MSOCK_CLIENT_FLAG_WANT_WRITE)) interest |= MSOCK_LOOP_WRITE;
+    return interest;
+}
+
+#ifdef __linux__
+static uint32_t msock_internal_epoll_events(msock_loop_entry* entry, uint32_t interest) {
+    uint32_t events = 0;
+    // A paused reader also ignores the peer's FIN, it would keep firing until reading resumes
+    if (interest & MSOCK_LOOP_READ) events |= EPOLLIN | EPOLLRDHUP;
+    if (interest & MSOCK_LOOP_WRITE) events |= EPOLLOUT;
+    if (entry->handler.edge_triggered) events |= EPOLLET;
+    return events;
+}
+#endif
+
+// Re-registers the entry when its wanted interest changed (write queue filled/emptied, connect finished)
+static void msock_internal_loop_update(msock_loop* loop, int slot) {
+    if (slot < 0 || slot >= loop->entry_capacity) return;
+
+    msock_loop_entry* entry = &loop->entries[slot];
+    if (entry->sock == INVALID_SOCKET) return;
+
+    uint32_t wanted = msock_internal_loop_wanted_interest(entry);
+    if (wanted == entry->interest) return;
+
+#ifdef __linux__
+    struct epoll_event ev = { 0 };
+    ev.events = msock_internal_epoll_events(entry, wanted);
+    ev.data.u64 = ((uint64_t)entry->generation << 32) | (uint32_t)slot;
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, entry->sock, &ev) != 0) {
+        printf("epoll_ctl() failed: %d\n", errno);
+        return;
+    }
+#endif
+
+    entry->interest = wanted;
+}
+
+static int msock_internal_loop_add(msock_loop* loop, SOCKET sock, msock_client* client, const msock_loop_handler* handler) {
+    if (loop->free_count == 0 && !msock_internal_loop_grow(loop)) {
+        printf("msock_loop: out of memory\n");
+        return -1;
+    }
+
+    int slot = loop->free_slots[--loop->free_count];
+    msock_loop_entry* entry = &loop->entries[slot];
+    entry->sock = sock;
+    entry->client = client;
+    entry->handler = *handler;
+    entry->interest = msock_internal_loop_wanted_interest(entry);
+    entry->serviced_iteration = 0;
+
+#ifdef __linux__
+    struct epoll_event ev = { 0 };
+    ev.events = msock_internal_epoll_events(entry, entry->interest);
+    ev.data.u64 = ((uint64_t)entry->generation << 32) | (uint32_t)slot;
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, sock, &ev) != 0) {
+        printf("epoll_ctl() failed: %d\n", errno);
+        entry->sock = INVALID_SOCKET;
+        entry->client = NULL;
+        loop->free_slots[loop->free_count++] = slot;
+        return -1;
+    }
+#endif
+
+    loop->entry_count++;
+    return slot;
+}
+
+static void msock_internal_loop_remove(msock_loop* loop, int slot) {
+    msock_loop_entry* entry = &loop->entries[slot];
+    if (entry->sock == INVALID_SOCKET) return;
+
+#ifdef __linux__
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, entry->sock, NULL);
+#endif
+
+    entry->sock = INVALID_SOCKET;
+    entry->client = NULL;
+    entry->generation++;
+    loop->free_slots[loop->free_count++] = slot;
+    loop->entry_count--;
+}
+
+static bool msock_internal_loop_connect_timeout(msock_loop* loop, void* userdata);
+
+bool msock_loop_add_client(msock_loop* loop, msock_client* client, const msock_loop_handler* handler) {
+    if (client->loop) msock_loop_remove_client(client->loop, client);
+
+    msock_set_nonblocking(client->native_socket);
+
+    int slot = msock_internal_loop_add(loop, client->native_socket, client, handler);
+    if (slot < 0) return false;
+
+    client->loop = loop;
+    client->loop_slot = slot;
+
+    // In-flight async connects time out through the loop's timers
+    if (client->socket_state == MSOCK_STATE_CONNECTING && client->cold->connect_deadline_ns != 0) {
+        uint64_t now = msock_time_ns();
+        uint64_t deadline = client->cold->connect_deadline_ns;
+        uint32_t delay_ms = deadline > now ? (uint32_t)((deadline - now + 999999) / 1000000) : 0;
+        client->cold->connect_timer_id = msock_loop_add_timer(loop, delay_ms, 0, msock_internal_loop_connect_timeout, client);
+    }
+
+    return true;
+}
+
+void msock_loop_remove_client(msock_loop* loop, msock_client* client) {
+    if (client->loop != loop || client->loop_slot < 0) return;
+
+    if (client->cold && client->cold->connect_timer_id) {
+        msock_loop_cancel_timer(loop, client->cold->connect_timer_id);
+        client->cold->connect_timer_id = 0;
+    }
+
+    // Without the loop nothing would flush the corked sends any more
+    if (client->flags & MSOCK_CLIENT_FLAG_CORKED) {
+        client->flags &= ~MSOCK_CLIENT_FLAG_CORKED;
+        msock_client_flush(client);
+    }
+
+    msock_internal_loop_remove(loop, client->loop_slot);
+    client->flags &= ~MSOCK_CLIENT_FLAG_REQUEUED;
+    client->loop = NULL;
+    client->loop_slot = -1;
+}
+
+int msock_loop_add_socket(msock_loop* loop, SOCKET sock, const msock_loop_handler* handler) {
+    return msock_internal_loop_add(loop, sock, NULL, handler);
+}
+
+void msock_loop_remove_socket(msock_loop* loop, int slot) {
+    if (slot < 0 || slot >= loop->entry_capacity || loop->entries[slot].client) return;
+    msock_internal_loop_remove(loop, slot);
+}
+
+// For edge-triggered handlers that stopped before EAGAIN: calls on_readable again next
+// iteration even though no new readiness will be reported.
+void msock_loop_requeue(msock_loop* loop, msock_client* client) {
+    if (client->loop != loop || (client->flags & MSOCK_CLIENT_FLAG_REQUEUED)) return;
+
+    // A slot reused within the iteration can show up twice, it is already listed then
+    if (loop->requeued_count >= loop->entry_capacity) return;
+
+    client->flags |= MSOCK_CLIENT_FLAG_REQUEUED;
+    loop->requeued[loop->requeued_count++] = client->loop_slot;
+}
+
+// Drops the connection in slot and lets its handler clean up
+static void msock_internal_loop_drop(msock_loop* loop, int slot) {
+    msock_loop_entry* entry = &loop->entries[slot];
+    msock_client* client = entry->client;
+    msock_loop_handler handler = entry->handler;
+
+    if (client) {
+        // Reconnecting clients leave the loop until the new connection is up
+        if (client->cold && client->cold->reconnect) {
+            msock_internal_reconnect_lost(client);
+            return;
+        }
+
+        msock_loop_remove_client(loop, client);
+        if (handler.on_close) handler.on_close(loop, client, handler.ctx);
+        else msock_client_close(client);
+    } else {
+        msock_internal_loop_remove(loop, slot);
+    }
+}
+
+//Timers
+
+static void msock_internal_timer_swap(msock_loop* loop, int a, int b) {
+    msock_timer tmp = loop->timers[a];
+    loop->timers[a] = loop->timers[b];
+    loop->timers[b] = tmp;
+}
+
+static void msock_internal_timer_sift_up(msock_loop* loop, int index) {
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (loop->timers[parent].deadline_ns <= loop->timers[index].deadline_ns) break;
+        msock_internal_timer_swap(loop, parent, index);
+        index = parent;
+    }
+}
+
+static void msock_internal_timer_sift_down(msock_loop* loop, int index) {
+    for (;;) {
+        int left = index * 2 + 1;
+        int right = left + 1;
+        int smallest = index;
+
+        if (left < loop->timer_count && loop->timers[left].deadline_ns < loop->timers[smallest].deadline_ns) smallest = left;
+        if (right < loop->timer_count && loop->timers[right].deadline_ns < loop->timers[smallest].deadline_ns) smallest = right;
+        if (smallest == index) break;
+
+        msock_internal_timer_swap(loop, smallest, index);
+        index = smallest;
+    }
+}
+
+static bool msock_internal_timer_push(msock_loop* loop, const msock_timer* timer) {
+    if (loop->timer_count == loop->timer_capacity) {
+        int new_capacity = loop->timer_capacity ? loop->timer_capacity * 2 : 16;
+        msock_timer* timers = (msock_timer*)realloc(loop->timers, sizeof(msock_timer) * (size_t)new_capacity);
+        if (!timers) return false;
+        loop->timers = timers;
+        loop->timer_capacity = new_capacity;
+    }
+
+    loop->timers[loop->timer_count] = *timer;
+    msock_internal_timer_sift_up(loop, loop->timer_count);
+    loop->timer_count++;
+    return true;
+}
+
+static void msock_internal_timer_remove_at(msock_loop* loop, int index) {
+    loop->timer_count--;
+    if (index == loop->timer_count) return;
+
+    loop->timers[index] = loop->timers[loop->timer_count];
+    msock_internal_timer_sift_down(loop, index);
+    msock_internal_timer_sift_up(loop, index);
+}
+
+// Returns the timer id, 0 on failure. repeat_ms = 0 makes it a one-shot.
+uint64_t msock_loop_add_timer(msock_loop* loop, uint32_t delay_ms, uint32_t repeat_ms, msock_on_timer_cb cb, void* userdata) {
+    msock_timer timer = { 0 };
+    timer.deadline_ns = msock_time_ns() + (uint64_t)delay_ms * 1000000ull;
+    timer.id = loop->next_timer_id++;
+    timer.repeat_ms = repeat_ms;
+    timer.cb = cb;
+    timer.userdata = userdata;
+
+    if (!msock_internal_timer_push(loop, &timer)) return 0;
+    return timer.id;
+}
+
+bool msock_loop_cancel_timer(msock_loop* loop, uint64_t timer_id) {
+    for (int i = 0; i < loop->timer_count; i++) {
+        if (loop->timers[i].id == timer_id) {
+            msock_internal_timer_remove_at(loop, i);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void msock_internal_loop_run_timers(msock_loop* loop) {
+    while (loop->timer_count > 0 && loop->timers[0].deadline_ns <= loop->now_ns) {
+        msock_timer timer = loop->timers[0];
+        msock_internal_timer_remove_at(loop, 0);
+
+        bool keep = timer.cb(loop, timer.userdata);
+
+        if (keep && timer.repeat_ms > 0) {
+            // Schedule from the previous deadline so repeating timers don't drift
+            timer.deadline_ns += (uint64_t)timer.repeat_ms * 1000000ull;
+            if (timer.deadline_ns <= loop->now_ns) timer.deadline_ns = loop->now_ns + (uint64_t)timer.repeat_ms * 1000000ull;
+            msock_internal_timer_push(loop, &timer);
+        }
+    }
+}
+
+uint64_t msock_loop_now_ns(msock_loop* loop) {
+    return loop->now_ns;
+}
+
+//Connects
+
+static void msock_internal_finish_connect(msock_client* client_socket, int error);
+
+static void msock_internal_loop_finish_connect(msock_loop* loop, msock_client* client, int error) {
+    if (client->cold->connect_timer_id) {
+        msock_loop_cancel_timer(loop, client->cold->connect_timer_id);
+        client->cold->connect_timer_id = 0;
+    }
+
+    // A failed connect loses its socket, so it can't stay registered
+    if (error != 0) msock_loop_remove_client(loop, client);
+
+    msock_internal_finish_connect(client, error);
+
+    if (error == 0 && client->loop == loop) msock_internal_loop_update(loop, client->loop_slot);
+}
+
+static bool msock_internal_loop_connect_timeout(msock_loop* loop, void* userdata) {
+    msock_client* client = (msock_client*)userdata;
+    client->cold->connect_timer_id = 0;
+
+    if (client->loop == loop && client->socket_state == MSOCK_STATE_CONNECTING) {
+        msock_internal_loop_finish_connect(loop, client, MSOCK_ETIMEDOUT);
+    }
+    return false;
+}
+
+//Dispatch
+
+// Waits up to timeout_ms (-1 = forever) and fills loop->events. Returns the count or -1 on error.
+static int msock_internal_loop_wait(msock_loop* loop, int timeout_ms) {
+#ifdef __linux__
+    struct epoll_event events[MSOCK_LOOP_MAX_EVENTS];
+    int activity = epoll_wait(loop->epoll_fd, events, MSOCK_LOOP_MAX_EVENTS, timeout_ms);
+    if (activity < 0) {
+        if (errno == EINTR) return 0;
+        printf("epoll_wait() error: %d\n", errno);
+        return -1;
+    }
+
+    for (int i = 0; i < activity; i++) {
+        msock_loop_event* event = &loop->events[i];
+        event->slot = (uint32_t)(events[i].data.u64 & 0xffffffffu);
+        event->generation = (uint32_t)(events[i].data.u64 >> 32);
+        event->events = 0;
+        if (events[i].events & EPOLLIN) event->events |= MSOCK_LOOP_READ;
+        if (events[i].events & EPOLLOUT) event->events |= MSOCK_LOOP_WRITE;
+        if (events[i].events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) event->events |= MSOCK_LOOP_ERROR;
+    }
+    return activity;
+#else
+    int count = 0;
+    for (int slot = 0; slot < loop->entry_capacity; slot++) {
+        msock_loop_entry* entry = &loop->entries[slot];
+        if (entry->sock == INVALID_SOCKET) continue;
+
+        loop->poll_fds[count].fd = entry->sock;
+        loop->poll_fds[count].events = (short)(((entry->interest & MSOCK_LOOP_READ) ? POLLIN : 0) |
+                                               ((entry->interest & MSOCK_LOOP_WRITE) ? POLLOUT : 0));
+        loop->poll_fds[count].revents = 0;
+        loop->poll_slots[count] = (uint32_t)slot;
+        count++;
+    }
+
+    if (count == 0) {
+        if (timeout_ms != 0) msock_internal_sleep_ms(timeout_ms > 0 ? timeout_ms : MSOCK_GROUP_STOP_POLL_MS);
+        return 0;
+    }
+
+    int activity = msock_poll(loop->poll_fds, (unsigned long)count, timeout_ms);
+    if (activity == SOCKET_ERROR) {
+        printf("poll() error: %d\n", MSOCK_LAST_ERROR);
+        return -1;
+    }
+
+    int ready = 0;
+    for (int i = 0; i < count && ready < activity && ready < MSOCK_LOOP_MAX_EVENTS; i++) {
+        short revents = loop->poll_fds[i].revents;
+        if (revents == 0) continue;
+
+        msock_loop_event* event = &loop->events[ready++];
+        event->slot = loop->poll_slots[i];
+        event->generation = loop->entries[event->slot].generation;
+        event->events = 0;
+        if (revents & POLLIN) event->events |= MSOCK_LOOP_READ;
+        if (revents & POLLOUT) event->events |= MSOCK_LOOP_WRITE;
+        if (revents & (POLLERR | POLLHUP | POLLNVAL)) event->events |= MSOCK_LOOP_ERROR;
+    }
+    return ready;
+#endif
+}
+
+static bool msock_internal_loop_entry_valid(msock_loop* loop, uint32_t slot, uint32_t generation) {
+    return slot < (uint32_t)loop->entry_capacity &&
+           loop->entries[slot].sock != INVALID_SOCKET &&
+           loop->entries[slot].generation == generation;
+}
+
+static void msock_internal_loop_read(msock_loop* loop, int slot) {
+    msock_loop_entry* entry = &loop->entries[slot];
+    if (entry->serviced_iteration == loop->iteration) return;
+    entry->serviced_iteration = loop->iteration;
+
+    msock_client* client = entry->client;
+    if (client) client->flags &= ~MSOCK_CLIENT_FLAG_REQUEUED;
+
+    bool keep_alive = true;
+    if (entry->handler.on_readable) keep_alive = entry->handler.on_readable(loop, client, entry->handler.ctx);
+
+    // The handler may have closed or moved the client itself
+    if (!keep_alive && loop->entries[slot].sock != INVALID_SOCKET && loop->entries[slot].client == client) {
+        msock_internal_loop_drop(loop, slot);
+    }
+}
+
+static void msock_internal_loop_dispatch(msock_loop* loop, int event_count) {
+    // Take the backlog first so clients requeued during this pass wait for the next iteration.
+    // It stays in requeued_swap: a handler that adds a client can grow (realloc) the arrays.
+    int* backlog = loop->requeued;
+    int backlog_count = loop->requeued_count;
+    loop->requeued = loop->requeued_swap;
+    loop->requeued_swap = backlog;
+    loop->requeued_count = 0;
+
+    // Fresh events go before the backlog, a heavy sender already had its turn
+    for (int i = 0; i < event_count; i++) {
+        msock_loop_event event = loop->events[i];
+        if (!msock_internal_loop_entry_valid(loop, event.slot, event.generation)) continue;
+
+        int slot = (int)event.slot;
+        msock_client* client = loop->entries[slot].client;
+
+        if (client && client->socket_state == MSOCK_STATE_CONNECTING) {
+            if (event.events & (MSOCK_LOOP_WRITE | MSOCK_LOOP_ERROR)) {
+                int error = 0;
+                socklen_t len = sizeof(error);
+                if (getsockopt(client->native_socket, SOL_SOCKET, SO_ERROR, (char*)&error, &len) == SOCKET_ERROR) {
+                    error = MSOCK_LAST_ERROR;
+                }
+                msock_internal_loop_finish_connect(loop, client, error);
+            }
+            continue;
+        }
+
+        if (client && (event.events & MSOCK_LOOP_WRITE)) {
+            if (!msock_client_flush(client)) {
+                msock_internal_loop_drop(loop, slot);
+                continue;
+            }
+
+            msock_loop_entry* entry = &loop->entries[slot];
+            if (entry->handler.on_writable && !entry->handler.on_writable(loop, client, entry->handler.ctx)) {
+                if (msock_internal_loop_entry_valid(loop, event.slot, event.generation)) msock_internal_loop_drop(loop, slot);
+                continue;
+            }
+            if (!msock_internal_loop_entry_valid(loop, event.slot, event.generation)) continue;
+        }
+
+        // Zerocopy completions land on the error queue and raise an error event by themselves
+        if (client && (event.events & MSOCK_LOOP_ERROR) && client->cold->zerocopy_head) {
+            msock_client_reap_zerocopy(client);
+        }
+
+        if (event.events & (MSOCK_LOOP_READ | MSOCK_LOOP_ERROR)) {
+            if (msock_internal_loop_entry_valid(loop, event.slot, event.generation)) msock_internal_loop_read(loop, slot);
+        }
+    }
+
+    for (int i = 0; i < backlog_count; i++) {
+        int slot = loop->requeued_swap[i];
+        msock_loop_entry* entry = &loop->entries[slot];
+        if (entry->sock == INVALID_SOCKET || !entry->client) continue;
+        if (!(entry->client->flags & MSOCK_CLIENT_FLAG_REQUEUED)) continue;
+
+        msock_internal_loop_read(loop, slot);
+    }
+}
+
+// Ends the iteration's cork: every client that sent during it gets one vectored flush
+static void msock_internal_loop_uncork(msock_loop* loop) {
+    loop->corking = false;
+
+    for (int i = 0; i < loop->corked_count; i++) {
+        int slot = loop->corked[i];
+        msock_client* client = loop->entries[slot].client;
+        if (!client || !(client->flags & MSOCK_CLIENT_FLAG_CORKED)) continue;
+
+        client->flags &= ~MSOCK_CLIENT_FLAG_CORKED;
+        loop->stats.cork_flushes++;
+
+        if (!msock_client_flush(client)) {
+            msock_internal_loop_drop(loop, slot);
+            continue;
+        }
+        // Whatever the kernel did not take waits for write readiness
+        msock_internal_loop_update(loop, slot);
+    }
+
+    loop->corked_count = 0;
+}
+
+static int msock_internal_loop_timeout(msock_loop* loop) {
+    if (loop->requeued_count > 0) return 0;
+
+    int timeout_ms = loop->wait_timeout_ms;
+    if (loop->timer_count > 0) {
+        uint64_t now = msock_time_ns();
+        uint64_t deadline = loop->timers[0].deadline_ns;
+        int until_timer = deadline > now ? (int)((deadline - now + 999999) / 1000000) : 0;
+        if (timeout_ms < 0 || until_timer < timeout_ms) timeout_ms = until_timer;
+    }
+    return timeout_ms;
+}
+
+// Runs one iteration: wait for readiness, dispatch, then fire due timers
+bool msock_loop_run(msock_loop* loop) {
+    if (loop->spin_cpu >= 0 && !loop->spin_cpu_pinned) {
+        msock_set_thread_affinity(loop->spin_cpu);
+        loop->spin_cpu_pinned = true;
+    }
+
+    msock_loop_stats* stats = &loop->stats;
+    stats->iterations++;
+    loop->iteration++;
+
+    int timeout_ms = msock_internal_loop_timeout(loop);
+    int ready = 0;
+
+    if (timeout_ms == 0) {
+        // Backlog or a due timer, only pick up new events without waiting
+        ready = msock_internal_loop_wait(loop, 0);
+    } else {
+        // Spin with zero-timeout polls before giving the core up to a blocking wait
+        if (loop->spin_budget_us > 0) {
+            uint64_t spin_start = msock_time_ns();
+            uint64_t spin_end = spin_start + (uint64_t)loop->spin_budget_us * 1000;
+            uint64_t now = spin_start;
+
+            do {
+                ready = msock_internal_loop_wait(loop, 0);
+                stats->spin_polls++;
+                now = msock_time_ns();
+            } while (ready == 0 && now < spin_end);
+
+            stats->spin_ns += now - spin_start;
+            if (ready != 0) stats->spin_hits++;
+        }
+
+        if (ready == 0) {
+            uint64_t block_start = msock_time_ns();
+            ready = msock_internal_loop_wait(loop, msock_internal_loop_timeout(loop));
+            stats->blocking_waits++;
+            stats->blocked_ns += msock_time_ns() - block_start;
+        }
+    }
+
+    if (ready < 0) return false;
+
+    uint64_t work_start = msock_time_ns();
+    loop->now_ns = work_start;
+
+    loop->corking = loop->cork_enabled;
+    msock_internal_loop_dispatch(loop, ready);
+    msock_internal_loop_run_timers(loop);
+    msock_internal_loop_uncork(loop);
+
+    stats->productive_ns += msock_time_ns() - work_start;
+
+    return true;
+}
+
+void msock_loop_set_spin(msock_loop* loop, uint32_t spin_budget_us, int cpu) {
+    loop->spin_budget_us = spin_budget_us;
+    loop->spin_cpu = cpu;
+    loop->spin_cpu_pinned = false;
+}
+
+void msock_loop_set_wait_timeout(msock_loop* loop, int timeout_ms) {
+    loop->wait_timeout_ms = timeout_ms;
+}
+
+// With cork enabled, sends made from callbacks and timers only queue up and every client
+// is flushed once with a single vectored send when the iteration ends. Several small sends
+// in one callback then leave as one syscall and one segment instead of one each. Call
+// msock_client_flush for a reply that should not wait for the rest of the iteration.
+void msock_loop_set_cork(msock_loop* loop, bool enabled) {
+    loop->cork_enabled = enabled;
+}
+
+const msock_loop_stats* msock_loop_get_stats(msock_loop* loop) {
+    return &loop->stats;
+}
+
+void msock_loop_reset_stats(msock_loop* loop) {
+    memset(&loop->stats, 0, sizeof(loop->stats));
+}
+
+//MSOCK_RECONNECT Implementations
+
+static void msock_internal_reconnect_notify(msock_client* client, msock_state old_state) {
+    msock_reconnect* reconnect = client->cold->reconnect;
+    if (reconnect->config.state_cb && old_state != client->socket_state) {
+        reconnect->config.state_cb(client, old_state, (msock_state)client->socket_state);
+    }
+}
+
+// Full jitter: a random delay below the exponential ceiling, so a fleet that lost the
+// same backend at the same moment does not come back in lockstep
+static uint32_t msock_internal_reconnect_delay_ms(msock_reconnect* reconnect) {
+    uint64_t ceiling = reconnect->config.initial_delay_ms;
+    for (uint32_t i = 1; i < reconnect->attempt && ceiling < reconnect->config.max_delay_ms; i++) ceiling *= 2;
+    if (ceiling > reconnect->config.max_delay_ms) ceiling = reconnect->config.max_delay_ms;
+
+    reconnect->rng ^= reconnect->rng << 13;
+    reconnect->rng ^= reconnect->rng >> 7;
+    reconnect->rng ^= reconnect->rng << 17;
+    return (uint32_t)(reconnect->rng % (ceiling + 1));
+}
+
+static void msock_internal_reconnect_attempt(msock_client* client);
+
+static bool msock_internal_reconnect_timer(msock_loop* loop, void* userdata) {
+    (void)loop;
+    msock_client* client = (msock_client*)userdata;
+    client->cold->reconnect->timer_id = 0;
+
+    msock_internal_reconnect_attempt(client);
+    return false;
+}
+
+static void msock_internal_reconnect_schedule(msock_client* client, uint32_t delay_ms) {
+    msock_reconnect* reconnect = client->cold->reconnect;
+    reconnect->next_attempt_ns = msock_time_ns() + (uint64_t)delay_ms * 1000000ull;
+
+    if (reconnect->loop) {
+        reconnect->timer_id = msock_loop_add_timer(reconnect->loop, delay_ms, 0, msock_internal_reconnect_timer, client);
+    }
+}
+
+static void msock_internal_reconnect_failed(msock_client* client, msock_state old_state) {
+    msock_reconnect* reconnect = client->cold->reconnect;
+    reconnect->consecutive_failures++;
+
+    uint32_t threshold = reconnect->config.failure_threshold;
+    if (threshold > 0 && reconnect->consecutive_failures >= threshold) {
+        // Drop what was buffered so senders fail fast instead of piling up behind a dead backend
+        msock_internal_client_clear_queue(client);
+        reconnect->buffered_bytes = 0;
+
+        client->socket_state = MSOCK_STATE_CIRCUIT_OPEN;
+        msock_internal_reconnect_notify(client, old_state);
+        msock_internal_reconnect_schedule(client, reconnect->config.breaker_cooldown_ms);
+        return;
+    }
+
+    client->socket_state = MSOCK_STATE_RECONNECTING;
+    msock_internal_reconnect_notify(client, old_state);
+    msock_internal_reconnect_schedule(client, msock_internal_reconnect_delay_ms(reconnect));
+}
+
+static void msock_internal_reconnect_result(msock_client* client, int error) {
+    msock_reconnect* reconnect = client->cold->reconnect;
+    if (!reconnect) return;
+    reconnect->attempt_pending = false;
+
+    if (error != 0) {
+        msock_internal_reconnect_failed(client, MSOCK_STATE_CONNECTING);
+        return;
+    }
+
+    reconnect->attempt = 0;
+    reconnect->consecutive_failures = 0;
+    reconnect->buffered_bytes = 0;
+
+    // Standalone clients are used with blocking calls, like after msock_client_connect
+    if (!reconnect->loop) msock_set_blocking(client->native_socket);
+
+    // The old connection may have taken part of the first message, resend it whole
+    if (client->write_head) client->write_head->offset = 0;
+
+    msock_internal_reconnect_notify(client, MSOCK_STATE_CONNECTING);
+
+    // On a loop the queue drains once the loop picks up write interest
+    if (!reconnect->loop) msock_client_flush(client);
+}
+
+static void msock_internal_reconnect_attempt(msock_client* client) {
+    msock_reconnect* reconnect = client->cold->reconnect;
+    msock_state old_state = (msock_state)client->socket_state;
+
+    reconnect->attempt++;
+    reconnect->attempt_pending = true;
+
+    struct sockaddr_in addr;
+    if (!msock_internal_resolve(reconnect->host, reconnect->port, &addr) ||
+        !msock_client_connect_addr_async(client, &addr, reconnect->config.connect_timeout_ms, msock_internal_reconnect_result)) {
+        // An immediate connect() error was already reported through the callback
+        if (reconnect->attempt_pending) {
+            reconnect->attempt_pending = false;
+            msock_internal_reconnect_failed(client, old_state);
+        }
+        return;
+    }
+
+    msock_internal_reconnect_notify(client, old_state);
+
+    if (reconnect->loop && !msock_loop_add_client(reconnect->loop, client, &reconnect->handler)) {
+        msock_internal_reconnect_result(client, MSOCK_ECONNRESET);
+    }
+}
+
+// Called wherever a connected client finds its connection dead
+static void msock_internal_reconnect_lost(msock_client* client) {
+    msock_reconnect* reconnect = client->cold->reconnect;
+
+    if (client->loop) {
+        reconnect->loop = client->loop;
+        reconnect->handler = client->loop->entries[client->loop_slot].handler;
+        msock_loop_remove_client(client->loop, client);
+    }
+
+    if (client->socket_state != MSOCK_STATE_CONNECTED) return;
+
+    msock_internal_client_discard_socket(client);
+    client->socket_state = MSOCK_STATE_RECONNECTING;
+    msock_internal_reconnect_notify(client, MSOCK_STATE_CONNECTED);
+
+    msock_internal_reconnect_schedule(client, msock_internal_reconnect_delay_ms(reconnect));
+}
+
+static bool msock_internal_reconnect_queue(msock_client* client, const char* data, size_t len, msock_buffer* buffer) {
+    msock_reconnect* reconnect = client->cold->reconnect;
+
+    if (client->socket_state == MSOCK_STATE_CIRCUIT_OPEN) return false;
+    if (reconnect->buffered_bytes + len > reconnect->config.max_buffered_bytes) return false;
+
+    if (buffer) {
+        msock_buffer_retain(buffer);
+    } else {
+        buffer = msock_buffer_acquire(len);
+        if (!buffer) return false;
+        memcpy(buffer->data, data, len);
+        buffer->len = len;
+    }
+
+    if (!msock_internal_client_enqueue(client, buffer, 0)) return false;
+
+    reconnect->buffered_bytes += len;
+    client->cold->stats.messages_sent++;
+    return true;
+}
+
+// Reconnects ip:port with backoff whenever the connection drops. Clients on a msock_loop
+// retry from loop timers, standalone clients from msock_client_service_reconnect.
+// A client that is not connected yet starts trying right away.
+bool msock_client_enable_reconnect(msock_client* client_socket, const char* ip, const char* port, const msock_reconnect_config* config) {
+    msock_reconnect* reconnect = client_socket->cold->reconnect;
+    if (!reconnect) {
+        reconnect = (msock_reconnect*)calloc(1, sizeof(msock_reconnect));
+        if (!reconnect) return false;
+        client_socket->cold->reconnect = reconnect;
+    }
+
+    if (config) reconnect->config = *config;
+    if (reconnect->config.initial_delay_ms == 0) reconnect->config.initial_delay_ms = 100;
+    if (reconnect->config.max_delay_ms == 0) reconnect->config.max_delay_ms = 30000;
+    if (reconnect->config.breaker_cooldown_ms == 0) reconnect->config.breaker_cooldown_ms = 30000;
+    if (reconnect->config.connect_timeout_ms == 0) reconnect->config.connect_timeout_ms = 5000;
+
+    snprintf(reconnect->host, sizeof(reconnect->host), "%s", ip);
+    snprintf(reconnect->port, sizeof(reconnect->port), "%s", port);
+    reconnect->rng = (msock_time_ns() ^ (uint64_t)(uintptr_t)client_socket) | 1;
+
+    if (client_socket->loop) {
+        reconnect->loop = client_socket->loop;
+        reconnect->handler = client_socket->loop->entries[client_socket->loop_slot].handler;
+    }
+
+    if (client_socket->socket_state == MSOCK_STATE_DISCONNECTED) {
+        if (client_socket->loop) msock_loop_remove_client(client_socket->loop, client_socket);
+        client_socket->socket_state = MSOCK_STATE_RECONNECTING;
+        msock_internal_reconnect_notify(client_socket, MSOCK_STATE_DISCONNECTED);
+        msock_internal_reconnect_schedule(client_socket, 0);
+    }
+
+    return true;
+}
+
+void msock_client_disable_reconnect(msock_client* client_socket) {
+    msock_reconnect* reconnect = client_socket->cold->reconnect;
+    if (!reconnect) return;
+
+    if (reconnect->loop && reconnect->timer_id) msock_loop_cancel_timer(reconnect->loop, reconnect->timer_id);
+    client_socket->cold->reconnect = NULL;
+    free(reconnect);
+
+    if (client_socket->socket_state == MSOCK_STATE_RECONNECTING || client_socket->socket_state == MSOCK_STATE_CIRCUIT_OPEN) {
+        client_socket->socket_state = MSOCK_STATE_DISCONNECTED;
+    }
+}
+
+// Drives reconnect attempts of a client that is not on a msock_loop, call it regularly.
+// Never blocks. Returns true while the client is connected.
+bool msock_client_service_reconnect(msock_client* client_socket) {
+    msock_reconnect* reconnect = client_socket->cold->reconnect;
+    if (!reconnect || reconnect->loop) return msock_client_is_connected(client_socket);
+
+    if ((client_socket->socket_state == MSOCK_STATE_RECONNECTING || client_socket->socket_state == MSOCK_STATE_CIRCUIT_OPEN) &&
+        msock_time_ns() >= reconnect->next_attempt_ns) {
+        msock_internal_reconnect_attempt(client_socket);
+    }
+
+    if (client_socket->socket_state == MSOCK_STATE_CONNECTING) {
+        msock_client_poll_connects(&client_socket, 1, 0);
+    }
+
+    return msock_client_is_connected(client_socket);
+}
+
+//MSOCK_SERVER Implementations
+
+bool msock_server_create(msock_server* server_result) {
+    SOCKET sock = INVALID_SOCKET;
+    sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sock == INVALID_SOCKET) {
+        printf("socket() failed: %d\n", MSOCK_LAST_ERROR);
+        return false;
+    }
+
+    memset(server_result, 0, sizeof(*server_result));
+    server_result->native_socket = sock;
+    server_result->socket_state = MSOCK_STATE_UNBOUND;
+    server_result->listener_slot = -1;
+
+    if (!msock_loop_create(&server_result->own_loop)) {
+        closesocket(sock);
+        return false;
+    }
+    server_result->loop = &server_result->own_loop;
+
+    for (int i = 0; i < MSOCK_MAX_CLIENTS; i++) {
+        server_result->connected_clients[i].native_socket = INVALID_SOCKET;
+        server_result->connected_clients[i].socket_state = MSOCK_STATE_DISCONNECTED;
+        server_result->connected_clients[i].socket_protocol = MSOCK_TCP;
+        server_result->connected_clients[i].loop_slot = -1;
+        server_result->connected_clients[i].cold = &server_result->connected_clients_cold[i];
+    }
+
+    return true;
+}
+
+void msock_server_set_userdata(msock_server* server, void* userdata) {
+    server->userdata = userdata;
+}
+
+void msock_server_set_options(msock_server* server, const msock_socket_options* options) {
+    if (options) {
+        server->options = *options;
+        server->has_options = true;
+    } else {
+        server->has_options = false;
+    }
+}
+
+// Runs the server on a loop shared with other servers or outbound clients. Call before listen.
+void msock_server_set_loop(msock_server* server, msock_loop* loop) {
+    server->loop = loop ? loop : &server->own_loop;
+}
+
+static bool msock_internal_server_on_accept(msock_loop* loop, msock_client* client, void* ctx);
+static void msock_internal_relay_start(msock_server* server, int slot);
+static bool msock_internal_rate_charge(msock_server* server, msock_client* client, uint64_t bytes, uint64_t messages);
+static bool msock_internal_rate_accept(msock_server* server);
+
+static bool msock_internal_server_add_listener(msock_server* server) {
+    msock_loop_handler handler = { 0 };
+    handler.on_readable = msock_internal_server_on_accept;
+    handler.ctx = server;
+
+    server->listener_slot = msock_loop_add_socket(server->loop, server->native_socket, &handler);
+    return server->listener_slot >= 0;
+}
+static void msock_internal_relay_release(msock_relay* relay);
+static void msock_internal_balancer_free(msock_server* server);
+static void msock_internal_pubsub_drop(msock_server* server, int slot);
+
+bool msock_server_listen(msock_server* server_socket, const char* ip, const char* port) {
+    struct sockaddr_in addr;
+    if (!msock_internal_resolve(ip, port, &addr)) return false;
+
+    msock_set_nonblocking(server_socket->native_socket);
+
+#ifndef _WIN32
+    // A restarted server must not wait for TIME_WAIT connections of the previous one
+    MSOCK_INTERNAL_SETOPT(server_socket->native_socket, SOL_SOCKET, SO_REUSEADDR, 1);
+#endif
+
+    if (server_socket->has_options) {
+        msock_apply_socket_options(server_socket->native_socket, &server_socket->options, true);
+    }
+
+    int success = bind(server_socket->native_socket, (const struct sockaddr*)&addr, sizeof(addr));
+    if (success == SOCKET_ERROR) {
+        printf("bind() failed: %d\n", MSOCK_LAST_ERROR);
+        return false;
+    }
+
+    success = listen(server_socket->native_socket, SOMAXCONN);
+    if (success == SOCKET_ERROR) {
+        printf("listen() failed: %d\n", MSOCK_LAST_ERROR);
+        return false;
+    }
+
+    if (!msock_internal_server_add_listener(server_socket)) return false;
+
+    server_socket->socket_state = MSOCK_STATE_LISTENING;
+
+    return true;
+}
+
+bool msock_server_is_listening(msock_server* server_socket) {
+    return server_socket->socket_state == MSOCK_STATE_LISTENING;
+}
+
+bool msock_server_close(msock_server* server_socket) {
+    bool success = true;
+
+    for (int word = 0; word < MSOCK_CLIENT_SLOT_WORDS; word++) {
+        uint64_t bits = server_socket->active_slots[word];
+        server_socket->active_slots[word] = 0;
+
+        while (bits) {
+            int i = word * 64 + msock_internal_ctz64(bits);
+            bits &= bits - 1;
+            msock_client* client = &server_socket->connected_clients[i];
+
+            if (server_socket->relays && server_socket->relays[i].active) msock_internal_relay_release(&server_socket->relays[i]);
+            if (client->socket_state == MSOCK_STATE_DISCONNECTED && client->native_socket == INVALID_SOCKET) continue;
+
+            if (!msock_client_close(client)) {
+                printf("closing client %d failed\n", i);
+                success = false;
+            }
+
+            if (server_socket->disconnect_cb) server_socket->disconnect_cb(client);
+        }
+    }
+
+    msock_loop_remove_socket(server_socket->loop, server_socket->listener_slot);
+    server_socket->listener_slot = -1;
+
+    closesocket(server_socket->native_socket);
+    server_socket->socket_state = MSOCK_STATE_UNBOUND;
+
+    msock_internal_balancer_free(server_socket);
+    msock_server_set_rate_limit(server_socket, NULL);
+    msock_loop_close(&server_socket->own_loop);
+
+    free(server_socket->relays);
+    server_socket->relays = NULL;
+
+    free(server_socket->topics);
+    server_socket->topics = NULL;
+    server_socket->topic_capacity = 0;
+    server_socket->topic_count = 0;
+
+    return success;
+}
+
+static bool msock_internal_server_on_readable(msock_loop* loop, msock_client* client, void* ctx);
+static void msock_internal_server_on_close(msock_loop* loop, msock_client* client, void* ctx);
+
+// Takes the lowest free client slot, -1 when the server is full
+static int msock_internal_server_claim_slot(msock_server* server) {
+    for (int word = 0; word < MSOCK_CLIENT_SLOT_WORDS; word++) {
+        uint64_t free_bits = ~server->active_slots[word];
+        if (!free_bits) continue;
+
+        int slot = word * 64 + msock_internal_ctz64(free_bits);
+        if (slot >= MSOCK_MAX_CLIENTS) return -1;
+
+        server->active_slots[word] |= 1ull << (slot & 63);
+        return slot;
+    }
+    return -1;
+}
+
+static void msock_internal_server_release_slot(msock_server* server, int slot) {
+    server->active_slots[slot >> 6] &= ~(1ull << (slot & 63));
+}
+
+static void msock_internal_handle_accept(msock_server* server) {
+    if (server->rate_limited && !msock_internal_rate_accept(server)) return;
+
+    struct sockaddr_in address;
+    socklen_t addrlen = sizeof(address);
+
+    SOCKET new_socket = accept(server->native_socket, (struct sockaddr*)&address, &addrlen);
+
+    if (new_socket == INVALID_SOCKET) {
+        if (MSOCK_IS_WOULDBLOCK(MSOCK_LAST_ERROR)) return;
+        printf("accept() failed, INVALID_SOCKET. Error: %d\n", MSOCK_LAST_ERROR);
+        return;
+    }
+
+    int free_slot = msock_internal_server_claim_slot(server);
+    if (free_slot == -1) {
+        printf("Server full, rejecting connection.\n");
+        closesocket(new_socket);
+        return;
+    }
+
+    msock_client* c = &server->connected_clients[free_slot];
+    c->native_socket = new_socket;
+    c->socket_state = MSOCK_STATE_CONNECTED;
+
+    // Only the raw address is stored, msock_client_get_ip formats it on demand
+    memset(c->cold, 0, sizeof(*c->cold));
+    c->cold->peer_addr = address;
+
+    if (server->rate_limited) {
+        server->accept_tokens -= 1000;
+
+        // Every connection starts with full buckets
+        c->cold->rate_bytes = (int64_t)(server->rate_limit.bytes_burst * 1000);
+        c->cold->rate_messages = (int64_t)server->rate_limit.messages_burst * 1000;
+        c->cold->rate_refilled_ms = server->rate_clock_ms;
+    }
+
+    msock_set_nonblocking(new_socket);
+
+    c->flags = 0;
+    if (server->has_options) {
+        msock_apply_socket_options(new_socket, &server->options, false);
+        if (server->options.tcp_quickack) c->flags |= MSOCK_CLIENT_FLAG_QUICKACK;
+        msock_internal_zerocopy_enable(c, server->options.zerocopy_threshold);
+    }
+
+    bool allow = true;
+    if (server->connect_cb != NULL) {
+        allow = server->connect_cb(c);
+    }
+
+    if (!allow) {
+        closesocket(new_socket);
+        c->native_socket = INVALID_SOCKET;
+        c->socket_state = MSOCK_STATE_DISCONNECTED;
+        msock_internal_server_release_slot(server, free_slot);
+        return;
+    }
+
+    if (server->relay_cb) {
+        msock_internal_relay_start(server, free_slot);
+        return;
+    }
+
+    msock_loop_handler handler = { 0 };
+    handler.on_readable = msock_internal_server_on_readable;
+    handler.on_close = msock_internal_server_on_close;
+    handler.ctx = server;
+    handler.edge_triggered = server->data_cb != NULL;
+
+    if (!msock_loop_add_client(server->loop, c, &handler)) {
+        closesocket(new_socket);
+        c->native_socket = INVALID_SOCKET;
+        c->socket_state = MSOCK_STATE_DISCONNECTED;
+        msock_internal_server_release_slot(server, free_slot);
+    }
+}
+
+static bool msock_internal_server_on_accept(msock_loop* loop, msock_client* client, void* ctx) {
+    (void)loop;
+    (void)client;
+    msock_internal_handle_accept((msock_server*)ctx);
+    return true;
+}
+
+// Reads until EAGAIN or until the client used up its budget for this iteration.
+// Returns false when the connection should be dropped.
+static bool msock_internal_drain_client(msock_server* server, msock_client* client) {
+    msock_loop* loop = server->loop;
+    size_t bytes = 0;
+    uint32_t reads = 0;
+
+    msock_message msg = { .buffer = loop->read_buffer, .size = sizeof(loop->read_buffer), .len = 0 };
+
+    // A requeue from before the client ran out of tokens
+    if (client->flags & MSOCK_CLIENT_FLAG_THROTTLED) return true;
+
+    for (;;) {
+        if (bytes >= server->drain_byte_budget || reads >= server->drain_read_budget) {
+            // With edge-triggered readiness nobody would wake us up again for the leftover data
+            msock_loop_requeue(loop, client);
+            return true;
+        }
+
+        ssize_t received = msock_client_receive(client, &msg);
+        if (received > 0) {
+            bytes += (size_t)received;
+            reads++;
+            if (!server->data_cb(server, client, &msg)) return false;
+            if (server->rate_limited && !msock_internal_rate_charge(server, client, (uint64_t)received, 1)) return true;
+            continue;
+        }
+
+        // 0 is either EAGAIN (still connected, fully drained) or an orderly close
+        return received == 0 && client->socket_state == MSOCK_STATE_CONNECTED;
+    }
+}
+
+static bool msock_internal_server_on_readable(msock_loop* loop, msock_client* client, void* ctx) {
+    (void)loop;
+    msock_server* server = (msock_server*)ctx;
+
+    if (server->data_cb != NULL) return msock_internal_drain_client(server, client);
+    if (server->client_cb == NULL) return true;
+    if (!server->rate_limited) return server->client_cb(server, client);
+
+    // The callback does its own receives, charge whatever they added to the stats
+    msock_client_stats before = client->cold->stats;
+    if (!server->client_cb(server, client)) return false;
+    if (client->socket_state == MSOCK_STATE_CONNECTED) {
+        msock_internal_rate_charge(server, client, client->cold->stats.bytes_received - before.bytes_received,
+                                   client->cold->stats.messages_received - before.messages_received);
+    }
+    return true;
+}
+
+static void msock_internal_server_on_close(msock_loop* loop, msock_client* client, void* ctx) {
+    (void)loop;
+    msock_server* server = (msock_server*)ctx;
+
+    msock_client_close(client);
+    if (server->disconnect_cb) server->disconnect_cb(client);
+    if (client->flags & MSOCK_CLIENT_FLAG_THROTTLED) server->rate_stats.throttled_clients--;
+    client->flags = 0;
+    client->socket_state = MSOCK_STATE_DISCONNECTED;
+
+    int slot = (int)(client - server->connected_clients);
+    if (server->topics) msock_internal_pubsub_drop(server, slot);
+    msock_internal_server_release_slot(server, slot);
+}
+
+bool msock_server_run(msock_server* server) {
+    return msock_loop_run(server->loop);
+}
+
+void msock_server_set_spin(msock_server* server, uint32_t spin_budget_us, int cpu) {
+    msock_loop_set_spin(server->loop, spin_budget_us, cpu);
+}
+
+void msock_server_set_wait_timeout(msock_server* server, int timeout_ms) {
+    msock_loop_set_wait_timeout(server->loop, timeout_ms);
+}
+
+void msock_server_set_cork(msock_server* server, bool enabled) {
+    msock_loop_set_cork(server->loop, enabled);
+}
+
+const msock_loop_stats* msock_server_get_loop_stats(msock_server* server) {
+    return msock_loop_get_stats(server->loop);
+}
+
+void msock_server_reset_loop_stats(msock_server* server) {
+    msock_loop_reset_stats(server->loop);
+}
+
+bool msock_server_broadcast(msock_server* server_socket, msock_message* broadcast_msg, msock_client* sender_socket) {
+
+    // Only slots in use are visited, an idle server doesn't touch every msock_client
+    for (int word = 0; word < MSOCK_CLIENT_SLOT_WORDS; word++) {
+        uint64_t bits = server_socket->active_slots[word];
+        while (bits) {
+            msock_client* client = &server_socket->connected_clients[word * 64 + msock_internal_ctz64(bits)];
+            bits &= bits - 1;
+
+            if (client->socket_state == MSOCK_STATE_DISCONNECTED) continue;
+            if (sender_socket != NULL && client == sender_socket) continue;
+
+            msock_client_send(client, broadcast_msg);
+        }
+    }
+
+    return true;
+}
+
+int msock_server_get_client_count(msock_server* server_socket) {
+    int count = 0;
+    for (int word = 0; word < MSOCK_CLIENT_SLOT_WORDS; word++) count += msock_internal_popcount64(server_socket->active_slots[word]);
+    return count;
+}
+
+void msock_server_set_connect_cb(msock_server* server_socket, msock_on_connect_cb cb) {
+    server_socket->connect_cb = cb;
+}
+
+void msock_server_set_disconnect_cb(msock_server* server_socket, msock_on_disconnect_cb cb) {
+    server_socket->disconnect_cb = cb;
+}
+
+void msock_server_set_client_cb(msock_server* server_socket, msock_on_client_cb cb) {
+    server_socket->client_cb = cb;
+}
+
+void msock_server_set_drain(msock_server* server_socket, msock_on_data_cb cb, size_t byte_budget, uint32_t read_budget) {
+    server_socket->data_cb = cb;
+    server_socket->drain_byte_budget = byte_budget > 0 ? byte_budget : MSOCK_DEFAULT_DRAIN_BYTE_BUDGET;
+    server_socket->drain_read_budget = read_budget > 0 ? read_budget : MSOCK_DEFAULT_DRAIN_READ_BUDGET;
+}
+
+//MSOCK_RATE_LIMIT Implementations
+
+// Adds what rate earned over elapsed_ms to a bucket in thousandths of a token, capped at burst
+static int64_t msock_internal_rate_fill(int64_t tokens, uint64_t rate, uint64_t burst, uint64_t elapsed_ms) {
+    int64_t cap = (int64_t)(burst * 1000);
+    if (tokens >= cap) return cap;
+
+    // Compared by division so a long idle client can't overflow the product
+    uint64_t missing = (uint64_t)(cap - tokens);
+    if (elapsed_ms >= missing / rate + 1) return cap;
+    return tokens + (int64_t)(rate * elapsed_ms);
+}
+
+static void msock_internal_rate_refill(msock_server* server, msock_client* client) {
+    msock_client_cold* cold = client->cold;
+    uint64_t elapsed = server->rate_clock_ms - cold->rate_refilled_ms;
+    if (elapsed == 0) return;
+
+    msock_rate_limit_config* config = &server->rate_limit;
+    if (config->bytes_per_sec) cold->rate_bytes = msock_internal_rate_fill(cold->rate_bytes, config->bytes_per_sec, config->bytes_burst, elapsed);
+    if (config->messages_per_sec) cold->rate_messages = msock_internal_rate_fill(cold->rate_messages, config->messages_per_sec, config->messages_burst, elapsed);
+    cold->rate_refilled_ms = server->rate_clock_ms;
+}
+
+static bool msock_internal_rate_has_tokens(msock_server* server, msock_client* client) {
+    msock_rate_limit_config* config = &server->rate_limit;
+    return (!config->bytes_per_sec || client->cold->rate_bytes > 0) && (!config->messages_per_sec || client->cold->rate_messages > 0);
+}
+
+// Takes what the client just read out of its buckets. Once one runs dry the client is not
+// read any more until the refill timer finds it positive again. Returns false then.
+static bool msock_internal_rate_charge(msock_server* server, msock_client* client, uint64_t bytes, uint64_t messages) {
+    msock_client_cold* cold = client->cold;
+    msock_rate_limit_config* config = &server->rate_limit;
+
+    msock_internal_rate_refill(server, client);
+    if (config->bytes_per_sec) cold->rate_bytes -= (int64_t)(bytes * 1000);
+    if (config->messages_per_sec) cold->rate_messages -= (int64_t)(messages * 1000);
+    if (msock_internal_rate_has_tokens(server, client)) return true;
+
+    client->flags |= MSOCK_CLIENT_FLAG_THROTTLED;
+    server->rate_stats.throttled++;
+    server->rate_stats.throttled_clients++;
+    if (client->loop) msock_internal_loop_update(client->loop, client->loop_slot);
+    return false;
+}
+
+// Called before each accept. Without tokens the listener leaves the loop, new connections
+// wait in the kernel's backlog and the refill timer puts it back.
+static bool msock_internal_rate_accept(msock_server* server) {
+    msock_rate_limit_config* config = &server->rate_limit;
+    if (!config->accepts_per_sec) return true;
+
+    uint64_t elapsed = server->rate_clock_ms - server->accept_refilled_ms;
+    if (elapsed > 0) {
+        server->accept_tokens = msock_internal_rate_fill(server->accept_tokens, config->accepts_per_sec, config->accepts_burst, elapsed);
+        server->accept_refilled_ms = server->rate_clock_ms;
+    }
+    if (server->accept_tokens > 0) return true;
+
+    msock_loop_remove_socket(server->loop, server->listener_slot);
+    server->listener_slot = -1;
+    server->accept_paused = true;
+    server->rate_stats.accept_pauses++;
+    return false;
+}
+
+static bool msock_internal_rate_timer(msock_loop* loop, void* userdata) {
+    msock_server* server = (msock_server*)userdata;
+    server->rate_clock_ms = (msock_loop_now_ns(loop) - server->rate_start_ns) / 1000000;
+
+    if (server->accept_paused) {
+        uint64_t elapsed = server->rate_clock_ms - server->accept_refilled_ms;
+        server->accept_tokens = msock_internal_rate_fill(server->accept_tokens, server->rate_limit.accepts_per_sec, server->rate_limit.accepts_burst, elapsed);
+        server->accept_refilled_ms = server->rate_clock_ms;
+
+        if (server->accept_tokens > 0 && msock_internal_server_add_listener(server)) server->accept_paused = false;
+    }
+
+    if (server->rate_stats.throttled_clients == 0) return true;
+
+    for (int word = 0; word < MSOCK_CLIENT_SLOT_WORDS; word++) {
+        uint64_t bits = server->active_slots[word];
+        while (bits) {
+            msock_client* client = &server->connected_clients[word * 64 + msock_internal_ctz64(bits)];
+            bits &= bits - 1;
+            if (!(client->flags & MSOCK_CLIENT_FLAG_THROTTLED)) continue;
+
+            msock_internal_rate_refill(server, client);
+            if (!msock_internal_rate_has_tokens(server, client)) continue;
+
+            client->flags &= ~MSOCK_CLIENT_FLAG_THROTTLED;
+            server->rate_stats.throttled_clients--;
+            if (!client->loop) continue;
+
+            msock_internal_loop_update(client->loop, client->loop_slot);
+            // Edge-triggered drain clients get no new edge for data that arrived while throttled
+            if (server->data_cb) msock_loop_requeue(client->loop, client);
+        }
+    }
+    return true;
+}
+
+// Limits how fast each connection is read and how fast new ones are accepted, NULL turns
+// the limits off. Runs a refill timer on the server's loop, call after msock_server_set_loop.
+void msock_server_set_rate_limit(msock_server* server_socket, const msock_rate_limit_config* config) {
+    if (server_socket->rate_timer_id) {
+        msock_loop_cancel_timer(server_socket->loop, server_socket->rate_timer_id);
+        server_socket->rate_timer_id = 0;
+    }
+
+    // Hand back everything the old limits held up
+    if (server_socket->accept_paused && server_socket->socket_state == MSOCK_STATE_LISTENING) {
+        if (msock_internal_server_add_listener(server_socket)) server_socket->accept_paused = false;
+    }
+    for (int i = 0; i < MSOCK_MAX_CLIENTS; i++) {
+        msock_client* client = &server_socket->connected_clients[i];
+        if (!(client->flags & MSOCK_CLIENT_FLAG_THROTTLED)) continue;
+
+        client->flags &= ~MSOCK_CLIENT_FLAG_THROTTLED;
+        if (client->loop) msock_internal_loop_update(client->loop, client->loop_slot);
+    }
+    server_socket->rate_stats.throttled_clients = 0;
+
+    server_socket->rate_limited = config != NULL;
+    if (!config) return;
+
+    msock_rate_limit_config* limit = &server_socket->rate_limit;
+    *limit = *config;
+    if (!limit->bytes_burst) limit->bytes_burst = limit->bytes_per_sec;
+    if (!limit->messages_burst) limit->messages_burst = limit->messages_per_sec;
+    if (!limit->accepts_burst) limit->accepts_burst = limit->accepts_per_sec;
+    if (!limit->refill_interval_ms) limit->refill_interval_ms = MSOCK_RATE_LIMIT_DEFAULT_REFILL_MS;
+
+    server_socket->rate_start_ns = msock_time_ns();
+    server_socket->rate_clock_ms = 0;
+    server_socket->accept_tokens = (int64_t)limit->accepts_burst * 1000;
+    server_socket->accept_refilled_ms = 0;
+
+    // Connections that are already open start with full buckets on the new clock
+    for (int i = 0; i < MSOCK_MAX_CLIENTS; i++) {
+        msock_client_cold* cold = server_socket->connected_clients[i].cold;
+        cold->rate_bytes = (int64_t)(limit->bytes_burst * 1000);
+        cold->rate_messages = (int64_t)limit->messages_burst * 1000;
+        cold->rate_refilled_ms = 0;
+    }
+
+    server_socket->rate_timer_id = msock_loop_add_timer(server_socket->loop, limit->refill_interval_ms, limit->refill_interval_ms,
+                                                        msock_internal_rate_timer, server_socket);
+}
+
+const msock_rate_limit_stats* msock_server_get_rate_limit_stats(msock_server* server_socket) {
+    return &server_socket->rate_stats;
+}
+
+
+static int msock_internal_client_slot(msock_server* server, msock_client* client) {
+    if (client < server->connected_clients || client >= server->connected_clients + MSOCK_MAX_CLIENTS) return -1;
+    return (int)(client - server->connected_clients);
+}
+
+static uint32_t msock_internal_topic_hash(uint32_t topic) {
+    return topic * 0x9e3779b1u; // Fibonacci hashing, the top bits pick the bucket
+}
+
+// Returns the topic entry, NULL if it doesn't exist and create is false or the table can't grow
+static msock_topic* msock_internal_topic_find(msock_server* server, uint32_t topic, bool create) {
+    if (create && (server->topic_count + 1) * 2 > server->topic_capacity) {
+        uint32_t capacity = server->topic_capacity ? server->topic_capacity * 2 : 16;
+        msock_topic* topics = (msock_topic*)calloc(capacity, sizeof(msock_topic));
+        if (!topics) {
+            printf("calloc() failed for %u topics\n", capacity);
+            return NULL;
+        }
+
+        for (uint32_t i = 0; i < server->topic_capacity; i++) {
+            msock_topic* old = &server->topics[i];
+            if (!old->used) continue;
+
+            uint32_t index = msock_internal_topic_hash(old->id) & (capacity - 1);
+            while (topics[index].used) index = (index + 1) & (capacity - 1);
+            topics[index] = *old;
+        }
+
+        free(server->topics);
+        server->topics = topics;
+        server->topic_capacity = capacity;
+    }
+
+    if (server->topic_capacity == 0) return NULL;
+
+    uint32_t mask = server->topic_capacity - 1;
+    uint32_t index = msock_internal_topic_hash(topic) & mask;
+    while (server->topics[index].used) {
+        if (server->topics[index].id == topic) return &server->topics[index];
+        index = (index + 1) & mask;
+    }
+    if (!create) return NULL;
+
+    // Topics are never removed, an empty one just keeps its bucket for the next subscriber
+    msock_topic* entry = &server->topics[index];
+    entry->used = true;
+    entry->id = topic;
+    server->topic_count++;
+    return entry;
+}
+
+bool msock_server_subscribe(msock_server* server_socket, msock_client* client, uint32_t topic) {
+    int slot = msock_internal_client_slot(server_socket, client);
+    if (slot < 0) return false;
+
+    msock_topic* entry = msock_internal_topic_find(server_socket, topic, true);
+    if (!entry) return false;
+
+    uint64_t bit = 1ull << (slot & 63);
+    if (!(entry->members[slot >> 6] & bit)) {
+        entry->members[slot >> 6] |= bit;
+        entry->subscriber_count++;
+    }
+    return true;
+}
+
+bool msock_server_unsubscribe(msock_server* server_socket, msock_client* client, uint32_t topic) {
+    int slot = msock_internal_client_slot(server_socket, client);
+    msock_topic* entry = msock_internal_topic_find(server_socket, topic, false);
+    if (slot < 0 || !entry) return false;
+
+    uint64_t bit = 1ull << (slot & 63);
+    if (!(entry->members[slot >> 6] & bit)) return false;
+
+    entry->members[slot >> 6] &= ~bit;
+    entry->subscriber_count--;
+    return true;
+}
+
+// Called when the client in slot disconnects, so a reused slot starts without subscriptions
+static void msock_internal_pubsub_drop(msock_server* server, int slot) {
+    uint64_t bit = 1ull << (slot & 63);
+
+    for (uint32_t i = 0; i < server->topic_capacity; i++) {
+        msock_topic* entry = &server->topics[i];
+        if (!entry->used || !(entry->members[slot >> 6] & bit)) continue;
+
+        entry->members[slot >> 6] &= ~bit;
+        entry->subscriber_count--;
+    }
+}
+
+bool msock_server_is_subscribed(msock_server* server_socket, msock_client* client, uint32_t topic) {
+    int slot = msock_internal_client_slot(server_socket, client);
+    msock_topic* entry = msock_internal_topic_find(server_socket, topic, false);
+    if (slot < 0 || !entry) return false;
+
+    return (entry->members[slot >> 6] >> (slot & 63)) & 1;
+}
+
+uint32_t msock_server_get_subscriber_count(msock_server* server_socket, uint32_t topic) {
+    msock_topic* entry = msock_internal_topic_find(server_socket, topic, false);
+    return entry ? entry->subscriber_count : 0;
+}
+
+// Queues buffer on every subscriber of topic except exclude (may be NULL). All of them
+// share the one buffer, the caller keeps its own reference. Returns how many accepted it.
+int msock_server_publish_buffer(msock_server* server_socket, uint32_t topic, msock_buffer* buffer, msock_client* exclude) {
+    msock_topic* entry = msock_internal_topic_find(server_socket, topic, false);
+    if (!entry || entry->subscriber_count == 0) return 0;
+
+    // A send below can drop a member, so walk a snapshot of the set
+    uint64_t members[MSOCK_CLIENT_SLOT_WORDS];
+    memcpy(members, entry->members, sizeof(members));
+
+    int exclude_slot = exclude ? msock_internal_client_slot(server_socket, exclude) : -1;
+    if (exclude_slot >= 0) members[exclude_slot >> 6] &= ~(1ull << (exclude_slot & 63));
+
+    int delivered = 0;
+    for (int word = 0; word < MSOCK_CLIENT_SLOT_WORDS; word++) {
+        uint64_t bits = members[word] & server_socket->active_slots[word];
+        while (bits) {
+            int slot = word * 64 + msock_internal_ctz64(bits);
+            bits &= bits - 1;
+
+            msock_client* client = &server_socket->connected_clients[slot];
+            if (client->socket_state == MSOCK_STATE_DISCONNECTED) continue;
+            if (msock_client_send_buffer(client, buffer)) delivered++;
+        }
+    }
+
+    return delivered;
+}
+
+// Copies data once into a pooled buffer shared by every subscriber, see msock_server_publish_buffer
+int msock_server_publish(msock_server* server_socket, uint32_t topic, const void* data, size_t len, msock_client* exclude) {
+    if (msock_server_get_subscriber_count(server_socket, topic) == 0) return 0;
+
+    msock_buffer* buffer = msock_buffer_acquire(len);
+    if (!buffer) return -1;
+
+    memcpy(buffer->data, data, len);
+    buffer->len = len;
+
+    int delivered = msock_server_publish_buffer(server_socket, topic, buffer, exclude);
+    msock_buffer_release(buffer);
+    return delivered;
+}
+
+//MSOCK_BALANCER Implementations
+
+static uint32_t msock_internal_hash32(uint32_t x) {
+    // murmur3 finalizer, spreads nearby addresses over the whole ring
+    x ^= x >> 16;
+    x *= 0x85ebca6bu;
+    x ^= x >> 13;
+    x *= 0xc2b2ae35u;
+    x ^= x >> 16;
+    return x;
+}
+
+static uint32_t msock_internal_balancer_random(msock_balancer* balancer) {
+    balancer->rng ^= balancer->rng << 13;
+    balancer->rng ^= balancer->rng >> 7;
+    balancer->rng ^= balancer->rng << 17;
+    return (uint32_t)balancer->rng;
+}
+
+static int msock_internal_ring_compare(const void* a, const void* b) {
+    uint32_t x = ((const msock_balancer_ring_node*)a)->hash;
+    uint32_t y = ((const msock_balancer_ring_node*)b)->hash;
+    return (x > y) - (x < y);
+}
+
+static void msock_internal_balancer_build_ring(msock_balancer* balancer) {
+    int count = 0;
+    for (int i = 0; i < balancer->upstream_count; i++) {
+        msock_upstream* upstream = &balancer->upstreams[i];
+        uint32_t key = (uint32_t)upstream->addr.sin_addr.s_addr ^ ((uint32_t)upstream->addr.sin_port << 16);
+
+        for (uint32_t v = 0; v < MSOCK_BALANCER_VNODES; v++) {
+            balancer->ring[count].hash = msock_internal_hash32(key ^ msock_internal_hash32(v + 1));
+            balancer->ring[count].upstream = (uint32_t)i;
+            count++;
+        }
+    }
+
+    qsort(balancer->ring, (size_t)count, sizeof(balancer->ring[0]), msock_internal_ring_compare);
+    balancer->ring_size = count;
+}
+
+// Returns the upstream index for client, or -1 when none is healthy. Without health probes
+// nothing else would ever bring an unhealthy upstream back, so once its retry time passed it
+// is a candidate again, and the relay it gets decides.
+static int msock_internal_balancer_pick(msock_balancer* balancer, msock_client* client) {
+    bool passive = balancer->config.health_interval_ms == 0;
+    uint64_t now = passive ? msock_time_ns() : 0;
+
+    int healthy[MSOCK_BALANCER_MAX_UPSTREAMS];
+    bool usable[MSOCK_BALANCER_MAX_UPSTREAMS];
+    int healthy_count = 0;
+    for (int i = 0; i < balancer->upstream_count; i++) {
+        msock_upstream* upstream = &balancer->upstreams[i];
+        usable[i] = upstream->healthy || (passive && now >= upstream->retry_at_ns);
+        if (usable[i]) healthy[healthy_count++] = i;
+    }
+    if (healthy_count == 0) return -1;
+
+    switch (balancer->config.policy) {
+    case MSOCK_BALANCE_ROUND_ROBIN:
+        return healthy[balancer->next_upstream++ % (uint32_t)healthy_count];
+
+    case MSOCK_BALANCE_LEAST_CONNECTIONS: {
+        // Ties rotate so an idle pool doesn't pile everything on the first upstream
+        int best = -1;
+        uint32_t start = balancer->next_upstream++;
+        for (int i = 0; i < healthy_count; i++) {
+            int candidate = healthy[(start + (uint32_t)i) % (uint32_t)healthy_count];
+            if (best < 0 || balancer->upstreams[candidate].active_connections < balancer->upstreams[best].active_connections) best = candidate;
+        }
+        return best;
+    }
+
+    case MSOCK_BALANCE_POWER_OF_TWO: {
+        int a = healthy[msock_internal_balancer_random(balancer) % (uint32_t)healthy_count];
+        int b = healthy[msock_internal_balancer_random(balancer) % (uint32_t)healthy_count];
+        return balancer->upstreams[b].active_connections < balancer->upstreams[a].active_connections ? b : a;
+    }
+
+    case MSOCK_BALANCE_CONSISTENT_HASH: {
+        // Keyed on the peer address only, so reconnects from the same host stick to one upstream
+        uint32_t hash = msock_internal_hash32((uint32_t)client->cold->peer_addr.sin_addr.s_addr);
+
+        int low = 0;
+        int high = balancer->ring_size;
+        while (low < high) {
+            int mid = (low + high) / 2;
+            if (balancer->ring[mid].hash < hash) low = mid + 1;
+            else high = mid;
+        }
+
+        // An unhealthy owner hands its share to the next upstreams on the ring
+        for (int i = 0; i < balancer->ring_size; i++) {
+            uint32_t index = balancer->ring[(low + i) % balancer->ring_size].upstream;
+            if (usable[index]) return (int)index;
+        }
+        return -1;
+    }
+    }
+
+    return -1;
+}
+
+static void msock_internal_balancer_report(msock_balancer* balancer, int index, bool success) {
+    msock_upstream* upstream = &balancer->upstreams[index];
+
+    if (success) {
+        upstream->consecutive_failures = 0;
+        if (!upstream->healthy && ++upstream->consecutive_successes >= balancer->config.healthy_threshold) {
+            upstream->healthy = true;
+            upstream->consecutive_successes = 0;
+        }
+        if (!upstream->healthy) upstream->retry_at_ns = 0; // Still short of healthy_threshold, next trial right away
+        return;
+    }
+
+    upstream->failures++;
+    upstream->consecutive_successes = 0;
+    if (upstream->healthy && ++upstream->consecutive_failures >= balancer->config.unhealthy_threshold) {
+        upstream->healthy = false;
+        upstream->consecutive_failures = 0;
+    }
+    if (!upstream->healthy) upstream->retry_at_ns = msock_time_ns() + (uint64_t)balancer->config.retry_interval_ms * 1000000;
+}
+
+// Relay bookkeeping, called when a relay stops using its upstream
+static void msock_internal_balancer_done(msock_relay* relay) {
+    msock_balancer* balancer = relay->server->balancer;
+    if (!balancer || relay->upstream_index < 0) return;
+
+    balancer->upstreams[relay->upstream_index].active_connections--;
+    relay->upstream_index = -1;
+}
+
+static bool msock_internal_balancer_relay_cb(msock_server* server, msock_client* client, struct sockaddr_in* upstream_addr) {
+    msock_balancer* balancer = server->balancer;
+
+    int index = msock_internal_balancer_pick(balancer, client);
+    if (index < 0) return false;
+
+    msock_upstream* upstream = &balancer->upstreams[index];
+    upstream->active_connections++;
+    upstream->total_connections++;
+
+    // One trial per retry interval, also when this one never reports back
+    if (!upstream->healthy) upstream->retry_at_ns = msock_time_ns() + (uint64_t)balancer->config.retry_interval_ms * 1000000;
+
+    server->relays[client - server->connected_clients].upstream_index = index;
+    *upstream_addr = upstream->addr;
+    return true;
+}
+
+static void msock_internal_balancer_probe_done(msock_client* probe, int error) {
+    msock_upstream* upstream = (msock_upstream*)msock_client_get_userdata(probe);
+    msock_balancer* balancer = upstream->balancer;
+
+    upstream->probing = false;
+    msock_client_close(probe);
+
+    msock_internal_balancer_report(balancer, (int)(upstream - balancer->upstreams), error == 0);
+}
+
+static bool msock_internal_balancer_probe_readable(msock_loop* loop, msock_client* client, void* ctx) {
+    (void)loop;
+    (void)client;
+    (void)ctx;
+    return true;
+}
+
+// Active health check: a plain TCP connect to every upstream, one in flight per upstream
+static bool msock_internal_balancer_health_timer(msock_loop* loop, void* userdata) {
+    msock_balancer* balancer = (msock_balancer*)userdata;
+
+    for (int i = 0; i < balancer->upstream_count; i++) {
+        msock_upstream* upstream = &balancer->upstreams[i];
+        if (upstream->probing || !msock_client_create(&upstream->probe)) continue;
+
+        msock_client_set_userdata(&upstream->probe, upstream);
+        upstream->probing = true;
+
+        if (!msock_client_connect_addr_async(&upstream->probe, &upstream->addr, (int)balancer->config.health_timeout_ms, msock_internal_balancer_probe_done)) {
+            // An immediate connect() error already went through msock_internal_balancer_probe_done
+            if (upstream->probing) {
+                upstream->probing = false;
+                msock_client_close(&upstream->probe);
+            }
+            continue;
+        }
+
+        msock_loop_handler handler = { 0 };
+        handler.on_readable = msock_internal_balancer_probe_readable;
+        if (!msock_loop_add_client(loop, &upstream->probe, &handler)) {
+            upstream->probing = false;
+            msock_client_close(&upstream->probe);
+        }
+    }
+
+    return true;
+}
+
+static void msock_internal_balancer_free(msock_server* server) {
+    msock_balancer* balancer = server->balancer;
+    if (!balancer) return;
+
+    if (balancer->health_timer_id) msock_loop_cancel_timer(server->loop, balancer->health_timer_id);
+    for (int i = 0; i < balancer->upstream_count; i++) {
+        if (balancer->upstreams[i].probing) msock_client_close(&balancer->upstreams[i].probe);
+    }
+
+    free(balancer);
+    server->balancer = NULL;
+}
+
+// Turns the server into a layer 4 load balancer: relay mode (see msock_server_set_relay)
+// with the upstream picked by config->policy among the upstreams added with
+// msock_server_add_upstream. Call after msock_server_set_loop, health checks run on that loop.
+bool msock_server_set_balancer(msock_server* server_socket, const msock_balancer_config* config, int connect_timeout_ms) {
+    if (!server_socket->balancer) {
+        server_socket->balancer = (msock_balancer*)calloc(1, sizeof(msock_balancer));
+        if (!server_socket->balancer) return false;
+    }
+
+    msock_balancer* balancer = server_socket->balancer;
+    if (balancer->health_timer_id) {
+        msock_loop_cancel_timer(server_socket->loop, balancer->health_timer_id);
+        balancer->health_timer_id = 0;
+    }
+
+    balancer->server = server_socket;
+    balancer->config = *config;
+    if (balancer->config.health_timeout_ms == 0) balancer->config.health_timeout_ms = MSOCK_BALANCER_DEFAULT_HEALTH_TIMEOUT_MS;
+    if (balancer->config.unhealthy_threshold == 0) balancer->config.unhealthy_threshold = 1;
+    if (balancer->config.healthy_threshold == 0) balancer->config.healthy_threshold = 1;
+    if (balancer->config.retry_interval_ms == 0) balancer->config.retry_interval_ms = MSOCK_BALANCER_DEFAULT_RETRY_MS;
+    balancer->rng = (msock_time_ns() ^ (uint64_t)(uintptr_t)balancer) | 1;
+
+    if (balancer->config.health_interval_ms > 0) {
+        balancer->health_timer_id = msock_loop_add_timer(server_socket->loop, balancer->config.health_interval_ms, balancer->config.health_interval_ms,
+                                                         msock_internal_balancer_health_timer, balancer);
+    }
+
+    return msock_server_set_relay(server_socket, msock_internal_balancer_relay_cb, connect_timeout_ms);
+}
+
+// Returns the upstream index, or -1 if the address doesn't resolve or the table is full.
+// Upstreams start healthy.
+int msock_server_add_upstream(msock_server* server_socket, const char* ip, const char* port) {
+    msock_balancer* balancer = server_socket->balancer;
+    if (!balancer) {
+        printf("msock_server_add_upstream() needs msock_server_set_balancer first\n");
+        return -1;
+    }
+    if (balancer->upstream_count == MSOCK_BALANCER_MAX_UPSTREAMS) {
+        printf("Too many upstreams, the limit is %d\n", MSOCK_BALANCER_MAX_UPSTREAMS);
+        return -1;
+    }
+
+    msock_upstream* upstream = &balancer->upstreams[balancer->upstream_count];
+    memset(upstream, 0, sizeof(*upstream));
+    if (!msock_internal_resolve(ip, port, &upstream->addr)) return -1;
+
+    upstream->balancer = balancer;
+    upstream->healthy = true;
+
+    balancer->upstream_count++;
+    msock_internal_balancer_build_ring(balancer);
+    return balancer->upstream_count - 1;
+}
+
+int msock_server_get_upstream_count(msock_server* server_socket) {
+    return server_socket->balancer ? server_socket->balancer->upstream_count : 0;
+}
+
+const msock_upstream* msock_server_get_upstream(msock_server* server_socket, int index) {
+    if (!server_socket->balancer || index < 0 || index >= server_socket->balancer->upstream_count) return NULL;
+    return &server_socket->balancer->upstreams[index];
+}
+
+//MSOCK_RELAY Implementations
+
+// Closes the upstream side and frees the splice pipes, the client side is left to the caller
+static void msock_internal_relay_release(msock_relay* relay) {
+    if (!relay->active) return;
+    relay->active = false;
+
+    if (relay->upstream_connected) {
+        // A side whose send direction was already shut down must not be shut down again
+        if (relay->to_upstream.eof) relay->upstream.socket_state = MSOCK_STATE_DISCONNECTED;
+        if (relay->to_client.eof) relay->client->socket_state = MSOCK_STATE_DISCONNECTED;
+
+        msock_splice_close(&relay->to_upstream);
+        msock_splice_close(&relay->to_client);
+    }
+    msock_client_close(&relay->upstream);
+    msock_internal_balancer_done(relay);
+}
+
+static void msock_internal_relay_finish(msock_relay* relay) {
+    msock_server* server = relay->server;
+    msock_client* client = relay->client;
+
+    msock_internal_relay_release(relay);
+
+    if (client->socket_state != MSOCK_STATE_DISCONNECTED || client->native_socket != INVALID_SOCKET) {
+        msock_internal_server_on_close(server->loop, client, server);
+    }
+}
+
+// Moves what is readable on one side to the other and sets up backpressure. Returns false
+// once the relay is done: an error, or both directions closed and fully forwarded.
+static bool msock_internal_relay_pump(msock_relay* relay, msock_splice* splice) {
+    msock_client* from = splice->from;
+    msock_client* to = splice->to;
+
+    ssize_t moved = msock_splice_forward(splice, MSOCK_DEFAULT_DRAIN_BYTE_BUDGET);
+    if (moved > 0) {
+        if (splice == &relay->to_upstream) relay->server->relay_stats.bytes_to_upstream += (uint64_t)moved;
+        else relay->server->relay_stats.bytes_to_client += (uint64_t)moved;
+    }
+
+    if (moved < 0 && !splice->eof) return false;
+
+    // Half-close once everything before the FIN went out: pass it on and keep the other
+    // direction flowing. The FIN can come with the last bytes of a read, so don't wait for
+    // an empty one that never comes.
+    if (splice->eof && splice->pipe_pending == 0 && !msock_client_has_pending_writes(to)) {
+        if (to->socket_state == MSOCK_STATE_CONNECTED) shutdown(to->native_socket, SD_SEND);
+        msock_client_pause_reading(from, true);
+        msock_client_want_writable(to, false);
+
+        return !(relay->to_upstream.eof && relay->to_client.eof);
+    }
+
+    // `to` is full: stop reading `from` until it drains
+    bool blocked = splice->pipe_pending > 0 || msock_client_has_pending_writes(to);
+    msock_client_pause_reading(from, blocked || splice->eof);
+    msock_client_want_writable(to, blocked);
+
+    return true;
+}
+
+static bool msock_internal_relay_client_readable(msock_loop* loop, msock_client* client, void* ctx) {
+    (void)loop;
+    (void)client;
+    msock_relay* relay = (msock_relay*)ctx;
+    if (!relay->upstream_connected) return true;
+
+    if (!msock_internal_relay_pump(relay, &relay->to_upstream)) msock_internal_relay_finish(relay);
+    return true;
+}
+
+static bool msock_internal_relay_upstream_readable(msock_loop* loop, msock_client* client, void* ctx) {
+    (void)loop;
+    (void)client;
+    msock_relay* relay = (msock_relay*)ctx;
+
+    if (!msock_internal_relay_pump(relay, &relay->to_client)) msock_internal_relay_finish(relay);
+    return true;
+}
+
+// Write readiness on one side continues the direction that writes into it
+static bool msock_internal_relay_client_writable(msock_loop* loop, msock_client* client, void* ctx) {
+    (void)client;
+    return msock_internal_relay_upstream_readable(loop, NULL, ctx);
+}
+
+static bool msock_internal_relay_upstream_writable(msock_loop* loop, msock_client* client, void* ctx) {
+    (void)client;
+    return msock_internal_relay_client_readable(loop, NULL, ctx);
+}
+
+static void msock_internal_relay_on_close(msock_loop* loop, msock_client* client, void* ctx) {
+    (void)loop;
+    (void)client;
+    msock_internal_relay_finish((msock_relay*)ctx);
+}
+
+static void msock_internal_relay_connected(msock_client* upstream, int error) {
+    msock_relay* relay = (msock_relay*)msock_client_get_userdata(upstream);
+
+    msock_balancer* balancer = relay->server->balancer;
+    if (balancer && relay->upstream_index >= 0) msock_internal_balancer_report(balancer, relay->upstream_index, error == 0);
+
+    if (error != 0 ||
+        !msock_splice_create(&relay->to_upstream, relay->client, upstream) ||
+        !msock_splice_create(&relay->to_client, upstream, relay->client)) {
+        relay->server->relay_stats.upstream_failures++;
+        msock_internal_relay_finish(relay);
+        return;
+    }
+
+    relay->upstream_connected = true;
+    msock_client_pause_reading(relay->client, false);
+}
+
+static void msock_internal_relay_start(msock_server* server, int slot) {
+    msock_client* client = &server->connected_clients[slot];
+    msock_relay* relay = &server->relays[slot];
+
+    memset(relay, 0, sizeof(*relay));
+    relay->server = server;
+    relay->client = client;
+    relay->upstream_index = -1;
+
+    struct sockaddr_in upstream_addr;
+    if (!server->relay_cb(server, client, &upstream_addr) || !msock_client_create(&relay->upstream)) {
+        msock_internal_balancer_done(relay);
+        server->relay_stats.upstream_failures++;
+        msock_internal_server_on_close(server->loop, client, server);
+        return;
+    }
+    relay->active = true;
+
+    msock_client_set_userdata(&relay->upstream, relay);
+    if (server->has_options) msock_client_set_options(&relay->upstream, &server->options);
+
+    // Nothing is read from the client until the upstream is there to take it
+    client->flags |= MSOCK_CLIENT_FLAG_READ_PAUSED;
+
+    msock_loop_handler handler = { 0 };
+    handler.on_readable = msock_internal_relay_client_readable;
+    handler.on_writable = msock_internal_relay_client_writable;
+    handler.on_close = msock_internal_relay_on_close;
+    handler.ctx = relay;
+
+    if (!msock_loop_add_client(server->loop, client, &handler)) {
+        msock_internal_relay_finish(relay);
+        return;
+    }
+
+    if (!msock_client_connect_addr_async(&relay->upstream, &upstream_addr, server->relay_connect_timeout_ms, msock_internal_relay_connected)) {
+        // An immediate connect() error already went through msock_internal_relay_connected
+        if (relay->active) {
+            server->relay_stats.upstream_failures++;
+            msock_internal_relay_finish(relay);
+        }
+        return;
+    }
+
+    handler.on_readable = msock_internal_relay_upstream_readable;
+    handler.on_writable = msock_internal_relay_upstream_writable;
+    if (!msock_loop_add_client(server->loop, &relay->upstream, &handler)) {
+        msock_internal_relay_finish(relay);
+        return;
+    }
+
+    server->relay_stats.relayed++;
+}
+
+// Turns the server into a TCP relay: every accepted client gets an upstream picked by cb,
+// and bytes are forwarded both ways with msock_splice. A full side stops reading from the
+// other one, and a FIN in one direction is passed on while the other keeps flowing.
+bool msock_server_set_relay(msock_server* server_socket, msock_on_relay_upstream_cb cb, int connect_timeout_ms) {
+    if (!server_socket->relays) {
+        server_socket->relays = (msock_relay*)calloc(MSOCK_MAX_CLIENTS, sizeof(msock_relay));
+        if (!server_socket->relays) return false;
+    }
+
+    server_socket->relay_cb = cb;
+    server_socket->relay_connect_timeout_ms = connect_timeout_ms;
+    return true;
+}
+
+const msock_relay_stats* msock_server_get_relay_stats(msock_server* server_socket) {
+    return &server_socket->relay_stats;
+}
+
+//MSOCK_SERVER_GROUP Implementations
+
+#ifdef _WIN32
+static DWORD WINAPI msock_internal_loop_thread(LPVOID arg) {
+#else
+static void* msock_internal_loop_thread(void* arg) {
+#endif
+    msock_server_loop* loop = (msock_server_loop*)arg;
+    msock_server_group* group = loop->group;
+
+    // Pin first so every allocation the loop makes from here on is node local
+    if (loop->cpu >= 0) msock_set_thread_affinity(loop->cpu);
+
+    msock_server* server = NULL;
+    if (group->config.numa_local) {
+        server = (msock_server*)msock_internal_alloc_local(sizeof(msock_server), loop->cpu);
+        loop->server_numa_local = server != NULL;
+    }
+    if (!server) server = (msock_server*)calloc(1, sizeof(msock_server));
+    loop->server = server;
+
+    if (!server || !msock_server_create(server)) {
+        loop->status = -1;
+        return 0;
+    }
+
+    // Lets the loop notice msock_server_group_stop without a wakeup socket
+    msock_server_set_wait_timeout(server, MSOCK_GROUP_STOP_POLL_MS);
+
+#ifdef SO_REUSEPORT
+    MSOCK_INTERNAL_SETOPT(server->native_socket, SOL_SOCKET, SO_REUSEPORT, 1);
+#endif
+#ifdef SO_INCOMING_CPU
+    if (group->config.steer_incoming_cpu && loop->cpu >= 0) {
+        MSOCK_INTERNAL_SETOPT(server->native_socket, SOL_SOCKET, SO_INCOMING_CPU, loop->cpu);
+    }
+#endif
+
+    bool ok = true;
+    if (group->config.setup_cb) ok = group->config.setup_cb(server, loop->index, group->config.userdata);
+    if (ok) ok = msock_server_listen(server, group->ip, group->port);
+
+    if (!ok) {
+        msock_server_close(server);
+        loop->status = -1;
+        return 0;
+    }
+
+    loop->status = 1;
+
+    while (group->running && msock_server_is_listening(server)) {
+        if (!msock_server_run(server)) break;
+    }
+
+    msock_server_close(server);
+    return 0;
+}
+
+bool msock_server_group_start(msock_server_group* group, const msock_server_group_config* config, const char* ip, const char* port) {
+    if (!group || !config || config->loop_count <= 0 || !ip || !port) return false;
+
+#ifndef SO_REUSEPORT
+    if (config->loop_count > 1) {
+        printf("msock_server_group: SO_REUSEPORT is not available, only one loop is supported\n");
+        return false;
+    }
+#endif
+
+    memset(group, 0, sizeof(*group));
+    group->config = *config;
+    snprintf(group->ip, sizeof(group->ip), "%s", ip);
+    snprintf(group->port, sizeof(group->port), "%s", port);
+    group->running = true;
+
+    group->loops = (msock_server_loop*)calloc((size_t)config->loop_count, sizeof(msock_server_loop));
+    if (!group->loops) return false;
+
+    int started = 0;
+    for (int i = 0; i < config->loop_count; i++) {
+        msock_server_loop* loop = &group->loops[i];
+        loop->group = group;
+        loop->index = i;
+        loop->cpu = config->cpus ? config->cpus[i] : -1;
+
+#ifdef _WIN32
+        loop->thread = CreateThread(NULL, 0, msock_internal_loop_thread, loop, 0, NULL);
+        bool created = loop->thread != NULL;
+#else
+        bool created = pthread_create(&loop->thread, NULL, msock_internal_loop_thread, loop) == 0;
+#endif
+        if (!created) {
+            printf("msock_server_group: failed to start loop %d\n", i);
+            loop->status = -1;
+            break;
+        }
+        started++;
+    }
+
+    bool success = started == config->loop_count;
+    for (int i = 0; i < started; i++) {
+        while (group->loops[i].status == 0) msock_internal_sleep_ms(1);
+        if (group->loops[i].status < 0) success = false;
+    }
+
+    if (!success) {
+        group->config.loop_count = started;
+        msock_server_group_stop(group);
+    }
+
+    return success;
+}
+
+void msock_server_group_stop(msock_server_group* group) {
+    if (!group->loops) return;
+
+    group->running = false;
+
+    for (int i = 0; i < group->config.loop_count; i++) {
+        msock_server_loop* loop = &group->loops[i];
+
+#ifdef _WIN32
+        WaitForSingleObject(loop->thread, INFINITE);
+        CloseHandle(loop->thread);
+#else
+        pthread_join(loop->thread, NULL);
+#endif
+
+        if (loop->server_numa_local) {
+            msock_internal_free_local(loop->server, sizeof(msock_server));
+        } else {
+            free(loop->server);
+        }
+    }
+
+    free(group->loops);
+    group->loops = NULL;
+}
+
+//MSOCK_FRAME Implementations
+
+static void msock_internal_store_u16le(char* out, uint16_t value) {
+    out[0] = (char)(value & 0xff);
+    out[1] = (char)(value >> 8);
+}
+
+static void msock_internal_store_u32le(char* out, uint32_t value) {
+    out[0] = (char)(value & 0xff);
+    out[1] = (char)((value >> 8) & 0xff);
+    out[2] = (char)((value >> 16) & 0xff);
+    out[3] = (char)(value >> 24);
+}
+
+static uint16_t msock_internal_load_u16le(const char* in) {
+    const uint8_t* b = (const uint8_t*)in;
+    return (uint16_t)(b[0] | (b[1] << 8));
+}
+
+static uint32_t msock_internal_load_u32le(const char* in) {
+    const uint8_t* b = (const uint8_t*)in;
+    return (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+// CRC32C (Castagnoli): the SSE4.2 crc32 instruction when the CPU has it, checked once at
+// runtime so builds without -msse4.2 still use it, else slicing-by-8 tables
+static uint32_t msock_internal_crc32c_table[8][256];
+static int msock_internal_crc32c_mode; // 0 = not chosen yet, 1 = table, 2 = hardware
+
+#ifdef MSOCK_CRC32C_SSE42
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((target("sse4.2")))
+#endif
+static uint32_t msock_internal_crc32c_hw(uint32_t crc, const char* data, size_t len) {
+    uint64_t value = crc;
+    for (; len >= 8; len -= 8, data += 8) {
+        uint64_t chunk;
+        memcpy(&chunk, data, 8);
+        value = _mm_crc32_u64(value, chunk);
+    }
+    crc = (uint32_t)value;
+    for (; len > 0; len--) crc = _mm_crc32_u8(crc, (uint8_t)*data++);
+    return crc;
+}
+
+static bool msock_internal_crc32c_hw_supported() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] >> 20) & 1;
+#else
+    return __builtin_cpu_supports("sse4.2");
+#endif
+}
+#elif defined(__ARM_FEATURE_CRC32)
+static uint32_t msock_internal_crc32c_hw(uint32_t crc, const char* data, size_t len) {
+    for (; len >= 8; len -= 8, data += 8) {
+        uint64_t chunk;
+        memcpy(&chunk, data, 8);
+        crc = __crc32cd(crc, chunk);
+    }
+    for (; len > 0; len--) crc = __crc32cb(crc, (uint8_t)*data++);
+    return crc;
+}
+
+static bool msock_internal_crc32c_hw_supported() {
+    return true;
+}
+#endif
+
+static uint32_t msock_internal_crc32c_sw(uint32_t crc, const char* data, size_t len) {
+    const uint32_t(*t)[256] = msock_internal_crc32c_table;
+    for (; len >= 8; len -= 8, data += 8) {
+        uint32_t low = crc ^ msock_internal_load_u32le(data);
+        uint32_t high = msock_internal_load_u32le(data + 4);
+        crc = t[7][low & 0xff] ^ t[6][(low >> 8) & 0xff] ^ t[5][(low >> 16) & 0xff] ^ t[4][low >> 24] ^ t[3][high & 0xff] ^ t[2][(high >> 8) & 0xff] ^
+              t[1][(high >> 16) & 0xff] ^ t[0][high >> 24];
+    }
+    for (; len > 0; len--) crc = t[0][(crc ^ (uint8_t)*data++) & 0xff] ^ (crc >> 8);
+    return crc;
+}
+
+static void msock_internal_crc32c_init() {
+#if defined(MSOCK_CRC32C_SSE42) || defined(__ARM_FEATURE_CRC32)
+    if (msock_internal_crc32c_hw_supported()) {
+        msock_internal_crc32c_mode = 2;
+        return;
+    }
+#endif
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ (0x82f63b78u & (0u - (crc & 1)));
+        msock_internal_crc32c_table[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int k = 1; k < 8; k++) {
+            uint32_t previous = msock_internal_crc32c_table[k - 1][i];
+            msock_internal_crc32c_table[k][i] = (previous >> 8) ^ msock_internal_crc32c_table[0][previous & 0xff];
+        }
+    }
+    msock_internal_crc32c_mode = 1;
+}
+
+// Chains like zlib's crc32: start with 0 and pass the previous result for the next piece
+uint32_t msock_crc32c(uint32_t crc, const void* data, size_t len) {
+    if (msock_internal_crc32c_mode == 0) msock_internal_crc32c_init();
+
+    crc = ~crc;
+#if defined(MSOCK_CRC32C_SSE42) || defined(__ARM_FEATURE_CRC32)
+    if (msock_internal_crc32c_mode == 2) return ~msock_internal_crc32c_hw(crc, (const char*)data, len);
+#endif
+    return ~msock_internal_crc32c_sw(crc, (const char*)data, len);
+}
+
+void msock_frame_write_header(char* out, const msock_frame_header* header) {
+    msock_internal_store_u32le(out, header->length);
+    msock_internal_store_u32le(out + 4, header->correlation_id);
+    msock_internal_store_u16le(out + 8, header->flags);
+    msock_internal_store_u16le(out + 10, header->transport);
+}
+
+void msock_frame_read_header(const char* in, msock_frame_header* header) {
+    header->length = msock_internal_load_u32le(in);
+    header->correlation_id = msock_internal_load_u32le(in + 4);
+    header->flags = msock_internal_load_u16le(in + 8);
+    header->transport = msock_internal_load_u16le(in + 10);
+}
+
+// Header and payload go out as one buffer, so one send and one queue node per frame
+bool msock_client_send_frame(msock_client* client_socket, uint32_t correlation_id, uint16_t flags, const char* payload, size_t len) {
+    if (len > MSOCK_FRAME_MAX_PAYLOAD) return false;
+
+    msock_buffer* buffer = msock_buffer_acquire(MSOCK_FRAME_HEADER_SIZE + len);
+    if (!buffer) return false;
+
+    msock_frame_header header = { (uint32_t)len, correlation_id, flags, 0 };
+    msock_frame_write_header(buffer->data, &header);
+    if (len > 0) memcpy(buffer->data + MSOCK_FRAME_HEADER_SIZE, payload, len);
+    buffer->len = MSOCK_FRAME_HEADER_SIZE + len;
+
+    bool success = msock_client_send_buffer(client_socket, buffer);
+    msock_buffer_release(buffer);
+    return success;
+}
+
+// Seals the complete frame in buffer with a CRC32C trailer, growing its length by 4 and
+// setting MSOCK_FRAME_TRANSPORT_CHECKSUM. Call right after writing it, while it's in cache.
+bool msock_frame_append_checksum(msock_buffer* buffer) {
+    if (buffer->len < MSOCK_FRAME_HEADER_SIZE || buffer->len + 4 > buffer->capacity) return false;
+
+    msock_frame_header header;
+    msock_frame_read_header(buffer->data, &header);
+    header.length += 4;
+    header.transport |= MSOCK_FRAME_TRANSPORT_CHECKSUM;
+    msock_frame_write_header(buffer->data, &header);
+
+    msock_internal_store_u32le(buffer->data + buffer->len, msock_crc32c(0, buffer->data, buffer->len));
+    buffer->len += 4;
+    return true;
+}
+
+// msock_client_send_frame with a CRC32C trailer, computed over the bytes just copied
+bool msock_client_send_frame_checked(msock_client* client_socket, uint32_t correlation_id, uint16_t flags, const char* payload, size_t len) {
+    if (len + 4 > MSOCK_FRAME_MAX_PAYLOAD) return false;
+
+    msock_buffer* buffer = msock_buffer_acquire(MSOCK_FRAME_HEADER_SIZE + len + 4);
+    if (!buffer) return false;
+
+    msock_frame_header header = { (uint32_t)len, correlation_id, flags, 0 };
+    msock_frame_write_header(buffer->data, &header);
+    if (len > 0) memcpy(buffer->data + MSOCK_FRAME_HEADER_SIZE, payload, len);
+    buffer->len = MSOCK_FRAME_HEADER_SIZE + len;
+    msock_frame_append_checksum(buffer);
+
+    bool success = msock_client_send_buffer(client_socket, buffer);
+    msock_buffer_release(buffer);
+    return success;
+}
+
+void msock_frame_reader_init(msock_frame_reader* reader) {
+    memset(reader, 0, sizeof(*reader));
+}
+
+void msock_frame_reader_free(msock_frame_reader* reader) {
+    free(reader->data);
+    memset(reader, 0, sizeof(*reader));
+}
+
+bool msock_frame_reader_feed(msock_frame_reader* reader, const char* data, size_t len) {
+    // Release the frame handed out last time, its payload pointer is invalid from here on
+    reader->start += reader->pending_consume;
+    reader->pending_consume = 0;
+
+    if (reader->start == reader->len) {
+        reader->start = reader->len = 0;
+    }
+
+    if (reader->len + len > reader->capacity) {
+        // Compact before growing
+        if (reader->start > 0) {
+            memmove(reader->data, reader->data + reader->start, reader->len - reader->start);
+            reader->len -= reader->start;
+            reader->start = 0;
+        }
+
+        if (reader->len + len > reader->capacity) {
+            size_t new_capacity = reader->capacity ? reader->capacity : 4096;
+            while (new_capacity < reader->len + len) new_capacity *= 2;
+
+            char* new_data = (char*)realloc(reader->data, new_capacity);
+            if (!new_data) return false;
+            reader->data = new_data;
+            reader->capacity = new_capacity;
+        }
+    }
+
+    memcpy(reader->data + reader->len, data, len);
+    reader->len += len;
+    return true;
+}
+
+// Returns 1 and points payload into the reader when a complete frame is buffered, 0 when
+// more bytes are needed, -1 on a malformed frame. payload stays valid until the next feed.
+// Checksummed frames come back with the trailer stripped; ones that fail the check are
+// counted and skipped, which suits datagrams fed one frame at a time.
+int msock_frame_reader_next(msock_frame_reader* reader, msock_frame_header* header, const char** payload) {
+    for (;;) {
+        reader->start += reader->pending_consume;
+        reader->pending_consume = 0;
+
+        size_t available = reader->len - reader->start;
+        if (available < MSOCK_FRAME_HEADER_SIZE) return 0;
+
+        const char* frame = reader->data + reader->start;
+        msock_frame_read_header(frame, header);
+        if (header->length > MSOCK_FRAME_MAX_PAYLOAD) return -1;
+        if (available < MSOCK_FRAME_HEADER_SIZE + (size_t)header->length) return 0;
+
+        *payload = frame + MSOCK_FRAME_HEADER_SIZE;
+        reader->pending_consume = MSOCK_FRAME_HEADER_SIZE + header->length;
+
+        if (!(header->transport & MSOCK_FRAME_TRANSPORT_CHECKSUM)) return 1;
+
+        if (header->length >= 4) {
+            size_t covered = MSOCK_FRAME_HEADER_SIZE + header->length - 4;
+            if (msock_crc32c(0, frame, covered) == msock_internal_load_u32le(frame + covered)) {
+                header->length -= 4;
+                header->transport &= (uint16_t)~MSOCK_FRAME_TRANSPORT_CHECKSUM;
+                return 1;
+            }
+        }
+        reader->checksum_failures++;
+    }
+}
+
+//MSOCK_COMPRESS Implementations
+
+#define MSOCK_INTERNAL_COMPRESS_MIN_MATCH 4
+#define MSOCK_INTERNAL_COMPRESS_LAST_LITERALS 5 // A block ends with at least this many literals
+#define MSOCK_INTERNAL_COMPRESS_MATCH_LIMIT 12  // No match starts closer than this to the end
+
+bool msock_compress_stream_init(msock_compress_stream* stream, bool compressor) {
+    memset(stream, 0, sizeof(*stream));
+
+    // Slack after the window lets the decoder copy in 8 byte steps past the end of a match
+    stream->window = (char*)malloc(2 * MSOCK_COMPRESS_WINDOW + 16);
+    if (!stream->window) return false;
+
+    if (compressor) {
+        stream->table = (int32_t*)malloc(sizeof(int32_t) << MSOCK_COMPRESS_HASH_BITS);
+        if (!stream->table) {
+            free(stream->window);
+            stream->window = NULL;
+            return false;
+        }
+        memset(stream->table, 0xff, sizeof(int32_t) << MSOCK_COMPRESS_HASH_BITS);
+    }
+    return true;
+}
+
+void msock_compress_stream_free(msock_compress_stream* stream) {
+    free(stream->window);
+    free(stream->table);
+    memset(stream, 0, sizeof(*stream));
+}
+
+size_t msock_compress_bound(size_t len) {
+    return len + len / 255 + 16;
+}
+
+// Makes room for a message of len bytes, keeping the last window of history. Depends on
+// nothing but message lengths, so both ends of a stream slide at the same points.
+static void msock_internal_compress_slide(msock_compress_stream* stream, size_t len) {
+    if (stream->pos + len <= 2 * MSOCK_COMPRESS_WINDOW) return;
+
+    size_t shift = stream->pos - MSOCK_COMPRESS_WINDOW;
+    memmove(stream->window, stream->window + shift, MSOCK_COMPRESS_WINDOW);
+    stream->pos = MSOCK_COMPRESS_WINDOW;
+
+    if (stream->table) {
+        for (size_t i = 0; i < ((size_t)1 << MSOCK_COMPRESS_HASH_BITS); i++) {
+            int32_t position = stream->table[i] - (int32_t)shift;
+            stream->table[i] = position < 0 ? -1 : position;
+        }
+    }
+}
+
+static uint32_t msock_internal_compress_read32(const char* p) {
+    uint32_t value;
+    memcpy(&value, p, 4);
+    return value;
+}
+
+static uint32_t msock_internal_compress_hash(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - MSOCK_COMPRESS_HASH_BITS);
+}
+
+// Length of the common prefix of a and b, not reading past limit on a
+static size_t msock_internal_compress_count(const char* a, const char* b, const char* limit) {
+    const char* start = a;
+    while (a + 8 <= limit) {
+        uint64_t x, y;
+        memcpy(&x, a, 8);
+        memcpy(&y, b, 8);
+        uint64_t diff = x ^ y;
+        if (diff) return (size_t)(a - start) + (size_t)(msock_internal_ctz64(diff) >> 3);
+        a += 8;
+        b += 8;
+    }
+    while (a < limit && *a == *b) {
+        a++;
+        b++;
+    }
+    return (size_t)(a - start);
+}
+
+static char* msock_internal_compress_length(char* out, size_t len) {
+    for (; len >= 255; len -= 255) *out++ = (char)255;
+    *out++ = (char)len;
+    return out;
+}
+
+// Token (literal length << 4 | match length - 4), extra length bytes, literals, u16 offset, extra match length bytes
+static char* msock_internal_compress_sequence(char* out, const char* literals, size_t literal_len, size_t offset, size_t match_len) {
+    char* token = out++;
+    *token = (char)((literal_len >= 15 ? 15 : literal_len) << 4);
+    if (literal_len >= 15) out = msock_internal_compress_length(out, literal_len - 15);
+    memcpy(out, literals, literal_len);
+    out += literal_len;
+
+    if (match_len == 0) return out; // Last sequence, literals only
+
+    *out++ = (char)(offset & 0xff);
+    *out++ = (char)(offset >> 8);
+
+    size_t extra = match_len - MSOCK_INTERNAL_COMPRESS_MIN_MATCH;
+    *token = (char)(*token | (extra >= 15 ? 15 : extra));
+    if (extra >= 15) out = msock_internal_compress_length(out, extra - 15);
+    return out;
+}
+
+// Compresses src into dst (msock_compress_bound(len) bytes), matching against the stream's
+// history too, and adds src to the history. Returns the compressed size, which can exceed
+// len for incompressible data; send src as is then and have the receiver append it. 0 when
+// len is over MSOCK_COMPRESS_WINDOW, nothing is recorded then.
+size_t msock_compress(msock_compress_stream* stream, const char* src, size_t len, char* dst) {
+    if (len == 0 || len > MSOCK_COMPRESS_WINDOW) return 0;
+
+    msock_internal_compress_slide(stream, len);
+    char* base = stream->window;
+    memcpy(base + stream->pos, src, len);
+
+    const char* ip = base + stream->pos;
+    const char* anchor = ip;
+    const char* end = ip + len;
+    const char* match_limit = end - MSOCK_INTERNAL_COMPRESS_LAST_LITERALS;
+    const char* search_limit = end - MSOCK_INTERNAL_COMPRESS_MATCH_LIMIT;
+    char* out = dst;
+
+    while (len >= MSOCK_INTERNAL_COMPRESS_MATCH_LIMIT && ip < search_limit) {
+        uint32_t sequence = msock_internal_compress_read32(ip);
+        uint32_t hash = msock_internal_compress_hash(sequence);
+        int32_t candidate = stream->table[hash];
+        int32_t position = (int32_t)(ip - base);
+        stream->table[hash] = position;
+
+        if (candidate < 0 || position - candidate > 65535 || msock_internal_compress_read32(base + candidate) != sequence) {
+            // Skip faster the longer nothing matched, incompressible data costs little
+            ip += 1 + ((size_t)(ip - anchor) >> 6);
+            continue;
+        }
+
+        const char* ref = base + candidate;
+        while (ip > anchor && ref > base && ip[-1] == ref[-1]) {
+            ip--;
+            ref--;
+        }
+
+        size_t match_len = MSOCK_INTERNAL_COMPRESS_MIN_MATCH + msock_internal_compress_count(ip + 4, ref + 4, match_limit);
+        out = msock_internal_compress_sequence(out, anchor, (size_t)(ip - anchor), (size_t)(ip - ref), match_len);
+        ip += match_len;
+        anchor = ip;
+
+        if (ip < search_limit) {
+            // Hash a position inside the match too, repeats often start there
+            const char* inside = ip - 2;
+            stream->table[msock_internal_compress_hash(msock_internal_compress_read32(inside))] = (int32_t)(inside - base);
+        }
+    }
+
+    out = msock_internal_compress_sequence(out, anchor, (size_t)(end - anchor), 0, 0);
+
+    stream->pos += len;
+    return (size_t)(out - dst);
+}
+
+// Records a message the other end compressed into its history but sent as is
+bool msock_compress_stream_append(msock_compress_stream* stream, const char* data, size_t len) {
+    if (len == 0 || len > MSOCK_COMPRESS_WINDOW) return false;
+
+    msock_internal_compress_slide(stream, len);
+    memcpy(stream->window + stream->pos, data, len);
+    stream->pos += len;
+    return true;
+}
+
+// Decodes a block made by msock_compress on the other end into the stream's window.
+// Returns the original_len bytes, valid until the next call, or NULL on a corrupt block;
+// the stream can't be used after that.
+const char* msock_decompress(msock_compress_stream* stream, const char* src, size_t len, size_t original_len) {
+    if (original_len == 0 || original_len > MSOCK_COMPRESS_WINDOW) return NULL;
+
+    msock_internal_compress_slide(stream, original_len);
+    char* base = stream->window;
+    char* op = base + stream->pos;
+    char* out_end = op + original_len;
+    const uint8_t* ip = (const uint8_t*)src;
+    const uint8_t* in_end = ip + len;
+
+    for (;;) {
+        if (ip >= in_end) return NULL;
+        unsigned token = *ip++;
+
+        size_t literal_len = token >> 4;
+        if (literal_len == 15) {
+            uint8_t extra;
+            do {
+                if (ip >= in_end) return NULL;
+                extra = *ip++;
+                literal_len += extra;
+            } while (extra == 255);
+        }
+        if (literal_len > (size_t)(in_end - ip) || literal_len > (size_t)(out_end - op)) return NULL;
+        memcpy(op, ip, literal_len);
+        op += literal_len;
+        ip += literal_len;
+
+        if (ip == in_end) break;
+
+        if (in_end - ip < 2) return NULL;
+        size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - base)) return NULL;
+
+        size_t match_len = token & 15;
+        if (match_len == 15) {
+            uint8_t extra;
+            do {
+                if (ip >= in_end) return NULL;
+                extra = *ip++;
+                match_len += extra;
+            } while (extra == 255);
+        }
+        match_len += MSOCK_INTERNAL_COMPRESS_MIN_MATCH;
+        if (match_len > (size_t)(out_end - op)) return NULL;
+
+        const char* match = op - offset;
+        if (offset >= 8) {
+            // Each 8 byte step reads only bytes written before it, may run into the slack
+            for (size_t i = 0; i < match_len; i += 8) memcpy(op + i, match + i, 8);
+        } else {
+            for (size_t i = 0; i < match_len; i++) op[i] = match[i];
+        }
+        op += match_len;
+    }
+
+    if (op != out_end) return NULL;
+
+    const char* result = base + stream->pos;
+    stream->pos += original_len;
+    return result;
+}
+
+// threshold 0 = MSOCK_COMPRESS_DEFAULT_THRESHOLD. The history windows are only allocated
+// once the peer agreed.
+void msock_frame_compression_init(msock_frame_compression* compression, size_t threshold) {
+    memset(compression, 0, sizeof(*compression));
+    compression->threshold = threshold ? threshold : MSOCK_COMPRESS_DEFAULT_THRESHOLD;
+}
+
+void msock_frame_compression_free(msock_frame_compression* compression) {
+    msock_compress_stream_free(&compression->tx);
+    msock_compress_stream_free(&compression->rx);
+    compression->enabled = false;
+    compression->offered = false;
+}
+
+static bool msock_internal_frame_send_hello(msock_frame_compression* compression, msock_client* client_socket) {
+    msock_buffer* buffer = msock_buffer_acquire(MSOCK_FRAME_HEADER_SIZE + 1);
+    if (!buffer) return false;
+
+    msock_frame_header header = { 1, 0, 0, MSOCK_FRAME_TRANSPORT_HELLO };
+    msock_frame_write_header(buffer->data, &header);
+    buffer->data[MSOCK_FRAME_HEADER_SIZE] = MSOCK_FRAME_FEATURE_COMPRESSION;
+    buffer->len = MSOCK_FRAME_HEADER_SIZE + 1;
+
+    compression->offered = true;
+    bool success = msock_client_send_buffer(client_socket, buffer);
+    msock_buffer_release(buffer);
+    return success;
+}
+
+// Asks the peer to compress. Frames go out uncompressed until its HELLO came back
+// through msock_frame_compression_receive. Only offer to peers that handle HELLO frames.
+bool msock_frame_compression_offer(msock_frame_compression* compression, msock_client* client_socket) {
+    if (compression->offered) return true;
+    return msock_internal_frame_send_hello(compression, client_socket);
+}
+
+// Sends like msock_client_send_frame, compressed when it was negotiated and pays off
+bool msock_client_send_frame_compressed(msock_client* client_socket, msock_frame_compression* compression, uint32_t correlation_id, uint16_t flags, const char* payload, size_t len) {
+    if (!compression->enabled || len < compression->threshold || len > MSOCK_COMPRESS_WINDOW) {
+        compression->stats.frames_uncompressed++;
+        if (compression->checksum) return msock_client_send_frame_checked(client_socket, correlation_id, flags, payload, len);
+        return msock_client_send_frame(client_socket, correlation_id, flags, payload, len);
+    }
+
+    // Compressed straight into the buffer that gets queued, with room for a checksum
+    msock_buffer* buffer = msock_buffer_acquire(MSOCK_FRAME_HEADER_SIZE + 4 + msock_compress_bound(len) + 4);
+    if (!buffer) return false;
+
+    size_t compressed = msock_compress(&compression->tx, payload, len, buffer->data + MSOCK_FRAME_HEADER_SIZE + 4);
+    if (4 + compressed < len) {
+        msock_frame_header header = { (uint32_t)(4 + compressed), correlation_id, flags, MSOCK_FRAME_TRANSPORT_COMPRESSED };
+        msock_frame_write_header(buffer->data, &header);
+        msock_internal_store_u32le(buffer->data + MSOCK_FRAME_HEADER_SIZE, (uint32_t)len);
+        buffer->len = MSOCK_FRAME_HEADER_SIZE + 4 + compressed;
+
+        compression->stats.frames_compressed++;
+        compression->stats.bytes_before += len;
+        compression->stats.bytes_after += 4 + compressed;
+    } else {
+        // Didn't shrink, but later messages can still match against it
+        msock_frame_header header = { (uint32_t)len, correlation_id, flags, MSOCK_FRAME_TRANSPORT_STORED };
+        msock_frame_write_header(buffer->data, &header);
+        memcpy(buffer->data + MSOCK_FRAME_HEADER_SIZE, payload, len);
+        buffer->len = MSOCK_FRAME_HEADER_SIZE + len;
+
+        compression->stats.frames_stored++;
+    }
+    if (compression->checksum) msock_frame_append_checksum(buffer);
+
+    bool success = msock_client_send_buffer(client_socket, buffer);
+    msock_buffer_release(buffer);
+    return success;
+}
+
+// Call on every frame from msock_frame_reader_next. Returns 1 for an application frame,
+// with payload and header->length swapped for the decompressed data when needed (valid
+// until the next call), 0 for a negotiation frame handled here, -1 when the frame is
+// corrupt and the connection has to be dropped.
+int msock_frame_compression_receive(msock_frame_compression* compression, msock_client* client_socket, msock_frame_header* header, const char** payload) {
+    if (header->transport & MSOCK_FRAME_TRANSPORT_HELLO) {
+        bool wanted = header->length >= 1 && ((*payload)[0] & MSOCK_FRAME_FEATURE_COMPRESSION);
+        if (!wanted || compression->enabled) return 0;
+
+        if (!msock_compress_stream_init(&compression->tx, true) || !msock_compress_stream_init(&compression->rx, false)) {
+            printf("malloc() failed for compression windows\n");
+            msock_frame_compression_free(compression);
+            return -1;
+        }
+
+        // Answer an offer we didn't make ourselves; the peer enables once this arrives
+        if (!compression->offered && !msock_internal_frame_send_hello(compression, client_socket)) return -1;
+        compression->enabled = true;
+        return 0;
+    }
+
+    if (header->transport & MSOCK_FRAME_TRANSPORT_STORED) {
+        if (!compression->enabled || !msock_compress_stream_append(&compression->rx, *payload, header->length)) {
+            compression->stats.decompress_errors++;
+            return -1;
+        }
+        header->transport &= (uint16_t)~MSOCK_FRAME_TRANSPORT_STORED;
+        return 1;
+    }
+
+    if (!(header->transport & MSOCK_FRAME_TRANSPORT_COMPRESSED)) return 1;
+
+    const char* data = NULL;
+    if (compression->enabled && header->length > 4) {
+        uint32_t original_len = msock_internal_load_u32le(*payload);
+        data = msock_decompress(&compression->rx, *payload + 4, header->length - 4, original_len);
+        if (data) header->length = original_len;
+    }
+    if (!data) {
+        compression->stats.decompress_errors++;
+        return -1;
+    }
+
+    compression->stats.frames_decompressed++;
+    header->transport &= (uint16_t)~MSOCK_FRAME_TRANSPORT_COMPRESSED;
+    *payload = data;
+    return 1;
+}
+
+//MSOCK_PIPELINE Implementations
+
+bool msock_pipeline_create(msock_pipeline* pipeline_result, msock_client* client, uint32_t window) {
+    memset(pipeline_result, 0, sizeof(*pipeline_result));
+    if (window == 0) window = 1;
+
+    pipeline_result->requests = (msock_pipeline_request*)calloc(window, sizeof(msock_pipeline_request));
+    if (!pipeline_result->requests) return false;
+
+    pipeline_result->client = client;
+    pipeline_result->window = window;
+    pipeline_result->next_id = 1;
+    msock_frame_reader_init(&pipeline_result->reader);
+
+    return true;
+}
+
+static void msock_internal_pipeline_fail_all(msock_pipeline* pipeline, int error) {
+    for (uint32_t i = 0; i < pipeline->window; i++) {
+        msock_pipeline_request* request = &pipeline->requests[i];
+        if (!request->in_use) continue;
+
+        request->in_use = false;
+        pipeline->in_flight--;
+        if (request->cb) request->cb(pipeline, request->correlation_id, NULL, 0, error, request->userdata);
+    }
+}
+
+// Fails everything still in flight, the client itself is left open
+void msock_pipeline_close(msock_pipeline* pipeline) {
+    msock_internal_pipeline_fail_all(pipeline, MSOCK_ECANCELED);
+
+    free(pipeline->requests);
+    pipeline->requests = NULL;
+    pipeline->window = 0;
+    msock_frame_reader_free(&pipeline->reader);
+}
+
+bool msock_pipeline_can_send(msock_pipeline* pipeline) {
+    if (pipeline->in_flight >= pipeline->window) return false;
+
+    // A slow response still holding the slot blocks ids that wrap onto it
+    return !pipeline->requests[pipeline->next_id % pipeline->window].in_use;
+}
+
+// Writes payload as a frame tagged with the next correlation id. Returns false when the
+// window is full or the send failed, cb is only kept when this returns true.
+bool msock_pipeline_send(msock_pipeline* pipeline, const char* payload, size_t len, msock_on_response_cb cb, void* userdata) {
+    if (!msock_pipeline_can_send(pipeline)) return false;
+
+    uint32_t id = pipeline->next_id;
+    if (!msock_client_send_frame(pipeline->client, id, 0, payload, len)) return false;
+
+    pipeline->next_id++;
+    if (pipeline->next_id == 0) pipeline->next_id = 1; // 0 is never a valid id
+
+    msock_pipeline_request* request = &pipeline->requests[id % pipeline->window];
+    request->correlation_id = id;
+    request->in_use = true;
+    request->cb = cb;
+    request->userdata = userdata;
+
+    pipeline->in_flight++;
+    if (pipeline->in_flight > pipeline->stats.max_in_flight) pipeline->stats.max_in_flight = pipeline->in_flight;
+    pipeline->stats.requests_sent++;
+
+    return true;
+}
+
+// Feeds bytes read from the connection and completes every response they finish.
+// Returns false on a malformed frame.
+bool msock_pipeline_process(msock_pipeline* pipeline, const char* data, size_t len) {
+    if (!msock_frame_reader_feed(&pipeline->reader, data, len)) return false;
+
+    msock_frame_header header;
+    const char* payload = NULL;
+    int result;
+
+    while ((result = msock_frame_reader_next(&pipeline->reader, &header, &payload)) == 1) {
+        msock_pipeline_request* request = &pipeline->requests[header.correlation_id % pipeline->window];
+        if (!request->in_use || request->correlation_id != header.correlation_id) {
+            pipeline->stats.unmatched_responses++;
+            continue;
+        }
+
+        request->in_use = false;
+        pipeline->in_flight--;
+        pipeline->stats.responses_received++;
+
+        if (request->cb) request->cb(pipeline, header.correlation_id, payload, header.length, 0, request->userdata);
+    }
+
+    return result == 0;
+}
+
+// msock_on_readable_cb for a msock_loop, ctx is the pipeline. Also usable directly on a
+// blocking client, in which case it waits for one read.
+bool msock_pipeline_on_readable(msock_loop* loop, msock_client* client, void* ctx) {
+    msock_pipeline* pipeline = (msock_pipeline*)ctx;
+
+    char stack_buffer[4096];
+    msock_message msg = { .buffer = stack_buffer, .size = sizeof(stack_buffer), .len = 0 };
+    if (loop) {
+        msg.buffer = loop->read_buffer;
+        msg.size = sizeof(loop->read_buffer);
+    }
+
+    ssize_t received = msock_client_receive(client, &msg);
+    if (received > 0) {
+        if (msock_pipeline_process(pipeline, msg.buffer, (size_t)received)) return true;
+        received = -1;
+    }
+
+    if (received == 0 && client->socket_state == MSOCK_STATE_CONNECTED) return true;
+
+    msock_internal_pipeline_fail_all(pipeline, MSOCK_ECONNRESET);
+    return false;
+}
+
+//MSOCK_POOL Implementations
+
+bool msock_pool_create(msock_pool* pool_result, const msock_pool_config* config) {
+    memset(pool_result, 0, sizeof(*pool_result));
+    if (config) pool_result->config = *config;
+
+    if (pool_result->config.max_idle_per_key <= 0) pool_result->config.max_idle_per_key = 8;
+    if (pool_result->config.min_idle_per_key > pool_result->config.max_idle_per_key) {
+        pool_result->config.min_idle_per_key = pool_result->config.max_idle_per_key;
+    }
+
+    // Keep a copy, the caller's options may not outlive the pool
+    if (pool_result->config.options) {
+        pool_result->options = *pool_result->config.options;
+        pool_result->has_options = true;
+    }
+    pool_result->config.options = NULL;
+
+    return true;
+}
+
+static void msock_internal_pool_destroy_conn(msock_pool_conn* conn) {
+    msock_client_close(&conn->client);
+    free(conn);
+}
+
+void msock_pool_close(msock_pool* pool) {
+    for (int k = 0; k < pool->key_count; k++) {
+        msock_pool_key* key = &pool->keys[k];
+        for (int i = 0; i < key->idle_count; i++) msock_internal_pool_destroy_conn(key->idle[i]);
+        free(key->idle);
+    }
+
+    free(pool->keys);
+    pool->keys = NULL;
+    pool->key_count = pool->key_capacity = 0;
+}
+
+static int msock_internal_pool_find_key(msock_pool* pool, const char* host, const char* port, bool create) {
+    for (int k = 0; k < pool->key_count; k++) {
+        if (strcmp(pool->keys[k].host, host) == 0 && strcmp(pool->keys[k].port, port) == 0) return k;
+    }
+    if (!create) return -1;
+
+    if (pool->key_count == pool->key_capacity) {
+        int new_capacity = pool->key_capacity ? pool->key_capacity * 2 : 8;
+        msock_pool_key* keys = (msock_pool_key*)realloc(pool->keys, sizeof(msock_pool_key) * (size_t)new_capacity);
+        if (!keys) return -1;
+        pool->keys = keys;
+        pool->key_capacity = new_capacity;
+    }
+
+    msock_pool_key* key = &pool->keys[pool->key_count];
+    memset(key, 0, sizeof(*key));
+    snprintf(key->host, sizeof(key->host), "%s", host);
+    snprintf(key->port, sizeof(key->port), "%s", port);
+
+    key->idle = (msock_pool_conn**)calloc((size_t)pool->config.max_idle_per_key, sizeof(msock_pool_conn*));
+    if (!key->idle) return -1;
+
+    return pool->key_count++;
+}
+
+static bool msock_internal_pool_resolve(msock_pool_key* key) {
+    if (key->resolved) return true;
+    key->resolved = msock_internal_resolve(key->host, key->port, &key->addr);
+    return key->resolved;
+}
+
+static msock_pool_conn* msock_internal_pool_new_conn(msock_pool* pool, int key_index) {
+    msock_pool_conn* conn = (msock_pool_conn*)calloc(1, sizeof(msock_pool_conn));
+    if (!conn) return NULL;
+
+    if (!msock_client_create(&conn->client)) {
+        free(conn);
+        return NULL;
+    }
+    if (pool->has_options) msock_client_set_options(&conn->client, &pool->options);
+
+    conn->key = key_index;
+    return conn;
+}
+
+// An idle connection should have nothing to read: readable means EOF, a reset or stray bytes
+static bool msock_internal_pool_is_alive(msock_pool_conn* conn) {
+    if (conn->client.socket_state != MSOCK_STATE_CONNECTED) return false;
+
+    struct pollfd pfd = { 0 };
+    pfd.fd = conn->client.native_socket;
+    pfd.events = POLLIN;
+
+    int activity = msock_poll(&pfd, 1, 0);
+    return activity == 0;
+}
+
+static void msock_internal_pool_expire_key(msock_pool* pool, msock_pool_key* key, uint64_t now) {
+    if (pool->config.idle_timeout_ms == 0) return;
+    uint64_t max_idle_ns = (uint64_t)pool->config.idle_timeout_ms * 1000000ull;
+
+    // Oldest connections sit at the bottom of the stack
+    int expired = 0;
+    while (expired < key->idle_count && now - key->idle[expired]->idle_since_ns > max_idle_ns) {
+        msock_internal_pool_destroy_conn(key->idle[expired]);
+        pool->stats.evicted_idle++;
+        expired++;
+    }
+
+    if (expired > 0) {
+        memmove(key->idle, key->idle + expired, sizeof(msock_pool_conn*) * (size_t)(key->idle_count - expired));
+        key->idle_count -= expired;
+    }
+}
+
+// Returns a connected, blocking client for host:port or NULL. Hand it back with msock_pool_checkin.
+msock_client* msock_pool_checkout(msock_pool* pool, const char* host, const char* port) {
+    int key_index = msock_internal_pool_find_key(pool, host, port, true);
+    if (key_index < 0) return NULL;
+    msock_pool_key* key = &pool->keys[key_index];
+
+    if (pool->config.max_active_per_key > 0 && key->active_count >= pool->config.max_active_per_key) {
+        pool->stats.rejected++;
+        return NULL;
+    }
+
+    pool->stats.checkouts++;
+    msock_internal_pool_expire_key(pool, key, msock_time_ns());
+
+    while (key->idle_count > 0) {
+        msock_pool_conn* conn = key->idle[--key->idle_count];
+        if (msock_internal_pool_is_alive(conn)) {
+            key->active_count++;
+            pool->stats.reused++;
+            return &conn->client;
+        }
+
+        msock_internal_pool_destroy_conn(conn);
+        pool->stats.evicted_dead++;
+    }
+
+    if (!msock_internal_pool_resolve(key)) {
+        pool->stats.connect_failures++;
+        return NULL;
+    }
+
+    msock_pool_conn* conn = msock_internal_pool_new_conn(pool, key_index);
+    if (!conn) return NULL;
+
+    if (!msock_client_connect_addr(&conn->client, &key->addr)) {
+        msock_internal_pool_destroy_conn(conn);
+        pool->stats.connect_failures++;
+        // The backend may have moved, resolve again next time
+        key->resolved = false;
+        msock_resolver_invalidate(key->host, key->port);
+        return NULL;
+    }
+
+    key->active_count++;
+    pool->stats.connected++;
+    return &conn->client;
+}
+
+// Returns a client from msock_pool_checkout. Pass reusable = false after protocol errors
+// or when the response wasn't fully read, the connection is closed instead of kept.
+void msock_pool_checkin(msock_pool* pool, msock_client* client, bool reusable) {
+    msock_pool_conn* conn = (msock_pool_conn*)client;
+    msock_pool_key* key = &pool->keys[conn->key];
+    key->active_count--;
+
+    if (client->loop) msock_loop_remove_client(client->loop, client);
+
+    if (!reusable || client->socket_state != MSOCK_STATE_CONNECTED || client->write_head ||
+        key->idle_count >= pool->config.max_idle_per_key) {
+        msock_internal_pool_destroy_conn(conn);
+        return;
+    }
+
+    msock_set_blocking(client->native_socket);
+    conn->idle_since_ns = msock_time_ns();
+    key->idle[key->idle_count++] = conn;
+}
+
+static void msock_internal_pool_prewarm_done(msock_client* client, int error) {
+    (void)client;
+    (void)error;
+}
+
+// Opens connections in parallel until host:port has min_idle_per_key idle ones.
+// Returns the number of idle connections afterwards.
+int msock_pool_prewarm(msock_pool* pool, const char* host, const char* port) {
+    int key_index = msock_internal_pool_find_key(pool, host, port, true);
+    if (key_index < 0) return 0;
+
+    msock_pool_key* key = &pool->keys[key_index];
+    int missing = pool->config.min_idle_per_key - key->idle_count;
+    if (missing <= 0) return key->idle_count;
+
+    if (!msock_internal_pool_resolve(key)) return key->idle_count;
+
+    msock_pool_conn** conns = (msock_pool_conn**)calloc((size_t)missing, sizeof(msock_pool_conn*));
+    msock_client** clients = (msock_client**)calloc((size_t)missing, sizeof(msock_client*));
+    if (!conns || !clients) {
+        free(conns);
+        free(clients);
+        return key->idle_count;
+    }
+
+    int started = 0;
+    for (int i = 0; i < missing; i++) {
+        msock_pool_conn* conn = msock_internal_pool_new_conn(pool, key_index);
+        if (!conn) break;
+
+        if (!msock_client_connect_addr_async(&conn->client, &key->addr, pool->config.connect_timeout_ms, msock_internal_pool_prewarm_done)) {
+            msock_internal_pool_destroy_conn(conn);
+            pool->stats.connect_failures++;
+            continue;
+        }
+
+        conns[started] = conn;
+        clients[started] = &conn->client;
+        started++;
+    }
+
+    // All handshakes run concurrently
+    while (msock_client_poll_connects(clients, started, -1) > 0) {}
+
+    uint64_t now = msock_time_ns();
+    for (int i = 0; i < started; i++) {
+        msock_pool_conn* conn = conns[i];
+        if (conn->client.socket_state != MSOCK_STATE_CONNECTED || key->idle_count >= pool->config.max_idle_per_key) {
+            if (conn->client.socket_state != MSOCK_STATE_CONNECTED) pool->stats.connect_failures++;
+            msock_internal_pool_destroy_conn(conn);
+            continue;
+        }
+
+        msock_set_blocking(conn->client.native_socket);
+        conn->idle_since_ns = now;
+        key->idle[key->idle_count++] = conn;
+        pool->stats.connected++;
+    }
+
+    free(conns);
+    free(clients);
+    return key->idle_count;
+}
+
+// Closes idle connections older than idle_timeout_ms, e.g. from a msock_loop timer
+void msock_pool_expire_idle(msock_pool* pool) {
+    uint64_t now = msock_time_ns();
+    for (int k = 0; k < pool->key_count; k++) {
+        msock_internal_pool_expire_key(pool, &pool->keys[k], now);
+    }
+}
+
+const msock_pool_stats* msock_pool_get_stats(msock_pool* pool) {
+    return &pool->stats;
 }
 
 #endif //MSOCK_IMPLEMTATION
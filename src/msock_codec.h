@@ -0,0 +1,289 @@
+#ifndef MSOCK_CODEC_H
+#define MSOCK_CODEC_H
+
+// Schema driven binary messages. A schema is an X-macro listing (type, field) pairs:
+//
+//     #define TELEMETRY_FIELDS(X) X(u32, sensor_id) X(svarint, delta) X(f64, value) X(bytes, unit)
+//     MSOCK_SCHEMA(telemetry, TELEMETRY_FIELDS)
+//
+// which generates the struct `telemetry` plus
+//
+//     size_t telemetry_size(const telemetry* msg);             // Exact encoded size
+//     size_t telemetry_encode(const telemetry* msg, char* out); // Returns bytes written
+//     bool telemetry_read(telemetry* msg, const char* payload, size_t len);
+//     msock_buffer* telemetry_frame(uint32_t correlation_id, uint16_t flags, const telemetry* msg);
+//     bool telemetry_send(msock_client* client, uint32_t correlation_id, uint16_t flags, const telemetry* msg);
+//
+// Fields go on the wire in schema order with no padding: fixed width integers and floats
+// little-endian, varint/svarint as LEB128 (svarint zigzag encoded), bytes as a varint length
+// followed by the data. _read accepts trailing bytes, so a schema can grow by appending
+// fields. Reading never needs aligned input, and bytes fields point into the payload
+// instead of being copied, so they live as long as the received frame.
+//
+// Everything here is static inline since the schemas expand in user code; there's no
+// implementation section to define.
+
+#include "msock.h"
+
+typedef uint8_t msock_codec_u8;
+typedef uint16_t msock_codec_u16;
+typedef uint32_t msock_codec_u32;
+typedef uint64_t msock_codec_u64;
+typedef int32_t msock_codec_i32;
+typedef int64_t msock_codec_i64;
+typedef float msock_codec_f32;
+typedef double msock_codec_f64;
+typedef uint64_t msock_codec_varint;
+typedef int64_t msock_codec_svarint;
+
+typedef struct {
+    const char* data;
+    size_t len;
+} msock_codec_bytes;
+
+static inline msock_codec_bytes msock_codec_cstr(const char* text) {
+    msock_codec_bytes bytes = { text, strlen(text) };
+    return bytes;
+}
+
+// Fixed width: put returns bytes written, get returns bytes read or 0 when truncated
+
+static inline size_t msock_codec_put_u8(char* out, msock_codec_u8 value) {
+    out[0] = (char)value;
+    return 1;
+}
+
+static inline size_t msock_codec_put_u16(char* out, msock_codec_u16 value) {
+    out[0] = (char)(value & 0xff);
+    out[1] = (char)(value >> 8);
+    return 2;
+}
+
+static inline size_t msock_codec_put_u32(char* out, msock_codec_u32 value) {
+    for (int i = 0; i < 4; i++) out[i] = (char)((value >> (i * 8)) & 0xff);
+    return 4;
+}
+
+static inline size_t msock_codec_put_u64(char* out, msock_codec_u64 value) {
+    for (int i = 0; i < 8; i++) out[i] = (char)((value >> (i * 8)) & 0xff);
+    return 8;
+}
+
+static inline size_t msock_codec_get_u8(const char* in, size_t len, msock_codec_u8* value) {
+    if (len < 1) return 0;
+    *value = (uint8_t)in[0];
+    return 1;
+}
+
+static inline size_t msock_codec_get_u16(const char* in, size_t len, msock_codec_u16* value) {
+    if (len < 2) return 0;
+    const uint8_t* b = (const uint8_t*)in;
+    *value = (uint16_t)(b[0] | (b[1] << 8));
+    return 2;
+}
+
+static inline size_t msock_codec_get_u32(const char* in, size_t len, msock_codec_u32* value) {
+    if (len < 4) return 0;
+    const uint8_t* b = (const uint8_t*)in;
+    *value = (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+    return 4;
+}
+
+static inline size_t msock_codec_get_u64(const char* in, size_t len, msock_codec_u64* value) {
+    if (len < 8) return 0;
+    const uint8_t* b = (const uint8_t*)in;
+    uint64_t result = 0;
+    for (int i = 7; i >= 0; i--) result = (result << 8) | b[i];
+    *value = result;
+    return 8;
+}
+
+static inline size_t msock_codec_put_i32(char* out, msock_codec_i32 value) {
+    return msock_codec_put_u32(out, (uint32_t)value);
+}
+
+static inline size_t msock_codec_get_i32(const char* in, size_t len, msock_codec_i32* value) {
+    uint32_t bits;
+    size_t used = msock_codec_get_u32(in, len, &bits);
+    *value = (int32_t)bits;
+    return used;
+}
+
+static inline size_t msock_codec_put_i64(char* out, msock_codec_i64 value) {
+    return msock_codec_put_u64(out, (uint64_t)value);
+}
+
+static inline size_t msock_codec_get_i64(const char* in, size_t len, msock_codec_i64* value) {
+    uint64_t bits;
+    size_t used = msock_codec_get_u64(in, len, &bits);
+    *value = (int64_t)bits;
+    return used;
+}
+
+// Floats travel as their IEEE 754 bit pattern
+static inline size_t msock_codec_put_f32(char* out, msock_codec_f32 value) {
+    uint32_t bits;
+    memcpy(&bits, &value, 4);
+    return msock_codec_put_u32(out, bits);
+}
+
+static inline size_t msock_codec_get_f32(const char* in, size_t len, msock_codec_f32* value) {
+    uint32_t bits = 0;
+    size_t used = msock_codec_get_u32(in, len, &bits);
+    memcpy(value, &bits, 4);
+    return used;
+}
+
+static inline size_t msock_codec_put_f64(char* out, msock_codec_f64 value) {
+    uint64_t bits;
+    memcpy(&bits, &value, 8);
+    return msock_codec_put_u64(out, bits);
+}
+
+static inline size_t msock_codec_get_f64(const char* in, size_t len, msock_codec_f64* value) {
+    uint64_t bits = 0;
+    size_t used = msock_codec_get_u64(in, len, &bits);
+    memcpy(value, &bits, 8);
+    return used;
+}
+
+// Varints: 7 bits per byte, low bits first, high bit set on every byte but the last
+
+static inline size_t msock_codec_put_varint(char* out, msock_codec_varint value) {
+    size_t i = 0;
+    while (value >= 0x80) {
+        out[i++] = (char)((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out[i++] = (char)value;
+    return i;
+}
+
+static inline size_t msock_codec_get_varint(const char* in, size_t len, msock_codec_varint* value) {
+    const uint8_t* b = (const uint8_t*)in;
+    uint64_t result = 0;
+
+    for (size_t i = 0; i < len && i < 10; i++) {
+        if (i == 9 && b[i] > 1) return 0; // The 10th byte only holds bit 63
+        result |= (uint64_t)(b[i] & 0x7f) << (i * 7);
+        if (!(b[i] & 0x80)) {
+            *value = result;
+            return i + 1;
+        }
+    }
+    return 0; // Truncated, or longer than any 64 bit value
+}
+
+static inline size_t msock_codec_size_varint(msock_codec_varint value) {
+    size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+// Zigzag keeps small negative numbers short: 0, -1, 1, -2 ... map to 0, 1, 2, 3 ...
+static inline size_t msock_codec_put_svarint(char* out, msock_codec_svarint value) {
+    return msock_codec_put_varint(out, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+static inline size_t msock_codec_get_svarint(const char* in, size_t len, msock_codec_svarint* value) {
+    uint64_t zigzag = 0;
+    size_t used = msock_codec_get_varint(in, len, &zigzag);
+    *value = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+    return used;
+}
+
+static inline size_t msock_codec_size_svarint(msock_codec_svarint value) {
+    return msock_codec_size_varint(((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+static inline size_t msock_codec_put_bytes(char* out, msock_codec_bytes value) {
+    size_t used = msock_codec_put_varint(out, value.len);
+    if (value.len > 0) memcpy(out + used, value.data, value.len);
+    return used + value.len;
+}
+
+// Points value into in, nothing is copied
+static inline size_t msock_codec_get_bytes(const char* in, size_t len, msock_codec_bytes* value) {
+    uint64_t length = 0;
+    size_t used = msock_codec_get_varint(in, len, &length);
+    if (used == 0 || length > len - used) return 0;
+
+    value->data = in + used;
+    value->len = (size_t)length;
+    return used + (size_t)length;
+}
+
+static inline size_t msock_codec_size_bytes(msock_codec_bytes value) {
+    return msock_codec_size_varint(value.len) + value.len;
+}
+
+static inline size_t msock_codec_size_u8(msock_codec_u8 value) { (void)value; return 1; }
+static inline size_t msock_codec_size_u16(msock_codec_u16 value) { (void)value; return 2; }
+static inline size_t msock_codec_size_u32(msock_codec_u32 value) { (void)value; return 4; }
+static inline size_t msock_codec_size_u64(msock_codec_u64 value) { (void)value; return 8; }
+static inline size_t msock_codec_size_i32(msock_codec_i32 value) { (void)value; return 4; }
+static inline size_t msock_codec_size_i64(msock_codec_i64 value) { (void)value; return 8; }
+static inline size_t msock_codec_size_f32(msock_codec_f32 value) { (void)value; return 4; }
+static inline size_t msock_codec_size_f64(msock_codec_f64 value) { (void)value; return 8; }
+
+// Expands once per field of a schema
+#define MSOCK_INTERNAL_CODEC_DECLARE(type, field) msock_codec_##type field;
+#define MSOCK_INTERNAL_CODEC_SIZE(type, field) size += msock_codec_size_##type(msg->field);
+#define MSOCK_INTERNAL_CODEC_ENCODE(type, field) offset += msock_codec_put_##type(out + offset, msg->field);
+#define MSOCK_INTERNAL_CODEC_READ(type, field)                                     \
+    used = msock_codec_get_##type(payload + offset, len - offset, &msg->field); \
+    if (used == 0) return false;                                                \
+    offset += used;
+
+#define MSOCK_SCHEMA(name, FIELDS)                                                                                             \
+    typedef struct {                                                                                                           \
+        FIELDS(MSOCK_INTERNAL_CODEC_DECLARE)                                                                                   \
+    } name;                                                                                                                    \
+                                                                                                                               \
+    static inline size_t name##_size(const name* msg) {                                                                        \
+        size_t size = 0;                                                                                                       \
+        FIELDS(MSOCK_INTERNAL_CODEC_SIZE)                                                                                      \
+        return size;                                                                                                           \
+    }                                                                                                                          \
+                                                                                                                               \
+    static inline size_t name##_encode(const name* msg, char* out) {                                                           \
+        size_t offset = 0;                                                                                                     \
+        FIELDS(MSOCK_INTERNAL_CODEC_ENCODE)                                                                                    \
+        return offset;                                                                                                         \
+    }                                                                                                                          \
+                                                                                                                               \
+    static inline bool name##_read(name* msg, const char* payload, size_t len) {                                               \
+        size_t offset = 0;                                                                                                     \
+        size_t used;                                                                                                           \
+        FIELDS(MSOCK_INTERNAL_CODEC_READ)                                                                                      \
+        (void)used;                                                                                                            \
+        return true;                                                                                                           \
+    }                                                                                                                          \
+                                                                                                                               \
+    /* Encodes straight into a pooled buffer behind a frame header, ready to send to any number of clients */                  \
+    static inline msock_buffer* name##_frame(uint32_t correlation_id, uint16_t flags, const name* msg) {                       \
+        size_t len = name##_size(msg);                                                                                         \
+        if (len > MSOCK_FRAME_MAX_PAYLOAD) return NULL;                                                                        \
+                                                                                                                               \
+        msock_buffer* buffer = msock_buffer_acquire(MSOCK_FRAME_HEADER_SIZE + len);                                            \
+        if (!buffer) return NULL;                                                                                              \
+                                                                                                                               \
+        msock_frame_header header = { (uint32_t)len, correlation_id, flags, 0 };                                               \
+        msock_frame_write_header(buffer->data, &header);                                                                       \
+        buffer->len = MSOCK_FRAME_HEADER_SIZE + name##_encode(msg, buffer->data + MSOCK_FRAME_HEADER_SIZE);                    \
+        return buffer;                                                                                                         \
+    }                                                                                                                          \
+                                                                                                                               \
+    static inline bool name##_send(msock_client* client, uint32_t correlation_id, uint16_t flags, const name* msg) {           \
+        msock_buffer* buffer = name##_frame(correlation_id, flags, msg);                                                       \
+        if (!buffer) return false;                                                                                             \
+                                                                                                                               \
+        bool success = msock_client_send_buffer(client, buffer);                                                               \
+        msock_buffer_release(buffer);                                                                                          \
+        return success;                                                                                                        \
+    }
+
+#endif // MSOCK_CODEC_H
@@ -0,0 +1,514 @@
+#ifndef MSOCK_HTTP_H
+#define MSOCK_HTTP_H
+
+// Minimal HTTP/1.1 server on top of msock_server: keep-alive, pipelining, Content-Length
+// bodies. Chunked request bodies are answered with 501.
+//
+//     #define MSOCK_IMPLEMENTATION
+//     #define MSOCK_HTTP_IMPLEMENTATION
+//     #include "msock_http.h"
+
+#include "msock.h"
+#include "msock_proto.h"
+
+#define MSOCK_HTTP_MAX_HEADERS 32
+#define MSOCK_HTTP_BUFFER_SIZE (64 * 1024)  // Per connection, bounds request line + headers + body
+#define MSOCK_HTTP_OUT_SIZE (16 * 1024)     // Per connection response batch
+#define MSOCK_HTTP_INLINE_BODY 1024         // Bodies up to this size are copied into the batch
+
+// Points into the connection buffer, valid until the handler returns
+typedef struct {
+    const char* data;
+    size_t len;
+} msock_http_str;
+
+typedef struct {
+    msock_http_str name;
+    msock_http_str value;
+} msock_http_header;
+
+typedef struct {
+    msock_http_str method;
+    msock_http_str target; // Path and query as sent
+    int minor_version;     // HTTP/1.<minor_version>
+    msock_http_header headers[MSOCK_HTTP_MAX_HEADERS];
+    int header_count;
+    const char* body;
+    size_t body_len;
+    bool keep_alive;
+} msock_http_request;
+
+typedef struct msock_http_server msock_http_server;
+typedef struct msock_http_conn msock_http_conn;
+
+// Takes over a connection after msock_http_upgrade. Called whenever new bytes were
+// appended to conn->io.in; consumes what it handled from the front. Return false to close.
+// Called one last time with conn->io.client no longer connected when the peer went away.
+typedef bool (*msock_http_upgrade_cb)(msock_http_conn* conn, void* ctx);
+
+struct msock_http_conn {
+    msock_http_server* http;
+    msock_proto_conn io; // closing is set once Connection: close was answered
+
+    size_t scan_offset; // Where the search for the end of the headers resumes
+    bool responded;    // The current request got its response
+
+    msock_http_upgrade_cb upgrade_cb; // Set once the connection switched protocols
+    void* upgrade_ctx;
+};
+
+// Called once per request, in order, even when several arrive pipelined in one read.
+// Must answer with msock_http_respond before returning, or a 500 is sent instead.
+typedef void (*msock_http_handler_cb)(msock_http_conn* conn, const msock_http_request* request, void* userdata);
+
+typedef struct {
+    uint64_t requests;
+    uint64_t bad_requests;
+    uint64_t pipelined_reads; // Reads that carried more than one complete request
+    uint64_t batched_sends;   // Vectored sends that flushed a response batch
+} msock_http_stats;
+
+struct msock_http_server {
+    msock_server* server;
+    msock_http_handler_cb handler;
+    void* userdata;
+    msock_http_conn* conns; // Indexed like server->connected_clients
+    msock_http_stats stats;
+};
+
+bool msock_http_attach(msock_http_server* http, msock_server* server, msock_http_handler_cb handler, void* userdata);
+void msock_http_detach(msock_http_server* http);
+
+bool msock_http_respond(msock_http_conn* conn, int status, const char* content_type, const void* body, size_t len);
+bool msock_http_respond_headers(msock_http_conn* conn, int status, const msock_http_header* headers, int header_count, const void* body, size_t len);
+bool msock_http_upgrade(msock_http_conn* conn, const msock_http_header* headers, int header_count, msock_http_upgrade_cb cb, void* ctx);
+const msock_http_str* msock_http_find_header(const msock_http_request* request, const char* name);
+bool msock_http_header_has_token(const msock_http_str* value, const char* token);
+bool msock_http_str_equals(msock_http_str str, const char* text);
+const char* msock_http_status_text(int status);
+const msock_http_stats* msock_http_get_stats(msock_http_server* http);
+
+#ifdef MSOCK_HTTP_IMPLEMENTATION
+
+//MSOCK_HTTP Implementations
+
+static bool msock_internal_http_iequals(const char* a, size_t len, const char* b) {
+    for (size_t i = 0; i < len; i++) {
+        char x = a[i];
+        char y = b[i];
+        if (y == '\0') return false;
+        if (x >= 'A' && x <= 'Z') x = (char)(x + 32);
+        if (y >= 'A' && y <= 'Z') y = (char)(y + 32);
+        if (x != y) return false;
+    }
+    return b[len] == '\0';
+}
+
+bool msock_http_str_equals(msock_http_str str, const char* text) {
+    return strlen(text) == str.len && memcmp(str.data, text, str.len) == 0;
+}
+
+const msock_http_str* msock_http_find_header(const msock_http_request* request, const char* name) {
+    for (int i = 0; i < request->header_count; i++) {
+        const msock_http_header* header = &request->headers[i];
+        if (msock_internal_http_iequals(header->name.data, header->name.len, name)) return &header->value;
+    }
+    return NULL;
+}
+
+const char* msock_http_status_text(int status) {
+    switch (status) {
+    case 200: return "OK";
+    case 201: return "Created";
+    case 204: return "No Content";
+    case 301: return "Moved Permanently";
+    case 302: return "Found";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 403: return "Forbidden";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 413: return "Payload Too Large";
+    case 431: return "Request Header Fields Too Large";
+    case 500: return "Internal Server Error";
+    case 501: return "Not Implemented";
+    case 503: return "Service Unavailable";
+    default: return "Unknown";
+    }
+}
+
+static void msock_internal_http_trim(msock_http_str* str) {
+    while (str->len > 0 && (str->data[0] == ' ' || str->data[0] == '\t')) {
+        str->data++;
+        str->len--;
+    }
+    while (str->len > 0 && (str->data[str->len - 1] == ' ' || str->data[str->len - 1] == '\t')) str->len--;
+}
+
+// Looks for the end of the headers starting at *scan_offset, and leaves *scan_offset where
+// the next call has to resume, so bytes aren't searched again when a request trickles in.
+// Returns the header length including the blank line, 0 if incomplete.
+static size_t msock_internal_http_find_head_end(const char* data, size_t len, size_t* scan_offset) {
+    size_t offset = *scan_offset;
+
+    while (offset < len) {
+        const char* newline = (const char*)memchr(data + offset, '\n', len - offset);
+        if (!newline) break;
+
+        size_t position = (size_t)(newline - data);
+        // "\n\n" or "\n\r\n" ends the headers
+        if (position >= 1 && data[position - 1] == '\n') return position + 1;
+        if (position >= 2 && data[position - 1] == '\r' && data[position - 2] == '\n') return position + 1;
+        offset = position + 1;
+    }
+
+    *scan_offset = len > 2 ? len - 2 : 0;
+    return 0;
+}
+
+// Parses the head in data[0..head_len). Returns 0 on success or the status to fail with.
+static int msock_internal_http_parse_head(const char* data, size_t head_len, msock_http_request* request) {
+    const char* end = data + head_len;
+    const char* line = data;
+
+    const char* line_end = (const char*)memchr(line, '\n', (size_t)(end - line));
+    size_t line_len = (size_t)(line_end - line);
+    if (line_len > 0 && line[line_len - 1] == '\r') line_len--;
+
+    // METHOD SP target SP HTTP/1.x
+    const char* space = (const char*)memchr(line, ' ', line_len);
+    if (!space || space == line) return 400;
+    request->method.data = line;
+    request->method.len = (size_t)(space - line);
+
+    const char* target = space + 1;
+    const char* version = (const char*)memchr(target, ' ', line_len - (size_t)(target - line));
+    if (!version || version == target) return 400;
+    request->target.data = target;
+    request->target.len = (size_t)(version - target);
+
+    version++;
+    size_t version_len = line_len - (size_t)(version - line);
+    if (version_len != 8 || memcmp(version, "HTTP/1.", 7) != 0 || version[7] < '0' || version[7] > '9') return 400;
+    request->minor_version = version[7] - '0';
+
+    request->header_count = 0;
+    line = line_end + 1;
+
+    while (line < end) {
+        line_end = (const char*)memchr(line, '\n', (size_t)(end - line));
+        line_len = (size_t)(line_end - line);
+        if (line_len > 0 && line[line_len - 1] == '\r') line_len--;
+        if (line_len == 0) break;
+
+        if (request->header_count == MSOCK_HTTP_MAX_HEADERS) return 431;
+
+        const char* colon = (const char*)memchr(line, ':', line_len);
+        if (!colon || colon == line) return 400;
+
+        msock_http_header* header = &request->headers[request->header_count++];
+        header->name.data = line;
+        header->name.len = (size_t)(colon - line);
+        header->value.data = colon + 1;
+        header->value.len = line_len - header->name.len - 1;
+        msock_internal_http_trim(&header->value);
+
+        line = line_end + 1;
+    }
+
+    return 0;
+}
+
+// Response heads, and small bodies, go into the connection's batch, which is sent with
+// one vectored send after the whole read was handled. A large body is sent right away
+// together with the batch so far, straight from the caller's memory.
+bool msock_http_respond_headers(msock_http_conn* conn, int status, const msock_http_header* headers, int header_count, const void* body, size_t len) {
+    if (conn->responded) {
+        printf("msock_http: request already answered\n");
+        return false;
+    }
+    conn->responded = true;
+
+    char head[2048];
+    int head_len = snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\nContent-Length: %zu\r\n%s", status, msock_http_status_text(status), len,
+                            conn->io.closing ? "Connection: close\r\n" : "");
+
+    for (int i = 0; i < header_count && head_len > 0 && (size_t)head_len < sizeof(head); i++) {
+        head_len += snprintf(head + head_len, sizeof(head) - (size_t)head_len, "%.*s: %.*s\r\n", (int)headers[i].name.len, headers[i].name.data,
+                             (int)headers[i].value.len, headers[i].value.data);
+    }
+    if (head_len < 0 || (size_t)head_len + 2 >= sizeof(head)) {
+        printf("msock_http: response headers too large\n");
+        return false;
+    }
+    head[head_len++] = '\r';
+    head[head_len++] = '\n';
+
+    bool inline_body = len <= MSOCK_HTTP_INLINE_BODY;
+    if (!msock_proto_reserve(&conn->io, (size_t)head_len + (inline_body ? len : 0))) return false;
+
+    memcpy(conn->io.out + conn->io.out_len, head, (size_t)head_len);
+    conn->io.out_len += (size_t)head_len;
+
+    if (inline_body) {
+        if (len > 0) memcpy(conn->io.out + conn->io.out_len, body, len);
+        conn->io.out_len += len;
+        return true;
+    }
+
+    return msock_proto_flush(&conn->io, body, len, NULL, 0);
+}
+
+bool msock_http_respond(msock_http_conn* conn, int status, const char* content_type, const void* body, size_t len) {
+    msock_http_header header;
+    header.name.data = "Content-Type";
+    header.name.len = 12;
+    header.value.data = content_type;
+    header.value.len = content_type ? strlen(content_type) : 0;
+
+    return msock_http_respond_headers(conn, status, &header, content_type ? 1 : 0, body, len);
+}
+
+// Answers the current request with 101 Switching Protocols plus headers, and hands the
+// connection to cb from the next byte on, including bytes already pipelined behind it.
+// Must be called from the request handler.
+bool msock_http_upgrade(msock_http_conn* conn, const msock_http_header* headers, int header_count, msock_http_upgrade_cb cb, void* ctx) {
+    if (conn->responded) {
+        printf("msock_http: request already answered\n");
+        return false;
+    }
+
+    // No Content-Length, a 101 has no body
+    char head[1024];
+    int head_len = snprintf(head, sizeof(head), "HTTP/1.1 101 Switching Protocols\r\n");
+    for (int i = 0; i < header_count && head_len > 0 && (size_t)head_len < sizeof(head); i++) {
+        head_len += snprintf(head + head_len, sizeof(head) - (size_t)head_len, "%.*s: %.*s\r\n", (int)headers[i].name.len, headers[i].name.data,
+                             (int)headers[i].value.len, headers[i].value.data);
+    }
+    if (head_len < 0 || (size_t)head_len + 2 >= sizeof(head)) {
+        printf("msock_http: upgrade headers too large\n");
+        return false;
+    }
+    head[head_len++] = '\r';
+    head[head_len++] = '\n';
+
+    if (!msock_proto_write(&conn->io, head, (size_t)head_len)) return false;
+
+    conn->responded = true;
+    conn->io.closing = false;
+    conn->upgrade_cb = cb;
+    conn->upgrade_ctx = ctx;
+
+    // Sent right away, the new protocol may write to the client before this read is done
+    return msock_proto_flush(&conn->io, NULL, 0, NULL, 0);
+}
+
+// Whether a comma separated header value such as "keep-alive, Upgrade" contains token
+bool msock_http_header_has_token(const msock_http_str* value, const char* token) {
+    if (!value) return false;
+
+    size_t start = 0;
+    while (start < value->len) {
+        size_t end = start;
+        while (end < value->len && value->data[end] != ',') end++;
+
+        msock_http_str item = { value->data + start, end - start };
+        msock_internal_http_trim(&item);
+        if (msock_internal_http_iequals(item.data, item.len, token)) return true;
+
+        start = end + 1;
+    }
+    return false;
+}
+
+// Reads the body length from every Content-Length header. Returns 0 on success or the
+// status to fail with: copies that disagree, or one next to Transfer-Encoding, leave the
+// body's end ambiguous to anything in front of this server, so those are rejected.
+static int msock_internal_http_content_length(const msock_http_request* request, size_t* body_len) {
+    bool found = false;
+    bool transfer_encoding = msock_http_find_header(request, "Transfer-Encoding") != NULL;
+    *body_len = 0;
+
+    for (int i = 0; i < request->header_count; i++) {
+        const msock_http_header* header = &request->headers[i];
+        if (!msock_internal_http_iequals(header->name.data, header->name.len, "Content-Length")) continue;
+        if (transfer_encoding) return 400;
+
+        const msock_http_str* value = &header->value;
+        if (value->len == 0) return 400;
+        if (value->len > 9) return 413;
+
+        size_t len = 0;
+        for (size_t j = 0; j < value->len; j++) {
+            char c = value->data[j];
+            if (c < '0' || c > '9') return 400;
+            len = len * 10 + (size_t)(c - '0');
+        }
+
+        if (found && len != *body_len) return 400;
+        found = true;
+        *body_len = len;
+    }
+    return 0;
+}
+
+static void msock_internal_http_fail(msock_http_conn* conn, int status) {
+    conn->http->stats.bad_requests++;
+    conn->io.closing = true;
+    conn->responded = false;
+
+    const char* text = msock_http_status_text(status);
+    msock_http_respond(conn, status, "text/plain", text, strlen(text));
+}
+
+// Handles every complete request in conn->io.in. Returns false on a fatal parse error.
+static bool msock_internal_http_process(msock_http_conn* conn) {
+    msock_http_server* http = conn->http;
+    size_t consumed = 0;
+    int handled = 0;
+
+    // scan_offset is relative to the first unconsumed byte
+    while (!conn->io.closing && !conn->upgrade_cb) {
+        char* data = conn->io.in + consumed;
+        size_t available = conn->io.in_len - consumed;
+        if (available == 0) break;
+
+        size_t head_len = msock_internal_http_find_head_end(data, available, &conn->scan_offset);
+        if (head_len == 0) {
+            if (available >= MSOCK_HTTP_BUFFER_SIZE) msock_internal_http_fail(conn, 431);
+            break;
+        }
+
+        msock_http_request request;
+        memset(&request, 0, sizeof(request));
+        int status = msock_internal_http_parse_head(data, head_len, &request);
+        if (status != 0) {
+            msock_internal_http_fail(conn, status);
+            break;
+        }
+
+        size_t body_len;
+        status = msock_internal_http_content_length(&request, &body_len);
+        if (status != 0) {
+            msock_internal_http_fail(conn, status);
+            break;
+        }
+
+        const msock_http_str* transfer_encoding = msock_http_find_header(&request, "Transfer-Encoding");
+        if (transfer_encoding && !msock_internal_http_iequals(transfer_encoding->data, transfer_encoding->len, "identity")) {
+            msock_internal_http_fail(conn, 501);
+            break;
+        }
+
+        if (head_len + body_len > MSOCK_HTTP_BUFFER_SIZE) {
+            msock_internal_http_fail(conn, 413);
+            break;
+        }
+        if (head_len + body_len > available) break; // Body still on its way
+
+        request.body = data + head_len;
+        request.body_len = body_len;
+
+        const msock_http_str* connection = msock_http_find_header(&request, "Connection");
+        if (request.minor_version == 0) {
+            request.keep_alive = msock_http_header_has_token(connection, "keep-alive");
+        } else {
+            request.keep_alive = !msock_http_header_has_token(connection, "close");
+        }
+
+        conn->io.closing = !request.keep_alive;
+        conn->responded = false;
+        http->stats.requests++;
+        http->handler(conn, &request, http->userdata);
+
+        if (!conn->responded) {
+            printf("msock_http: handler didn't respond to %.*s %.*s\n", (int)request.method.len, request.method.data, (int)request.target.len,
+                   request.target.data);
+            msock_http_respond(conn, 500, "text/plain", "Internal Server Error", 21);
+        }
+
+        consumed += head_len + body_len;
+        conn->scan_offset = 0;
+        handled++;
+    }
+
+    if (handled > 1) http->stats.pipelined_reads++;
+
+    msock_proto_consume(&conn->io, consumed);
+    return msock_proto_flush(&conn->io, NULL, 0, NULL, 0);
+}
+
+static bool msock_internal_http_on_client(msock_server* server, msock_client* client) {
+    msock_http_server* http = (msock_http_server*)server->userdata;
+    msock_http_conn* conn = (msock_http_conn*)msock_client_get_userdata(client);
+
+    // Accept clears the client's userdata, so a NULL here is a new connection on this slot
+    if (!conn) {
+        conn = &http->conns[client - server->connected_clients];
+        if (!msock_proto_conn_open(&conn->io, client, MSOCK_HTTP_BUFFER_SIZE, MSOCK_HTTP_OUT_SIZE, &http->stats.batched_sends)) return false;
+        conn->http = http;
+        conn->scan_offset = 0;
+        conn->upgrade_cb = NULL;
+        conn->upgrade_ctx = NULL;
+        msock_client_set_userdata(client, conn);
+    }
+
+    if (conn->io.closing) return msock_proto_drain_closing(&conn->io);
+
+    ssize_t received = msock_proto_receive(&conn->io);
+    if (received < 0) {
+        // The new protocol sees the connection end as a call with the client disconnected
+        if (conn->upgrade_cb) conn->upgrade_cb(conn, conn->upgrade_ctx);
+        return false;
+    }
+    if (received == 0) return true;
+
+    if (conn->upgrade_cb) {
+        if (!conn->upgrade_cb(conn, conn->upgrade_ctx)) return false;
+    } else {
+        if (!msock_internal_http_process(conn)) return false;
+
+        // Bytes pipelined behind the upgrade request already belong to the new protocol
+        if (conn->upgrade_cb && conn->io.in_len > 0 && !conn->upgrade_cb(conn, conn->upgrade_ctx)) return false;
+    }
+
+    return msock_proto_keep(&conn->io);
+}
+
+// Serves HTTP on server. Takes over the server's client callback and userdata, the
+// handler gets its own userdata instead.
+bool msock_http_attach(msock_http_server* http, msock_server* server, msock_http_handler_cb handler, void* userdata) {
+    memset(http, 0, sizeof(*http));
+    http->conns = (msock_http_conn*)calloc(MSOCK_MAX_CLIENTS, sizeof(msock_http_conn));
+    if (!http->conns) {
+        printf("calloc() failed for HTTP connections\n");
+        return false;
+    }
+
+    http->server = server;
+    http->handler = handler;
+    http->userdata = userdata;
+
+    msock_server_set_userdata(server, http);
+    msock_server_set_client_cb(server, msock_internal_http_on_client);
+    return true;
+}
+
+void msock_http_detach(msock_http_server* http) {
+    if (!http->conns) return;
+
+    msock_server_set_client_cb(http->server, NULL);
+    msock_server_set_userdata(http->server, NULL);
+
+    for (int i = 0; i < MSOCK_MAX_CLIENTS; i++) msock_proto_conn_free(&http->conns[i].io);
+    free(http->conns);
+    http->conns = NULL;
+}
+
+const msock_http_stats* msock_http_get_stats(msock_http_server* http) {
+    return &http->stats;
+}
+
+#endif // MSOCK_HTTP_IMPLEMENTATION
+
+#endif // MSOCK_HTTP_H
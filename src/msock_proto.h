@@ -0,0 +1,135 @@
+#ifndef MSOCK_PROTO_H
+#define MSOCK_PROTO_H
+
+// Per-connection plumbing shared by the request/response protocol modules (msock_http,
+// msock_resp): an input buffer requests are parsed from in place, an output batch that
+// collects the answers of one read for a single vectored send, and hanging up only once
+// the last answer left the write queue.
+//
+// Everything here is static inline, the modules embed it in their own implementation.
+
+#include "msock.h"
+
+typedef struct {
+    msock_client* client;
+
+    char* in;          // Received bytes, parsed in place
+    size_t in_len;
+    size_t in_capacity;
+
+    char* out;         // Answers of one read, sent together
+    size_t out_len;
+    size_t out_capacity;
+
+    bool closing;      // The last answer was written, drop once the queue drained
+    uint64_t* batched_sends; // Module stats counter, bumped per vectored send
+} msock_proto_conn;
+
+// Binds conn to a newly accepted client. The buffers are allocated the first time the slot
+// is used and kept for the next connection on it.
+static inline bool msock_proto_conn_open(msock_proto_conn* conn, msock_client* client, size_t in_capacity, size_t out_capacity, uint64_t* batched_sends) {
+    if (!conn->in) {
+        conn->in = (char*)malloc(in_capacity + 1);
+        conn->out = (char*)malloc(out_capacity);
+        if (!conn->in || !conn->out) {
+            printf("malloc() failed for connection buffers\n");
+            // The next connection on this slot tries again from scratch
+            free(conn->in);
+            free(conn->out);
+            conn->in = NULL;
+            conn->out = NULL;
+            return false;
+        }
+        conn->in_capacity = in_capacity;
+        conn->out_capacity = out_capacity;
+    }
+
+    conn->client = client;
+    conn->in_len = 0;
+    conn->out_len = 0;
+    conn->closing = false;
+    conn->batched_sends = batched_sends;
+    return true;
+}
+
+static inline void msock_proto_conn_free(msock_proto_conn* conn) {
+    free(conn->in);
+    free(conn->out);
+    conn->in = NULL;
+    conn->out = NULL;
+}
+
+// Sends the batch, followed by up to two pieces straight from the caller's memory
+static inline bool msock_proto_flush(msock_proto_conn* conn, const void* data, size_t len, const void* tail, size_t tail_len) {
+    msock_iovec iov[3];
+    int count = 0;
+
+    if (conn->out_len > 0) {
+        iov[count].data = conn->out;
+        iov[count].len = conn->out_len;
+        count++;
+    }
+    if (len > 0) {
+        iov[count].data = data;
+        iov[count].len = len;
+        count++;
+    }
+    if (tail_len > 0) {
+        iov[count].data = tail;
+        iov[count].len = tail_len;
+        count++;
+    }
+    if (count == 0) return true;
+
+    conn->out_len = 0;
+    (*conn->batched_sends)++;
+    return msock_client_sendv(conn->client, iov, count);
+}
+
+// Makes room for len more bytes in the batch, flushing it first if needed
+static inline bool msock_proto_reserve(msock_proto_conn* conn, size_t len) {
+    return conn->out_len + len <= conn->out_capacity || msock_proto_flush(conn, NULL, 0, NULL, 0);
+}
+
+// Copies data into the batch. More than the batch holds goes out right away behind it.
+static inline bool msock_proto_write(msock_proto_conn* conn, const void* data, size_t len) {
+    if (!msock_proto_reserve(conn, len)) return false;
+    if (len > conn->out_capacity) return msock_proto_flush(conn, data, len, NULL, 0);
+
+    memcpy(conn->out + conn->out_len, data, len);
+    conn->out_len += len;
+    return true;
+}
+
+// Appends what is readable to the input. Returns the bytes received, 0 if there was
+// nothing, -1 once the connection is gone.
+static inline ssize_t msock_proto_receive(msock_proto_conn* conn) {
+    msock_message msg = { .buffer = conn->in + conn->in_len, .size = conn->in_capacity - conn->in_len + 1 };
+    ssize_t received = msock_client_receive(conn->client, &msg);
+    if (received < 0 || conn->client->socket_state == MSOCK_STATE_DISCONNECTED) return -1;
+
+    conn->in_len += (size_t)received;
+    return received;
+}
+
+// Drops the handled bytes, keeping the unfinished rest at the front of the input
+static inline void msock_proto_consume(msock_proto_conn* conn, size_t consumed) {
+    if (consumed == 0) return;
+    memmove(conn->in, conn->in + consumed, conn->in_len - consumed);
+    conn->in_len -= consumed;
+}
+
+// Whether the server should keep the connection after a read. A closing connection is
+// read from and discarded until its last answer went out, then hung up on.
+static inline bool msock_proto_keep(msock_proto_conn* conn) {
+    return !conn->closing || msock_client_has_pending_writes(conn->client);
+}
+
+static inline bool msock_proto_drain_closing(msock_proto_conn* conn) {
+    char discard[512];
+    msock_message msg = { .buffer = discard, .size = sizeof(discard) };
+    msock_client_receive(conn->client, &msg);
+    return msock_client_has_pending_writes(conn->client) && conn->client->socket_state == MSOCK_STATE_CONNECTED;
+}
+
+#endif // MSOCK_PROTO_H
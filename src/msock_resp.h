@@ -0,0 +1,493 @@
+#ifndef MSOCK_RESP_H
+#define MSOCK_RESP_H
+
+// RESP2 (Redis serialization protocol) server on top of msock_server. Commands are parsed
+// in place, multibulk or inline, and dispatched through a table of registered handlers.
+// Every command that completed in one read is handled before the replies go out together.
+//
+//     #define MSOCK_IMPLEMENTATION
+//     #define MSOCK_RESP_IMPLEMENTATION
+//     #include "msock_resp.h"
+
+#include "msock.h"
+#include "msock_proto.h"
+
+#define MSOCK_RESP_MAX_ARGS 128
+#define MSOCK_RESP_MAX_COMMANDS 128          // Registered command names
+#define MSOCK_RESP_BUFFER_SIZE (256 * 1024)  // Per connection, bounds one command
+#define MSOCK_RESP_OUT_SIZE (16 * 1024)      // Per connection reply batch
+#define MSOCK_RESP_INLINE_BULK 1024          // Bulk replies up to this size are copied into the batch
+
+// Points into the connection buffer, valid until the handler returns
+typedef struct {
+    const char* data;
+    size_t len;
+} msock_resp_str;
+
+typedef struct {
+    int argc;
+    msock_resp_str argv[MSOCK_RESP_MAX_ARGS]; // argv[0] is the command name
+} msock_resp_command;
+
+typedef struct msock_resp_server msock_resp_server;
+
+typedef struct {
+    msock_resp_server* resp;
+    msock_proto_conn io; // closing is set once a protocol error was answered
+
+    // Progress on a command that is only partly received, so it isn't parsed again
+    msock_resp_command pending;
+    int pending_argc;  // Arguments announced by the multibulk header, 0 = none yet
+    size_t pending_len; // Bytes of the command parsed so far
+
+    int replies;       // Replies written for the current command
+    void* userdata;
+} msock_resp_conn;
+
+// Must write a reply, or an error reply is sent instead
+typedef void (*msock_resp_handler_cb)(msock_resp_conn* conn, const msock_resp_command* command, void* userdata);
+
+typedef struct {
+    char name[32];     // Lowercase
+    size_t name_len;
+    int arity;         // Like Redis: N = exactly N arguments with the name, -N = at least N
+    msock_resp_handler_cb handler;
+} msock_resp_command_def;
+
+typedef struct {
+    uint64_t commands;
+    uint64_t unknown_commands;
+    uint64_t protocol_errors;
+    uint64_t pipelined_reads; // Reads that carried more than one complete command
+    uint64_t batched_sends;   // Vectored sends that flushed a reply batch
+} msock_resp_stats;
+
+struct msock_resp_server {
+    msock_server* server;
+    void* userdata;
+    msock_resp_conn* conns; // Indexed like server->connected_clients
+    msock_resp_command_def commands[MSOCK_RESP_MAX_COMMANDS];
+    int command_count;
+    int16_t command_index[MSOCK_RESP_MAX_COMMANDS * 2]; // Open addressing over commands, -1 = empty
+    msock_resp_stats stats;
+};
+
+bool msock_resp_attach(msock_resp_server* resp, msock_server* server, void* userdata);
+void msock_resp_detach(msock_resp_server* resp);
+bool msock_resp_register(msock_resp_server* resp, const char* name, int arity, msock_resp_handler_cb handler);
+
+bool msock_resp_reply_status(msock_resp_conn* conn, const char* status);
+bool msock_resp_reply_error(msock_resp_conn* conn, const char* error);
+bool msock_resp_reply_integer(msock_resp_conn* conn, int64_t value);
+bool msock_resp_reply_bulk(msock_resp_conn* conn, const void* data, size_t len);
+bool msock_resp_reply_null(msock_resp_conn* conn);
+bool msock_resp_reply_array(msock_resp_conn* conn, int count);
+
+bool msock_resp_str_equals(msock_resp_str str, const char* text); // Case insensitive, like command names
+bool msock_resp_str_to_int(msock_resp_str str, int64_t* value);
+const msock_resp_stats* msock_resp_get_stats(msock_resp_server* resp);
+
+#ifdef MSOCK_RESP_IMPLEMENTATION
+
+//MSOCK_RESP Implementations
+
+static char msock_internal_resp_lower(char c) {
+    return (c >= 'A' && c <= 'Z') ? (char)(c + 32) : c;
+}
+
+bool msock_resp_str_equals(msock_resp_str str, const char* text) {
+    for (size_t i = 0; i < str.len; i++) {
+        if (text[i] == '\0' || msock_internal_resp_lower(str.data[i]) != msock_internal_resp_lower(text[i])) return false;
+    }
+    return text[str.len] == '\0';
+}
+
+bool msock_resp_str_to_int(msock_resp_str str, int64_t* value) {
+    if (str.len == 0 || str.len > 20) return false;
+
+    size_t i = 0;
+    bool negative = str.data[0] == '-';
+    if (negative) i++;
+    if (i == str.len) return false;
+
+    uint64_t result = 0;
+    for (; i < str.len; i++) {
+        char c = str.data[i];
+        if (c < '0' || c > '9') return false;
+        uint64_t digit = (uint64_t)(c - '0');
+        if (result > (UINT64_MAX - digit) / 10) return false;
+        result = result * 10 + digit;
+    }
+
+    if (result > (uint64_t)INT64_MAX + (negative ? 1 : 0)) return false;
+    *value = negative ? (int64_t)(0 - result) : (int64_t)result;
+    return true;
+}
+
+// FNV-1a over the lowercased name
+static uint32_t msock_internal_resp_hash(const char* name, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (uint8_t)msock_internal_resp_lower(name[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static const msock_resp_command_def* msock_internal_resp_lookup(msock_resp_server* resp, msock_resp_str name) {
+    if (name.len >= sizeof(resp->commands[0].name)) return NULL;
+
+    uint32_t mask = MSOCK_RESP_MAX_COMMANDS * 2 - 1;
+    for (uint32_t slot = msock_internal_resp_hash(name.data, name.len) & mask;; slot = (slot + 1) & mask) {
+        int index = resp->command_index[slot];
+        if (index < 0) return NULL;
+
+        const msock_resp_command_def* def = &resp->commands[index];
+        if (def->name_len == name.len && msock_resp_str_equals(name, def->name)) return def;
+    }
+}
+
+// Adds name to the dispatch table, or replaces the handler already registered for it
+bool msock_resp_register(msock_resp_server* resp, const char* name, int arity, msock_resp_handler_cb handler) {
+    size_t len = strlen(name);
+    if (len == 0 || len >= sizeof(resp->commands[0].name)) {
+        printf("msock_resp: invalid command name %s\n", name);
+        return false;
+    }
+
+    msock_resp_str key = { name, len };
+    msock_resp_command_def* existing = (msock_resp_command_def*)msock_internal_resp_lookup(resp, key);
+    if (existing) {
+        existing->arity = arity;
+        existing->handler = handler;
+        return true;
+    }
+
+    if (resp->command_count == MSOCK_RESP_MAX_COMMANDS) {
+        printf("msock_resp: command table is full\n");
+        return false;
+    }
+
+    int index = resp->command_count++;
+    msock_resp_command_def* def = &resp->commands[index];
+    for (size_t i = 0; i <= len; i++) def->name[i] = msock_internal_resp_lower(name[i]);
+    def->name_len = len;
+    def->arity = arity;
+    def->handler = handler;
+
+    uint32_t mask = MSOCK_RESP_MAX_COMMANDS * 2 - 1;
+    uint32_t slot = msock_internal_resp_hash(name, len) & mask;
+    while (resp->command_index[slot] >= 0) slot = (slot + 1) & mask;
+    resp->command_index[slot] = (int16_t)index;
+    return true;
+}
+
+// Writes a prefix line such as ":42\r\n" or "*3\r\n" into the batch
+static bool msock_internal_resp_write_line(msock_resp_conn* conn, char type, int64_t value) {
+    char line[32];
+    int len = snprintf(line, sizeof(line), "%c%lld\r\n", type, (long long)value);
+    conn->replies++;
+    return msock_proto_write(&conn->io, line, (size_t)len);
+}
+
+static bool msock_internal_resp_write_text(msock_resp_conn* conn, char type, const char* text) {
+    msock_proto_conn* io = &conn->io;
+    size_t len = strlen(text);
+    if (!msock_proto_reserve(io, len + 3)) return false;
+
+    conn->replies++;
+    io->out[io->out_len++] = type;
+    for (size_t i = 0; i < len && io->out_len + 2 < io->out_capacity; i++) {
+        // Simple strings can't carry line breaks
+        io->out[io->out_len++] = (text[i] == '\r' || text[i] == '\n') ? ' ' : text[i];
+    }
+    io->out[io->out_len++] = '\r';
+    io->out[io->out_len++] = '\n';
+    return true;
+}
+
+bool msock_resp_reply_status(msock_resp_conn* conn, const char* status) {
+    return msock_internal_resp_write_text(conn, '+', status);
+}
+
+// error should start with an uppercase code, like "ERR no such key"
+bool msock_resp_reply_error(msock_resp_conn* conn, const char* error) {
+    return msock_internal_resp_write_text(conn, '-', error);
+}
+
+bool msock_resp_reply_integer(msock_resp_conn* conn, int64_t value) {
+    return msock_internal_resp_write_line(conn, ':', value);
+}
+
+bool msock_resp_reply_null(msock_resp_conn* conn) {
+    conn->replies++;
+    return msock_proto_write(&conn->io, "$-1\r\n", 5);
+}
+
+// Follow with count replies for the elements
+bool msock_resp_reply_array(msock_resp_conn* conn, int count) {
+    return msock_internal_resp_write_line(conn, '*', count);
+}
+
+// Small values are copied into the batch. A large one is sent right away together with
+// the batch so far, straight from the caller's memory.
+bool msock_resp_reply_bulk(msock_resp_conn* conn, const void* data, size_t len) {
+    if (!msock_internal_resp_write_line(conn, '$', (int64_t)len)) return false;
+    if (len > MSOCK_RESP_INLINE_BULK) return msock_proto_flush(&conn->io, data, len, "\r\n", 2);
+
+    msock_proto_conn* io = &conn->io;
+    if (!msock_proto_reserve(io, len + 2)) return false;
+    memcpy(io->out + io->out_len, data, len);
+    io->out_len += len;
+    io->out[io->out_len++] = '\r';
+    io->out[io->out_len++] = '\n';
+    return true;
+}
+
+static void msock_internal_resp_fail(msock_resp_conn* conn, const char* error) {
+    conn->resp->stats.protocol_errors++;
+    conn->io.closing = true;
+    msock_resp_reply_error(conn, error);
+}
+
+// Reads the number after a '*' or '$' prefix at data[0]. Returns the line length, 0 if the
+// line is incomplete, SIZE_MAX if it is malformed.
+static size_t msock_internal_resp_parse_count(const char* data, size_t len, int64_t* value) {
+    const char* newline = (const char*)memchr(data, '\n', len < 24 ? len : 24);
+    if (!newline) return len < 24 ? 0 : SIZE_MAX;
+
+    size_t line_len = (size_t)(newline - data) + 1;
+    if (line_len < 4 || newline[-1] != '\r') return SIZE_MAX;
+
+    msock_resp_str number = { data + 1, line_len - 3 };
+    if (!msock_resp_str_to_int(number, value)) return SIZE_MAX;
+    return line_len;
+}
+
+// Splits a telnet style "SET key value\r\n" line into arguments. No quoting.
+static bool msock_internal_resp_parse_inline(msock_resp_conn* conn, char* data, size_t line_len) {
+    msock_resp_command* command = &conn->pending;
+    command->argc = 0;
+
+    size_t i = 0;
+    while (i < line_len) {
+        while (i < line_len && (data[i] == ' ' || data[i] == '\t' || data[i] == '\r')) i++;
+        if (i == line_len) break;
+
+        size_t start = i;
+        while (i < line_len && data[i] != ' ' && data[i] != '\t' && data[i] != '\r') i++;
+
+        if (command->argc == MSOCK_RESP_MAX_ARGS) {
+            msock_internal_resp_fail(conn, "ERR Protocol error: too many arguments");
+            return false;
+        }
+        command->argv[command->argc].data = data + start;
+        command->argv[command->argc].len = i - start;
+        command->argc++;
+    }
+    return true;
+}
+
+// Continues parsing the multibulk command at data. Returns 1 when it is complete, 0 when more
+// bytes are needed, -1 on a protocol error. Progress is kept in the connection.
+static int msock_internal_resp_parse_multibulk(msock_resp_conn* conn, char* data, size_t available) {
+    msock_resp_command* command = &conn->pending;
+
+    if (conn->pending_argc == 0) {
+        int64_t count;
+        size_t line_len = msock_internal_resp_parse_count(data, available, &count);
+        if (line_len == 0) return 0;
+        if (line_len == SIZE_MAX) {
+            msock_internal_resp_fail(conn, "ERR Protocol error: invalid multibulk length");
+            return -1;
+        }
+        if (count > MSOCK_RESP_MAX_ARGS) {
+            msock_internal_resp_fail(conn, "ERR Protocol error: too many arguments");
+            return -1;
+        }
+
+        conn->pending_len = line_len;
+        command->argc = 0;
+        // "*0" and "*-1" are empty commands, skipped
+        if (count <= 0) return 1;
+        conn->pending_argc = (int)count;
+    }
+
+    while (command->argc < conn->pending_argc) {
+        char* arg = data + conn->pending_len;
+        size_t remaining = available - conn->pending_len;
+        if (remaining == 0) return 0;
+
+        if (arg[0] != '$') {
+            msock_internal_resp_fail(conn, "ERR Protocol error: expected '$'");
+            return -1;
+        }
+
+        int64_t len;
+        size_t line_len = msock_internal_resp_parse_count(arg, remaining, &len);
+        if (line_len == 0) return 0;
+        if (line_len == SIZE_MAX || len < 0 || len > MSOCK_RESP_BUFFER_SIZE) {
+            msock_internal_resp_fail(conn, "ERR Protocol error: invalid bulk length");
+            return -1;
+        }
+        if (conn->pending_len + line_len + (size_t)len + 2 > MSOCK_RESP_BUFFER_SIZE) {
+            msock_internal_resp_fail(conn, "ERR Protocol error: command too large");
+            return -1;
+        }
+        if (remaining < line_len + (size_t)len + 2) return 0; // Payload still on its way
+
+        if (arg[line_len + (size_t)len] != '\r' || arg[line_len + (size_t)len + 1] != '\n') {
+            msock_internal_resp_fail(conn, "ERR Protocol error: bulk not terminated by CRLF");
+            return -1;
+        }
+
+        command->argv[command->argc].data = arg + line_len;
+        command->argv[command->argc].len = (size_t)len;
+        command->argc++;
+        conn->pending_len += line_len + (size_t)len + 2;
+    }
+
+    conn->pending_argc = 0;
+    return 1;
+}
+
+static void msock_internal_resp_dispatch(msock_resp_conn* conn, const msock_resp_command* command) {
+    msock_resp_server* resp = conn->resp;
+    resp->stats.commands++;
+    conn->replies = 0;
+
+    const msock_resp_command_def* def = msock_internal_resp_lookup(resp, command->argv[0]);
+    if (!def) {
+        resp->stats.unknown_commands++;
+        char error[96];
+        snprintf(error, sizeof(error), "ERR unknown command '%.*s'", (int)(command->argv[0].len < 48 ? command->argv[0].len : 48), command->argv[0].data);
+        msock_resp_reply_error(conn, error);
+        return;
+    }
+
+    if ((def->arity > 0 && command->argc != def->arity) || (def->arity < 0 && command->argc < -def->arity)) {
+        char error[96];
+        snprintf(error, sizeof(error), "ERR wrong number of arguments for '%s' command", def->name);
+        msock_resp_reply_error(conn, error);
+        return;
+    }
+
+    def->handler(conn, command, resp->userdata);
+
+    if (conn->replies == 0) {
+        printf("msock_resp: handler didn't reply to %s\n", def->name);
+        msock_resp_reply_error(conn, "ERR no reply");
+    }
+}
+
+// Handles every complete command in conn->io.in, then sends the replies in one go
+static bool msock_internal_resp_process(msock_resp_conn* conn) {
+    msock_resp_server* resp = conn->resp;
+    size_t consumed = 0;
+    int handled = 0;
+
+    while (!conn->io.closing) {
+        char* data = conn->io.in + consumed;
+        size_t available = conn->io.in_len - consumed;
+        if (available == 0) break;
+
+        size_t command_len;
+        if (data[0] == '*') {
+            int status = msock_internal_resp_parse_multibulk(conn, data, available);
+            if (status <= 0) {
+                if (status == 0 && available >= MSOCK_RESP_BUFFER_SIZE) msock_internal_resp_fail(conn, "ERR Protocol error: command too large");
+                break;
+            }
+            command_len = conn->pending_len;
+        } else {
+            const char* newline = (const char*)memchr(data, '\n', available);
+            if (!newline) {
+                if (available >= MSOCK_RESP_BUFFER_SIZE) msock_internal_resp_fail(conn, "ERR Protocol error: command too large");
+                break;
+            }
+            command_len = (size_t)(newline - data) + 1;
+            if (!msock_internal_resp_parse_inline(conn, data, command_len - 1)) break;
+        }
+
+        if (conn->pending.argc > 0) {
+            msock_internal_resp_dispatch(conn, &conn->pending);
+            handled++;
+        }
+
+        consumed += command_len;
+        conn->pending_len = 0;
+    }
+
+    if (handled > 1) resp->stats.pipelined_reads++;
+
+    // The arguments the unfinished command has so far move along with it
+    msock_proto_consume(&conn->io, consumed);
+    if (consumed > 0 && conn->pending_argc > 0) {
+        for (int i = 0; i < conn->pending.argc; i++) conn->pending.argv[i].data -= consumed;
+    }
+
+    return msock_proto_flush(&conn->io, NULL, 0, NULL, 0);
+}
+
+static bool msock_internal_resp_on_client(msock_server* server, msock_client* client) {
+    msock_resp_server* resp = (msock_resp_server*)server->userdata;
+    msock_resp_conn* conn = (msock_resp_conn*)msock_client_get_userdata(client);
+
+    // Accept clears the client's userdata, so a NULL here is a new connection on this slot
+    if (!conn) {
+        conn = &resp->conns[client - server->connected_clients];
+        if (!msock_proto_conn_open(&conn->io, client, MSOCK_RESP_BUFFER_SIZE, MSOCK_RESP_OUT_SIZE, &resp->stats.batched_sends)) return false;
+        conn->resp = resp;
+        conn->pending_argc = 0;
+        conn->pending_len = 0;
+        conn->userdata = NULL;
+        msock_client_set_userdata(client, conn);
+    }
+
+    if (conn->io.closing) return msock_proto_drain_closing(&conn->io);
+
+    ssize_t received = msock_proto_receive(&conn->io);
+    if (received < 0) return false;
+    if (received == 0) return true;
+
+    if (!msock_internal_resp_process(conn)) return false;
+    return msock_proto_keep(&conn->io);
+}
+
+// Serves RESP on server. Takes over the server's client callback and userdata, handlers
+// get userdata instead. Register commands with msock_resp_register.
+bool msock_resp_attach(msock_resp_server* resp, msock_server* server, void* userdata) {
+    memset(resp, 0, sizeof(*resp));
+    resp->conns = (msock_resp_conn*)calloc(MSOCK_MAX_CLIENTS, sizeof(msock_resp_conn));
+    if (!resp->conns) {
+        printf("calloc() failed for RESP connections\n");
+        return false;
+    }
+
+    resp->server = server;
+    resp->userdata = userdata;
+    memset(resp->command_index, 0xff, sizeof(resp->command_index));
+
+    msock_server_set_userdata(server, resp);
+    msock_server_set_client_cb(server, msock_internal_resp_on_client);
+    return true;
+}
+
+void msock_resp_detach(msock_resp_server* resp) {
+    if (!resp->conns) return;
+
+    msock_server_set_client_cb(resp->server, NULL);
+    msock_server_set_userdata(resp->server, NULL);
+
+    for (int i = 0; i < MSOCK_MAX_CLIENTS; i++) msock_proto_conn_free(&resp->conns[i].io);
+    free(resp->conns);
+    resp->conns = NULL;
+}
+
+const msock_resp_stats* msock_resp_get_stats(msock_resp_server* resp) {
+    return &resp->stats;
+}
+
+#endif // MSOCK_RESP_IMPLEMENTATION
+
+#endif // MSOCK_RESP_H
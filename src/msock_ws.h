@@ -0,0 +1,621 @@
+#ifndef MSOCK_WS_H
+#define MSOCK_WS_H
+
+// WebSocket (RFC 6455) server connections, upgraded from msock_http requests: handshake,
+// frame parsing with vectorized unmasking, fragmented messages, ping/pong keepalive on the
+// server loop's timer, and pre-framed broadcasts shared by every recipient.
+//
+//     #define MSOCK_IMPLEMENTATION
+//     #define MSOCK_HTTP_IMPLEMENTATION
+//     #define MSOCK_WS_IMPLEMENTATION
+//     #include "msock_ws.h"
+
+#include "msock_http.h"
+
+#define MSOCK_WS_MAX_MESSAGE (1024 * 1024) // Limit for a message reassembled from fragments
+#define MSOCK_WS_DEFAULT_PING_INTERVAL_MS 30000
+
+#define MSOCK_WS_OP_CONTINUATION 0x0
+#define MSOCK_WS_OP_TEXT 0x1
+#define MSOCK_WS_OP_BINARY 0x2
+#define MSOCK_WS_OP_CLOSE 0x8
+#define MSOCK_WS_OP_PING 0x9
+#define MSOCK_WS_OP_PONG 0xA
+
+#define MSOCK_WS_CLOSE_NORMAL 1000
+#define MSOCK_WS_CLOSE_GOING_AWAY 1001
+#define MSOCK_WS_CLOSE_PROTOCOL_ERROR 1002
+#define MSOCK_WS_CLOSE_ABNORMAL 1006 // Never sent, reported when the connection just went away
+#define MSOCK_WS_CLOSE_TOO_BIG 1009
+
+typedef struct msock_ws_server msock_ws_server;
+
+typedef struct {
+    msock_ws_server* ws;
+    msock_http_conn* http;
+    bool open;
+    bool awaiting_pong; // A ping went out and nothing arrived since
+    int open_index;     // Position in ws->open_list
+
+    uint8_t fragment_opcode; // Opcode of the fragmented message being reassembled, 0 = none
+    char* fragment;
+    size_t fragment_len;
+    size_t fragment_capacity;
+
+    void* userdata;
+} msock_ws_conn;
+
+typedef void (*msock_ws_on_open_cb)(msock_ws_conn* conn, void* userdata);
+// Complete messages only, fragments are reassembled first. data is valid until the callback returns.
+typedef void (*msock_ws_on_message_cb)(msock_ws_conn* conn, int opcode, const char* data, size_t len, void* userdata);
+typedef void (*msock_ws_on_close_cb)(msock_ws_conn* conn, int code, void* userdata);
+
+typedef struct {
+    msock_ws_on_open_cb on_open;
+    msock_ws_on_message_cb on_message;
+    msock_ws_on_close_cb on_close;
+    uint32_t ping_interval_ms; // 0 = MSOCK_WS_DEFAULT_PING_INTERVAL_MS, a peer silent for a whole interval after a ping is dropped
+    void* userdata;
+} msock_ws_config;
+
+typedef struct {
+    uint64_t upgrades;
+    uint64_t frames_received;
+    uint64_t messages_received;
+    uint64_t pings_sent;
+    uint64_t timeouts;
+    uint64_t protocol_errors;
+    uint64_t broadcast_frames; // Frames queued by msock_ws_broadcast / msock_ws_publish
+} msock_ws_stats;
+
+struct msock_ws_server {
+    msock_http_server* http;
+    msock_ws_config config;
+    msock_ws_conn* conns; // Indexed like the server's connected_clients
+    int open_list[MSOCK_MAX_CLIENTS]; // Dense slots of open connections, for broadcasts and pings
+    int open_count;
+    uint64_t ping_timer_id;
+    msock_ws_stats stats;
+};
+
+bool msock_ws_init(msock_ws_server* ws, msock_http_server* http, const msock_ws_config* config);
+void msock_ws_free(msock_ws_server* ws);
+
+bool msock_ws_is_upgrade(const msock_http_request* request);
+msock_ws_conn* msock_ws_upgrade(msock_ws_server* ws, msock_http_conn* conn, const msock_http_request* request);
+
+bool msock_ws_send(msock_ws_conn* conn, int opcode, const void* data, size_t len);
+bool msock_ws_close(msock_ws_conn* conn, int code, const char* reason);
+
+msock_buffer* msock_ws_frame(int opcode, const void* data, size_t len);
+int msock_ws_broadcast(msock_ws_server* ws, msock_buffer* frame, msock_ws_conn* exclude);
+bool msock_ws_subscribe(msock_ws_conn* conn, uint32_t topic);
+bool msock_ws_unsubscribe(msock_ws_conn* conn, uint32_t topic);
+int msock_ws_publish(msock_ws_server* ws, uint32_t topic, msock_buffer* frame, msock_ws_conn* exclude);
+
+void msock_ws_unmask(char* data, size_t len, const uint8_t mask[4]);
+const msock_ws_stats* msock_ws_get_stats(msock_ws_server* ws);
+
+#ifdef MSOCK_WS_IMPLEMENTATION
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MSOCK_WS_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+//MSOCK_WS Implementations
+
+// XORs the client's masking key over data in place, 32 or 16 bytes per step when the
+// target has AVX2 or SSE2. The key repeats every 4 bytes, so it splats into a vector.
+void msock_ws_unmask(char* data, size_t len, const uint8_t mask[4]) {
+    size_t i = 0;
+    uint32_t mask32;
+    memcpy(&mask32, mask, 4);
+
+#ifdef __AVX2__
+    __m256i mask256 = _mm256_set1_epi32((int)mask32);
+    for (; i + 32 <= len; i += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)(data + i));
+        _mm256_storeu_si256((__m256i*)(data + i), _mm256_xor_si256(chunk, mask256));
+    }
+#endif
+#ifdef MSOCK_WS_SSE2
+    __m128i mask128 = _mm_set1_epi32((int)mask32);
+    for (; i + 16 <= len; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(data + i));
+        _mm_storeu_si128((__m128i*)(data + i), _mm_xor_si128(chunk, mask128));
+    }
+#endif
+
+    uint64_t mask64 = (uint64_t)mask32 | ((uint64_t)mask32 << 32);
+    for (; i + 8 <= len; i += 8) {
+        uint64_t chunk;
+        memcpy(&chunk, data + i, 8);
+        chunk ^= mask64;
+        memcpy(data + i, &chunk, 8);
+    }
+
+    // i is a multiple of 4 here, so the key lines up again
+    for (; i < len; i++) data[i] ^= (char)mask[i & 3];
+}
+
+static uint32_t msock_internal_sha1_rol(uint32_t value, int bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+static void msock_internal_sha1_block(uint32_t state[5], const uint8_t block[64]) {
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) {
+        w[i] = ((uint32_t)block[i * 4] << 24) | ((uint32_t)block[i * 4 + 1] << 16) | ((uint32_t)block[i * 4 + 2] << 8) | block[i * 4 + 3];
+    }
+    for (int i = 16; i < 80; i++) w[i] = msock_internal_sha1_rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+    for (int i = 0; i < 80; i++) {
+        uint32_t f, k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5a827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ed9eba1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8f1bbcdc;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xca62c1d6;
+        }
+
+        uint32_t temp = msock_internal_sha1_rol(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = msock_internal_sha1_rol(b, 30);
+        b = a;
+        a = temp;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+// Only used for the handshake's Sec-WebSocket-Accept, not for anything secret
+static void msock_internal_sha1(const uint8_t* data, size_t len, uint8_t digest[20]) {
+    uint32_t state[5] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+    uint8_t block[64];
+
+    size_t offset = 0;
+    for (; offset + 64 <= len; offset += 64) msock_internal_sha1_block(state, data + offset);
+
+    size_t rest = len - offset;
+    memset(block, 0, sizeof(block));
+    memcpy(block, data + offset, rest);
+    block[rest] = 0x80;
+    if (rest >= 56) {
+        msock_internal_sha1_block(state, block);
+        memset(block, 0, sizeof(block));
+    }
+
+    uint64_t bits = (uint64_t)len * 8;
+    for (int i = 0; i < 8; i++) block[63 - i] = (uint8_t)(bits >> (i * 8));
+    msock_internal_sha1_block(state, block);
+
+    for (int i = 0; i < 5; i++) {
+        digest[i * 4] = (uint8_t)(state[i] >> 24);
+        digest[i * 4 + 1] = (uint8_t)(state[i] >> 16);
+        digest[i * 4 + 2] = (uint8_t)(state[i] >> 8);
+        digest[i * 4 + 3] = (uint8_t)state[i];
+    }
+}
+
+static size_t msock_internal_base64(const uint8_t* data, size_t len, char* out) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t written = 0;
+
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t group = (uint32_t)data[i] << 16;
+        if (i + 1 < len) group |= (uint32_t)data[i + 1] << 8;
+        if (i + 2 < len) group |= data[i + 2];
+
+        out[written++] = alphabet[(group >> 18) & 63];
+        out[written++] = alphabet[(group >> 12) & 63];
+        out[written++] = i + 1 < len ? alphabet[(group >> 6) & 63] : '=';
+        out[written++] = i + 2 < len ? alphabet[group & 63] : '=';
+    }
+
+    out[written] = '\0';
+    return written;
+}
+
+// Server frames are never masked. Returns the header length, at most 10.
+static size_t msock_internal_ws_header(uint8_t* header, int opcode, size_t len) {
+    header[0] = (uint8_t)(0x80 | (opcode & 0x0f));
+    if (len < 126) {
+        header[1] = (uint8_t)len;
+        return 2;
+    }
+    if (len <= 0xffff) {
+        header[1] = 126;
+        header[2] = (uint8_t)(len >> 8);
+        header[3] = (uint8_t)len;
+        return 4;
+    }
+
+    header[1] = 127;
+    for (int i = 0; i < 8; i++) header[9 - i] = (uint8_t)((uint64_t)len >> (i * 8));
+    return 10;
+}
+
+// Accept resets the client's userdata, so a conn whose client doesn't point back at its
+// http conn any more belongs to a connection that is gone
+static bool msock_internal_ws_alive(msock_ws_conn* conn) {
+    msock_client* client = conn->http->io.client;
+    return conn->open && msock_client_is_connected(client) && msock_client_get_userdata(client) == conn->http &&
+           conn->http->upgrade_ctx == conn;
+}
+
+static void msock_internal_ws_mark_closed(msock_ws_conn* conn, int code) {
+    if (!conn->open) return;
+    conn->open = false;
+
+    msock_ws_server* ws = conn->ws;
+    int last = ws->open_list[--ws->open_count];
+    ws->open_list[conn->open_index] = last;
+    ws->conns[last].open_index = conn->open_index;
+
+    free(conn->fragment);
+    conn->fragment = NULL;
+    conn->fragment_len = 0;
+    conn->fragment_capacity = 0;
+    conn->fragment_opcode = 0;
+
+    if (ws->config.on_close) ws->config.on_close(conn, code, ws->config.userdata);
+}
+
+bool msock_ws_send(msock_ws_conn* conn, int opcode, const void* data, size_t len) {
+    if (!conn->open) return false;
+
+    uint8_t header[10];
+    msock_iovec iov[2];
+    iov[0].data = header;
+    iov[0].len = msock_internal_ws_header(header, opcode, len);
+    iov[1].data = data;
+    iov[1].len = len;
+
+    return msock_client_sendv(conn->http->io.client, iov, len > 0 ? 2 : 1);
+}
+
+// Sends a close frame and drops the connection once it is flushed
+bool msock_ws_close(msock_ws_conn* conn, int code, const char* reason) {
+    if (!conn->open) return false;
+
+    char payload[125];
+    size_t reason_len = reason ? strlen(reason) : 0;
+    if (reason_len > sizeof(payload) - 2) reason_len = sizeof(payload) - 2;
+
+    payload[0] = (char)(code >> 8);
+    payload[1] = (char)code;
+    if (reason_len > 0) memcpy(payload + 2, reason, reason_len);
+
+    bool sent = msock_ws_send(conn, MSOCK_WS_OP_CLOSE, payload, 2 + reason_len);
+    conn->http->io.closing = true;
+    msock_internal_ws_mark_closed(conn, code);
+    return sent;
+}
+
+static bool msock_internal_ws_fail(msock_ws_conn* conn, int code) {
+    conn->ws->stats.protocol_errors++;
+    msock_ws_close(conn, code, NULL);
+    return true; // The http layer drops the connection once the close frame is out
+}
+
+static void msock_internal_ws_deliver(msock_ws_conn* conn, int opcode, const char* data, size_t len) {
+    msock_ws_server* ws = conn->ws;
+    ws->stats.messages_received++;
+    if (ws->config.on_message) ws->config.on_message(conn, opcode, data, len, ws->config.userdata);
+}
+
+static bool msock_internal_ws_append_fragment(msock_ws_conn* conn, const char* data, size_t len) {
+    if (conn->fragment_len + len > MSOCK_WS_MAX_MESSAGE) return false;
+
+    if (conn->fragment_len + len > conn->fragment_capacity) {
+        size_t capacity = conn->fragment_capacity ? conn->fragment_capacity * 2 : 4096;
+        while (capacity < conn->fragment_len + len) capacity *= 2;
+
+        char* grown = (char*)realloc(conn->fragment, capacity);
+        if (!grown) return false;
+        conn->fragment = grown;
+        conn->fragment_capacity = capacity;
+    }
+
+    memcpy(conn->fragment + conn->fragment_len, data, len);
+    conn->fragment_len += len;
+    return true;
+}
+
+// Handles one complete frame whose payload was already unmasked in place
+static bool msock_internal_ws_frame(msock_ws_conn* conn, bool fin, int opcode, char* payload, size_t len) {
+    switch (opcode) {
+    case MSOCK_WS_OP_TEXT:
+    case MSOCK_WS_OP_BINARY:
+        if (conn->fragment_opcode) return msock_internal_ws_fail(conn, MSOCK_WS_CLOSE_PROTOCOL_ERROR);
+
+        // Unfragmented messages are handed out straight from the receive buffer
+        if (fin) {
+            msock_internal_ws_deliver(conn, opcode, payload, len);
+            return true;
+        }
+
+        conn->fragment_opcode = (uint8_t)opcode;
+        conn->fragment_len = 0;
+        if (!msock_internal_ws_append_fragment(conn, payload, len)) return msock_internal_ws_fail(conn, MSOCK_WS_CLOSE_TOO_BIG);
+        return true;
+
+    case MSOCK_WS_OP_CONTINUATION:
+        if (!conn->fragment_opcode) return msock_internal_ws_fail(conn, MSOCK_WS_CLOSE_PROTOCOL_ERROR);
+        if (!msock_internal_ws_append_fragment(conn, payload, len)) return msock_internal_ws_fail(conn, MSOCK_WS_CLOSE_TOO_BIG);
+
+        if (fin) {
+            int message_opcode = conn->fragment_opcode;
+            conn->fragment_opcode = 0;
+            msock_internal_ws_deliver(conn, message_opcode, conn->fragment, conn->fragment_len);
+            conn->fragment_len = 0;
+        }
+        return true;
+
+    case MSOCK_WS_OP_PING:
+        return msock_ws_send(conn, MSOCK_WS_OP_PONG, payload, len);
+
+    case MSOCK_WS_OP_PONG:
+        return true; // Any frame already counts as a sign of life
+
+    case MSOCK_WS_OP_CLOSE: {
+        int code = len >= 2 ? (((uint8_t)payload[0] << 8) | (uint8_t)payload[1]) : MSOCK_WS_CLOSE_NORMAL;
+        msock_ws_close(conn, code, NULL);
+        return true;
+    }
+
+    default:
+        return msock_internal_ws_fail(conn, MSOCK_WS_CLOSE_PROTOCOL_ERROR);
+    }
+}
+
+static bool msock_internal_ws_on_data(msock_http_conn* http, void* ctx) {
+    msock_ws_conn* conn = (msock_ws_conn*)ctx;
+
+    if (!msock_client_is_connected(http->io.client)) {
+        msock_internal_ws_mark_closed(conn, MSOCK_WS_CLOSE_ABNORMAL);
+        return false;
+    }
+
+    size_t offset = 0;
+    while (conn->open) {
+        uint8_t* data = (uint8_t*)http->io.in + offset;
+        size_t available = http->io.in_len - offset;
+        if (available < 2) break;
+
+        bool fin = (data[0] & 0x80) != 0;
+        int opcode = data[0] & 0x0f;
+        bool masked = (data[1] & 0x80) != 0;
+        uint64_t len = data[1] & 0x7f;
+        size_t header_len = 2;
+
+        if ((data[0] & 0x70) || !masked) {
+            msock_internal_ws_fail(conn, MSOCK_WS_CLOSE_PROTOCOL_ERROR); // No extensions, and clients must mask
+            break;
+        }
+
+        if (len == 126) {
+            if (available < 4) break;
+            len = ((uint64_t)data[2] << 8) | data[3];
+            header_len = 4;
+        } else if (len == 127) {
+            if (available < 10) break;
+            len = 0;
+            for (int i = 0; i < 8; i++) len = (len << 8) | data[2 + i];
+            header_len = 10;
+        }
+
+        if (opcode >= MSOCK_WS_OP_CLOSE && (!fin || len > 125)) {
+            msock_internal_ws_fail(conn, MSOCK_WS_CLOSE_PROTOCOL_ERROR);
+            break;
+        }
+
+        // A frame has to fit the receive buffer, bigger messages must come fragmented
+        if (len > MSOCK_HTTP_BUFFER_SIZE - header_len - 4) {
+            msock_internal_ws_fail(conn, MSOCK_WS_CLOSE_TOO_BIG);
+            break;
+        }
+
+        size_t frame_len = header_len + 4 + (size_t)len;
+        if (available < frame_len) break;
+
+        char* payload = (char*)data + header_len + 4;
+        msock_ws_unmask(payload, (size_t)len, data + header_len);
+
+        conn->ws->stats.frames_received++;
+        conn->awaiting_pong = false;
+        offset += frame_len;
+
+        if (!msock_internal_ws_frame(conn, fin, opcode, payload, (size_t)len)) {
+            msock_internal_ws_mark_closed(conn, MSOCK_WS_CLOSE_ABNORMAL);
+            return false;
+        }
+    }
+
+    msock_proto_consume(&http->io, offset);
+    if (!conn->open) http->io.in_len = 0;
+
+    return true;
+}
+
+// Pings every open connection each interval; one that stayed silent since the last ping
+// is cut off. Also notices connections the server dropped without telling the module.
+static bool msock_internal_ws_ping_timer(msock_loop* loop, void* userdata) {
+    (void)loop;
+    msock_ws_server* ws = (msock_ws_server*)userdata;
+
+    for (int i = ws->open_count - 1; i >= 0; i--) {
+        msock_ws_conn* conn = &ws->conns[ws->open_list[i]];
+
+        if (!msock_internal_ws_alive(conn)) {
+            msock_internal_ws_mark_closed(conn, MSOCK_WS_CLOSE_ABNORMAL);
+            continue;
+        }
+
+        if (conn->awaiting_pong) {
+            ws->stats.timeouts++;
+            msock_client* client = conn->http->io.client;
+            msock_internal_ws_mark_closed(conn, MSOCK_WS_CLOSE_ABNORMAL);
+            // The loop sees the shutdown as a hangup and drops the connection
+            shutdown(client->native_socket, SD_BOTH);
+            continue;
+        }
+
+        conn->awaiting_pong = true;
+        ws->stats.pings_sent++;
+        msock_ws_send(conn, MSOCK_WS_OP_PING, NULL, 0);
+    }
+
+    return true;
+}
+
+bool msock_ws_is_upgrade(const msock_http_request* request) {
+    const msock_http_str* upgrade = msock_http_find_header(request, "Upgrade");
+    return upgrade && msock_http_header_has_token(upgrade, "websocket") &&
+           msock_http_header_has_token(msock_http_find_header(request, "Connection"), "upgrade");
+}
+
+// Completes the handshake for a request from the msock_http handler. Returns the new
+// connection, or NULL after answering 400 / 426 when the request isn't a valid upgrade.
+msock_ws_conn* msock_ws_upgrade(msock_ws_server* ws, msock_http_conn* http, const msock_http_request* request) {
+    const msock_http_str* key = msock_http_find_header(request, "Sec-WebSocket-Key");
+    const msock_http_str* version = msock_http_find_header(request, "Sec-WebSocket-Version");
+
+    if (!msock_ws_is_upgrade(request) || !msock_http_str_equals(request->method, "GET") || !key || key->len != 24) {
+        msock_http_respond(http, 400, "text/plain", "Bad WebSocket handshake", 23);
+        return NULL;
+    }
+    if (!version || !msock_http_str_equals(*version, "13")) {
+        msock_http_header supported = { { "Sec-WebSocket-Version", 21 }, { "13", 2 } };
+        msock_http_respond_headers(http, 426, &supported, 1, NULL, 0);
+        return NULL;
+    }
+
+    static const char guid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    uint8_t input[24 + sizeof(guid) - 1];
+    memcpy(input, key->data, 24);
+    memcpy(input + 24, guid, sizeof(guid) - 1);
+
+    uint8_t digest[20];
+    char accept[32];
+    msock_internal_sha1(input, sizeof(input), digest);
+    size_t accept_len = msock_internal_base64(digest, sizeof(digest), accept);
+
+    int slot = (int)(http->io.client - ws->http->server->connected_clients);
+    msock_ws_conn* conn = &ws->conns[slot];
+    if (conn->open) msock_internal_ws_mark_closed(conn, MSOCK_WS_CLOSE_ABNORMAL); // Leftover from a dropped connection
+
+    memset(conn, 0, sizeof(*conn));
+    conn->ws = ws;
+    conn->http = http;
+
+    msock_http_header headers[3] = {
+        { { "Upgrade", 7 }, { "websocket", 9 } },
+        { { "Connection", 10 }, { "Upgrade", 7 } },
+        { { "Sec-WebSocket-Accept", 20 }, { accept, accept_len } },
+    };
+    if (!msock_http_upgrade(http, headers, 3, msock_internal_ws_on_data, conn)) return NULL;
+
+    conn->open = true;
+    conn->open_index = ws->open_count;
+    ws->open_list[ws->open_count++] = slot;
+    ws->stats.upgrades++;
+
+    if (ws->config.on_open) ws->config.on_open(conn, ws->config.userdata);
+    return conn;
+}
+
+// Builds one server frame that can be queued on any number of connections as is, server
+// frames being unmasked. Release it with msock_buffer_release.
+msock_buffer* msock_ws_frame(int opcode, const void* data, size_t len) {
+    msock_buffer* frame = msock_buffer_acquire(len + 10);
+    if (!frame) return NULL;
+
+    frame->len = msock_internal_ws_header((uint8_t*)frame->data, opcode, len);
+    if (len > 0) memcpy(frame->data + frame->len, data, len);
+    frame->len += len;
+    return frame;
+}
+
+// Queues frame (from msock_ws_frame) on every open connection, returns how many took it
+int msock_ws_broadcast(msock_ws_server* ws, msock_buffer* frame, msock_ws_conn* exclude) {
+    int delivered = 0;
+
+    for (int i = 0; i < ws->open_count; i++) {
+        msock_ws_conn* conn = &ws->conns[ws->open_list[i]];
+        if (conn == exclude || !msock_internal_ws_alive(conn)) continue;
+
+        if (msock_client_send_buffer(conn->http->io.client, frame)) delivered++;
+    }
+
+    ws->stats.broadcast_frames += (uint64_t)delivered;
+    return delivered;
+}
+
+bool msock_ws_subscribe(msock_ws_conn* conn, uint32_t topic) {
+    return msock_server_subscribe(conn->ws->http->server, conn->http->io.client, topic);
+}
+
+bool msock_ws_unsubscribe(msock_ws_conn* conn, uint32_t topic) {
+    return msock_server_unsubscribe(conn->ws->http->server, conn->http->io.client, topic);
+}
+
+// Queues frame (from msock_ws_frame) on the topic's subscribers through the server's pub/sub
+int msock_ws_publish(msock_ws_server* ws, uint32_t topic, msock_buffer* frame, msock_ws_conn* exclude) {
+    int delivered = msock_server_publish_buffer(ws->http->server, topic, frame, exclude ? exclude->http->io.client : NULL);
+    if (delivered > 0) ws->stats.broadcast_frames += (uint64_t)delivered;
+    return delivered;
+}
+
+// Call after msock_http_attach and msock_server_set_loop, the pings run on the server's loop
+bool msock_ws_init(msock_ws_server* ws, msock_http_server* http, const msock_ws_config* config) {
+    memset(ws, 0, sizeof(*ws));
+    ws->conns = (msock_ws_conn*)calloc(MSOCK_MAX_CLIENTS, sizeof(msock_ws_conn));
+    if (!ws->conns) {
+        printf("calloc() failed for WebSocket connections\n");
+        return false;
+    }
+
+    ws->http = http;
+    ws->config = *config;
+    if (ws->config.ping_interval_ms == 0) ws->config.ping_interval_ms = MSOCK_WS_DEFAULT_PING_INTERVAL_MS;
+
+    ws->ping_timer_id = msock_loop_add_timer(http->server->loop, ws->config.ping_interval_ms, ws->config.ping_interval_ms, msock_internal_ws_ping_timer, ws);
+    return true;
+}
+
+void msock_ws_free(msock_ws_server* ws) {
+    if (!ws->conns) return;
+
+    if (ws->ping_timer_id) msock_loop_cancel_timer(ws->http->server->loop, ws->ping_timer_id);
+    for (int i = 0; i < MSOCK_MAX_CLIENTS; i++) free(ws->conns[i].fragment);
+
+    free(ws->conns);
+    ws->conns = NULL;
+    ws->open_count = 0;
+}
+
+const msock_ws_stats* msock_ws_get_stats(msock_ws_server* ws) {
+    return &ws->stats;
+}
+
+#endif // MSOCK_WS_IMPLEMENTATION
+
+#endif // MSOCK_WS_H